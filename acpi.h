@@ -0,0 +1,272 @@
+#ifndef ACPI_H
+#define ACPI_H
+
+#include "types.h"
+#include "cpu.h"
+
+// ============================================================================
+// CPU DISCOVERY FOR MINI-OS
+// Finds the processors and the local APIC address from the ACPI MADT, or
+// from the Intel MultiProcessor table on firmware without ACPI, and the PCI
+// Express config window from the MCFG. Tables are read through the identity
+// map.
+// ============================================================================
+
+#define ACPI_LAPIC_DEFAULT  0xFEE00000
+
+// Where firmware may put the RSDP / MP floating pointer
+#define ACPI_EBDA_SEG_PTR   0x040E
+#define ACPI_BIOS_START     0x000E0000
+#define ACPI_BIOS_END       0x00100000
+
+// MADT entry types
+#define MADT_LOCAL_APIC     0
+#define MADT_LAPIC_OVERRIDE 5
+#define MADT_LAPIC_ENABLED  (1u << 0)
+#define MADT_LAPIC_ONLINE   (1u << 1)   // Can be brought up (ACPI 6.3)
+
+// MP table entry types
+#define MP_ENTRY_PROCESSOR  0
+#define MP_CPU_ENABLED      (1u << 0)
+
+typedef enum {
+    ACPI_SOURCE_NONE = 0,   // Nothing found: uniprocessor
+    ACPI_SOURCE_MADT,
+    ACPI_SOURCE_MP,
+} ACPISource;
+
+typedef struct __attribute__((packed)) {
+    char     signature[8];  // "RSD PTR "
+    uint8_t  checksum;
+    char     oem_id[6];
+    uint8_t  revision;
+    uint32_t rsdt_address;
+    // ACPI 2.0+
+    uint32_t length;
+    uint64_t xsdt_address;
+    uint8_t  extended_checksum;
+    uint8_t  _reserved[3];
+} ACPIRsdp;
+
+typedef struct __attribute__((packed)) {
+    char     signature[4];
+    uint32_t length;
+    uint8_t  revision;
+    uint8_t  checksum;
+    char     oem_id[6];
+    char     oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} ACPIHeader;
+
+typedef struct __attribute__((packed)) {
+    ACPIHeader header;      // "APIC"
+    uint32_t lapic_address;
+    uint32_t flags;
+    // Variable-length entries follow: type, length, ...
+} ACPIMadt;
+
+typedef struct __attribute__((packed)) {
+    ACPIHeader header;      // "MCFG"
+    uint64_t _reserved;
+    // ACPIMcfgEntry follow
+} ACPIMcfg;
+
+typedef struct __attribute__((packed)) {
+    uint64_t base;          // ECAM address of bus 0 (not start_bus)
+    uint16_t segment;
+    uint8_t  start_bus;
+    uint8_t  end_bus;
+    uint32_t _reserved;
+} ACPIMcfgEntry;
+
+typedef struct __attribute__((packed)) {
+    char     signature[4];  // "_MP_"
+    uint32_t config;        // Physical address of the configuration table
+    uint8_t  length;        // In 16-byte units
+    uint8_t  revision;
+    uint8_t  checksum;
+    uint8_t  features[5];   // features[0] != 0: default configuration, no table
+} MPFloating;
+
+typedef struct __attribute__((packed)) {
+    char     signature[4];  // "PCMP"
+    uint16_t length;
+    uint8_t  revision;
+    uint8_t  checksum;
+    char     oem_id[8];
+    char     product_id[12];
+    uint32_t oem_table;
+    uint16_t oem_table_size;
+    uint16_t entry_count;
+    uint32_t lapic_address;
+    uint16_t ext_length;
+    uint8_t  ext_checksum;
+    uint8_t  _reserved;
+} MPConfig;
+
+typedef struct {
+    uint32_t lapic_address;
+    uint32_t cpu_count;
+    uint8_t  apic_ids[CPU_MAX]; // Usable processors in firmware order
+    uint8_t  source;            // ACPISource
+    uint8_t  ready;
+} ACPIInfo;
+
+static ACPIInfo g_acpi;
+
+// ---------- Helpers ----------
+static inline int acpi_checksum(const void* p, uint32_t len) {
+    const uint8_t* b = (const uint8_t*)p;
+    uint8_t sum = 0;
+    for (uint32_t i = 0; i < len; i++) sum += b[i];
+    return sum == 0;
+}
+
+static inline int acpi_signature(const void* p, const char* sig, uint32_t len) {
+    const char* s = (const char*)p;
+    for (uint32_t i = 0; i < len; i++) {
+        if (s[i] != sig[i]) return 0;
+    }
+    return 1;
+}
+
+static inline void acpi_add_cpu(uint8_t apic_id) {
+    if (g_acpi.cpu_count >= CPU_MAX) return;
+    for (uint32_t i = 0; i < g_acpi.cpu_count; i++) {
+        if (g_acpi.apic_ids[i] == apic_id) return;
+    }
+    g_acpi.apic_ids[g_acpi.cpu_count++] = apic_id;
+}
+
+// Scan [start, end) on 16-byte boundaries for a signed, checksummed structure
+static inline const void* acpi_scan(uint32_t start, uint32_t end, const char* sig, uint32_t sig_len, uint32_t sum_len) {
+    for (uint32_t addr = start & ~15u; addr + sum_len <= end; addr += 16) {
+        const void* p = (const void*)(uintptr_t)addr;
+        if (acpi_signature(p, sig, sig_len) && acpi_checksum(p, sum_len)) return p;
+    }
+    return 0;
+}
+
+// BIOS data area word (a plain dereference of page 0 trips -Warray-bounds)
+static inline uint16_t acpi_read_bda16(uint32_t addr) {
+    uint16_t v;
+    __asm__ volatile ("movw (%1), %0" : "=r"(v) : "r"(addr));
+    return v;
+}
+
+// EBDA first kilobyte, then the BIOS ROM area
+static inline const void* acpi_scan_bios(const char* sig, uint32_t sig_len, uint32_t sum_len) {
+    uint32_t ebda = (uint32_t)acpi_read_bda16(ACPI_EBDA_SEG_PTR) << 4;
+    const void* p = 0;
+    if (ebda >= 0x80000 && ebda < 0xA0000) p = acpi_scan(ebda, ebda + 1024, sig, sig_len, sum_len);
+    if (!p) p = acpi_scan(ACPI_BIOS_START, ACPI_BIOS_END, sig, sig_len, sum_len);
+    return p;
+}
+
+// ---------- ACPI ----------
+static inline const ACPIHeader* acpi_find_table(const ACPIRsdp* rsdp, const char* sig) {
+    // The XSDT only matters for tables above 4 GB, which we cannot reach
+    const ACPIHeader* rsdt = (const ACPIHeader*)(uintptr_t)rsdp->rsdt_address;
+    if (!rsdt || !acpi_signature(rsdt, "RSDT", 4) || !acpi_checksum(rsdt, rsdt->length)) return 0;
+
+    uint32_t n = (rsdt->length - sizeof(ACPIHeader)) / 4;
+    const uint32_t* entries = (const uint32_t*)(rsdt + 1);
+    for (uint32_t i = 0; i < n; i++) {
+        const ACPIHeader* h = (const ACPIHeader*)(uintptr_t)entries[i];
+        if (h && acpi_signature(h, sig, 4) && acpi_checksum(h, h->length)) return h;
+    }
+    return 0;
+}
+
+static inline int acpi_parse_madt(void) {
+    const ACPIRsdp* rsdp = (const ACPIRsdp*)acpi_scan_bios("RSD PTR ", 8, 20);
+    if (!rsdp) return -1;
+    const ACPIMadt* madt = (const ACPIMadt*)acpi_find_table(rsdp, "APIC");
+    if (!madt) return -1;
+
+    g_acpi.lapic_address = madt->lapic_address;
+    const uint8_t* p = (const uint8_t*)(madt + 1);
+    const uint8_t* end = (const uint8_t*)madt + madt->header.length;
+    while (p + 2 <= end && p[1] >= 2 && p + p[1] <= end) {
+        if (p[0] == MADT_LOCAL_APIC && p[1] >= 8) {
+            uint32_t flags = *(const uint32_t*)(p + 4);
+            if (flags & (MADT_LAPIC_ENABLED | MADT_LAPIC_ONLINE)) acpi_add_cpu(p[3]);
+        } else if (p[0] == MADT_LAPIC_OVERRIDE && p[1] >= 12) {
+            uint64_t addr = *(const uint64_t*)(p + 4);
+            if (addr < 0x100000000ULL) g_acpi.lapic_address = (uint32_t)addr;
+        }
+        p += p[1];
+    }
+    return g_acpi.cpu_count ? 0 : -1;
+}
+
+// ---------- MCFG ----------
+// ECAM window of PCI segment 0. Returns -1 when the firmware has none or
+// puts it above 4 GB.
+static inline int acpi_find_mcfg(uint32_t* base, uint8_t* start_bus, uint8_t* end_bus) {
+    const ACPIRsdp* rsdp = (const ACPIRsdp*)acpi_scan_bios("RSD PTR ", 8, 20);
+    if (!rsdp) return -1;
+    const ACPIMcfg* mcfg = (const ACPIMcfg*)acpi_find_table(rsdp, "MCFG");
+    if (!mcfg || mcfg->header.length < sizeof(ACPIMcfg)) return -1;
+
+    uint32_t n = (mcfg->header.length - sizeof(ACPIMcfg)) / sizeof(ACPIMcfgEntry);
+    const ACPIMcfgEntry* e = (const ACPIMcfgEntry*)(mcfg + 1);
+    for (uint32_t i = 0; i < n; i++) {
+        if (e[i].segment != 0 || e[i].start_bus > e[i].end_bus) continue;
+        uint64_t end = e[i].base + ((uint64_t)e[i].end_bus + 1) * (1u << 20);
+        if (end > 0x100000000ULL) continue;
+        *base = (uint32_t)e[i].base;
+        *start_bus = e[i].start_bus;
+        *end_bus = e[i].end_bus;
+        return 0;
+    }
+    return -1;
+}
+
+// ---------- MP table ----------
+static inline int acpi_parse_mp(void) {
+    const MPFloating* mpf = (const MPFloating*)acpi_scan_bios("_MP_", 4, 16);
+    if (!mpf || mpf->features[0] || !mpf->config) return -1;   // Default configs carry no CPU list
+
+    const MPConfig* cfg = (const MPConfig*)(uintptr_t)mpf->config;
+    if (!acpi_signature(cfg, "PCMP", 4) || !acpi_checksum(cfg, cfg->length)) return -1;
+
+    g_acpi.lapic_address = cfg->lapic_address;
+    const uint8_t* p = (const uint8_t*)(cfg + 1);
+    const uint8_t* end = (const uint8_t*)cfg + cfg->length;
+    for (uint32_t i = 0; i < cfg->entry_count && p < end; i++) {
+        if (p[0] == MP_ENTRY_PROCESSOR) {
+            if (p[3] & MP_CPU_ENABLED) acpi_add_cpu(p[1]);
+            p += 20;
+        } else {
+            p += 8;
+        }
+    }
+    return g_acpi.cpu_count ? 0 : -1;
+}
+
+// ---------- Initialization ----------
+// Returns the number of processors found (1 when the firmware lists none)
+static inline uint32_t acpi_init(void) {
+    if (g_acpi.ready) return g_acpi.cpu_count;
+
+    g_acpi.cpu_count = 0;
+    g_acpi.lapic_address = ACPI_LAPIC_DEFAULT;
+    if (acpi_parse_madt() == 0) {
+        g_acpi.source = ACPI_SOURCE_MADT;
+    } else {
+        g_acpi.cpu_count = 0;
+        g_acpi.lapic_address = ACPI_LAPIC_DEFAULT;
+        g_acpi.source = acpi_parse_mp() == 0 ? ACPI_SOURCE_MP : ACPI_SOURCE_NONE;
+    }
+    if (g_acpi.source == ACPI_SOURCE_NONE) {
+        g_acpi.cpu_count = 1;
+        g_acpi.apic_ids[0] = 0;
+    }
+    g_acpi.ready = 1;
+    return g_acpi.cpu_count;
+}
+
+#endif // ACPI_H
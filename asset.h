@@ -0,0 +1,106 @@
+#ifndef ASSET_H
+#define ASSET_H
+
+#include "types.h"
+#include "gpu.h"
+
+// ============================================================================
+// SPRITE ASSETS FOR MINI-OS
+// Artwork converted at build time by tools/png2sprite.py and linked into
+// .rodata between __assets_start and __assets_end (kernel.ld). An asset is
+// already in the form the blitters use: premultiplied ARGB pixels plus the
+// per-row opaque/blended runs, so loading only points a Sprite or SpriteRLE
+// at it. Nothing is decoded or copied; the pixels are read-only.
+// ============================================================================
+
+#define ASSET_MAGIC       0x54525053    // 'SPRT'
+#define ASSET_NAME_MAX    24            // Including the NUL
+#define ASSET_ALIGN       16            // Asset size and pixel alignment
+
+// Offsets are from the start of the header; layout written by png2sprite.py
+typedef struct {
+    uint32_t magic;
+    uint32_t size;              // Bytes to the next asset
+    char     name[ASSET_NAME_MAX];
+    uint16_t width;
+    uint16_t height;
+    uint32_t run_count;
+    uint32_t opaque_pixels;
+    uint32_t blended_pixels;
+    uint32_t pixels_offset;     // width * height premultiplied ARGB
+    uint32_t row_start_offset;  // height + 1 indices into the runs
+    uint32_t runs_offset;       // run_count SpriteRun
+    uint32_t _reserved;
+} SpriteAsset;
+
+extern const uint8_t __assets_start[];
+extern const uint8_t __assets_end[];
+
+// ---------- Lookup ----------
+// Header and tables lie inside the asset and inside the blob
+static inline int asset_valid(const SpriteAsset* a, uint32_t avail) {
+    if (avail < sizeof(SpriteAsset) || a->magic != ASSET_MAGIC) return 0;
+    if (a->size < sizeof(SpriteAsset) || a->size > avail || (a->size & (ASSET_ALIGN - 1))) return 0;
+
+    uint32_t pixels = (uint32_t)a->width * a->height * 4;
+    uint32_t rows = ((uint32_t)a->height + 1) * 4;
+    uint64_t runs = (uint64_t)a->run_count * sizeof(SpriteRun);
+    if ((a->pixels_offset & 3) || (uint64_t)a->pixels_offset + pixels > a->size) return 0;
+    if ((a->row_start_offset & 3) || (uint64_t)a->row_start_offset + rows > a->size) return 0;
+    if ((a->runs_offset & 1) || a->runs_offset + runs > a->size) return 0;
+
+    const uint32_t* row_start = (const uint32_t*)((const uint8_t*)a + a->row_start_offset);
+    return row_start[a->height] == a->run_count;
+}
+
+static inline int asset_name_equals(const SpriteAsset* a, const char* name) {
+    for (uint32_t i = 0; i < ASSET_NAME_MAX; i++) {
+        if (a->name[i] != name[i]) return 0;
+        if (!name[i]) return 1;
+    }
+    return 0;
+}
+
+// Walk the linked blob; stops at the first malformed asset
+static inline const SpriteAsset* asset_find(const char* name) {
+    const uint8_t* p = __assets_start;
+    while (p < __assets_end) {
+        const SpriteAsset* a = (const SpriteAsset*)p;
+        if (!asset_valid(a, (uint32_t)(__assets_end - p))) return 0;
+        if (asset_name_equals(a, name)) return a;
+        p += a->size;
+    }
+    return 0;
+}
+
+// ---------- Wrapping ----------
+// The sprite points into .rodata: draw from it, never write to it
+static inline void asset_sprite(const SpriteAsset* a, Sprite* sprite) {
+    sprite->pixels = (uint32_t*)((const uint8_t*)a + a->pixels_offset);
+    sprite->width = a->width;
+    sprite->height = a->height;
+    sprite->hot_x = 0;
+    sprite->hot_y = 0;
+}
+
+static inline void asset_sprite_rle(const SpriteAsset* a, SpriteRLE* rle) {
+    rle->pixels = (const uint32_t*)((const uint8_t*)a + a->pixels_offset);
+    rle->width = a->width;
+    rle->height = a->height;
+    rle->row_start = (uint32_t*)((const uint8_t*)a + a->row_start_offset);
+    rle->runs = (SpriteRun*)((const uint8_t*)a + a->runs_offset);
+    rle->run_count = a->run_count;
+    rle->opaque_pixels = a->opaque_pixels;
+    rle->blended_pixels = a->blended_pixels;
+}
+
+// Either output may be 0. Returns -1 if no asset has that name.
+static inline int asset_load_sprite(const char* name, Sprite* sprite, SpriteRLE* rle) {
+    const SpriteAsset* a = asset_find(name);
+    if (!a) return -1;
+    if (sprite) asset_sprite(a, sprite);
+    if (rle) asset_sprite_rle(a, rle);
+    return 0;
+}
+
+#endif // ASSET_H
@@ -0,0 +1,496 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "types.h"
+#include "graphics.h"
+#include "font.h"
+#include "display.h"
+#include "cmdbuf.h"
+#include "smp.h"
+#include "asset.h"
+#include "serial.h"
+
+// ============================================================================
+// BENCHMARK MODE FOR MINI-OS
+// Times each drawing primitive at several sizes, reports cycles/pixel and
+// MPixels/s on screen and on COM1, then exits QEMU via isa-debug-exit.
+// Built when kernel.c is compiled with -DBENCHMARK (compile-and-run.sh --bench).
+// ============================================================================
+
+// Pixels drawn per test; iterations are derived from this and the size
+#define BENCH_PIXEL_BUDGET  (8u * 1024 * 1024)
+#define BENCH_MIN_ITERS     4
+#define BENCH_MAX_ITERS     65536
+
+#define BENCH_MAX_RESULTS   64
+#define BENCH_LINE_MAX      96
+
+// How long the result screen stays up before QEMU exits
+#define BENCH_HOLD_MS       5000
+
+// QEMU: -device isa-debug-exit,iobase=0xf4,iosize=0x04
+#define BENCH_EXIT_PORT     0xF4
+
+// Largest sprite tested (256x256 ARGB)
+#define BENCH_SPRITE_MAX    256
+
+// Where primitives are drawn
+#define BENCH_X             16
+#define BENCH_Y             16
+
+// One primitive call; `size` is the test size, `iter` varies the color
+typedef void (*BenchFn)(uint32_t size, uint32_t iter);
+
+typedef struct {
+    const char* name;
+    uint32_t size;          // 0 = full screen
+    uint32_t pixels;        // Pixels touched per iteration
+    uint32_t iters;
+    uint64_t cycles;
+    uint64_t ns;
+} BenchResult;
+
+static BenchResult g_bench_results[BENCH_MAX_RESULTS];
+static uint32_t g_bench_count;
+static Sprite g_bench_sprite;
+static Sprite g_bench_sprite_alpha;
+static Sprite g_bench_icons[3];         // Discs: opaque inside, blended rim, clear corners
+static SpriteRLE g_bench_icons_rle[3];
+static SpriteRLE g_bench_asset_rle;     // assets/icon64.png: the 64 px icon, built offline
+
+static const char g_bench_text[] = "The quick brown fox 0123456789";
+#define BENCH_TEXT_LEN      ((uint32_t)sizeof(g_bench_text) - 1)
+
+// ---------- Arithmetic ----------
+static inline uint64_t bench_cycles(void) {
+    return g_cpu.has_tsc ? rdtsc() : 0;
+}
+
+// n / d for a 64-bit d: scale both down until d fits the divl helper
+static inline uint64_t bench_div64(uint64_t n, uint64_t d) {
+    if (d == 0) return 0;
+    while (d >> 32) { d >>= 1; n >>= 1; }
+    return udiv64_32(n, (uint32_t)d);
+}
+
+static inline uint32_t bench_circle_area(uint32_t r) {
+    return 355 * r * r / 113;
+}
+
+static inline Color bench_color(uint32_t iter) {
+    return RGB(iter * 37, iter * 91, iter * 53);
+}
+
+// ---------- Line formatting ----------
+typedef struct {
+    char text[BENCH_LINE_MAX];
+    uint32_t len;
+} BenchLine;
+
+static inline void bench_line_str(BenchLine* line, const char* str) {
+    while (*str && line->len < BENCH_LINE_MAX - 1) line->text[line->len++] = *str++;
+    line->text[line->len] = '\0';
+}
+
+static inline void bench_line_uint(BenchLine* line, uint32_t value) {
+    char buf[11];
+    int i = 10;
+    buf[i] = '\0';
+    do {
+        buf[--i] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+    bench_line_str(line, &buf[i]);
+}
+
+// Value given in hundredths, printed as N.NN
+static inline void bench_line_fixed2(BenchLine* line, uint32_t value_x100) {
+    bench_line_uint(line, value_x100 / 100);
+    char frac[4] = { '.', '0' + (value_x100 / 10) % 10, '0' + value_x100 % 10, '\0' };
+    bench_line_str(line, frac);
+}
+
+static inline void bench_line_pad(BenchLine* line, uint32_t column) {
+    while (line->len < column && line->len < BENCH_LINE_MAX - 1) line->text[line->len++] = ' ';
+    line->text[line->len] = '\0';
+}
+
+// "BENCH <name> <size> pixels=N iters=N cyc_px=N.NN mpix_s=N.NN"
+static inline void bench_format(BenchLine* line, const BenchResult* r) {
+    uint64_t total = (uint64_t)r->pixels * r->iters;
+
+    line->len = 0;
+    bench_line_str(line, "BENCH ");
+    bench_line_str(line, r->name);
+    bench_line_pad(line, 30);
+    if (r->size) bench_line_uint(line, r->size);
+    else bench_line_str(line, "full");
+    bench_line_pad(line, 36);
+    bench_line_str(line, "pixels=");
+    bench_line_uint(line, r->pixels);
+    bench_line_str(line, " iters=");
+    bench_line_uint(line, r->iters);
+    bench_line_str(line, " cyc_px=");
+    bench_line_fixed2(line, (uint32_t)bench_div64(r->cycles * 100, total));
+    bench_line_str(line, " mpix_s=");
+    bench_line_fixed2(line, (uint32_t)bench_div64(total * 100000, r->ns));
+}
+
+// ---------- Running ----------
+static inline void bench_run(const char* name, BenchFn fn, uint32_t size, uint32_t pixels) {
+    if (g_bench_count >= BENCH_MAX_RESULTS || pixels == 0) return;
+
+    uint32_t iters = BENCH_PIXEL_BUDGET / pixels;
+    if (iters < BENCH_MIN_ITERS) iters = BENCH_MIN_ITERS;
+    if (iters > BENCH_MAX_ITERS) iters = BENCH_MAX_ITERS;
+
+    // One untimed call warms caches and TLB
+    fn(size, 0);
+
+    uint64_t t0 = timer_ns();
+    uint64_t c0 = bench_cycles();
+    for (uint32_t i = 0; i < iters; i++) fn(size, i);
+    uint64_t c1 = bench_cycles();
+    uint64_t t1 = timer_ns();
+
+    BenchResult* r = &g_bench_results[g_bench_count++];
+    r->name = name;
+    r->size = size;
+    r->pixels = pixels;
+    r->iters = iters;
+    r->cycles = c1 - c0;
+    r->ns = t1 - t0;
+
+    BenchLine line;
+    bench_format(&line, r);
+    serial_write(line.text);
+    serial_putc('\n');
+}
+
+// ---------- graphics.h (straight into the LFB) ----------
+static inline void bench_gfx_clear(uint32_t size, uint32_t iter) {
+    (void)size;
+    gfx_clear(bench_color(iter));
+}
+
+static inline void bench_gfx_fill_rect(uint32_t size, uint32_t iter) {
+    gfx_fill_rect(BENCH_X, BENCH_Y, size, size, bench_color(iter));
+}
+
+static inline void bench_gfx_fill_circle(uint32_t size, uint32_t iter) {
+    gfx_fill_circle(BENCH_X + size, BENCH_Y + size, size, bench_color(iter));
+}
+
+static inline void bench_gfx_fill_triangle(uint32_t size, uint32_t iter) {
+    gfx_fill_triangle(BENCH_X, BENCH_Y, BENCH_X + size, BENCH_Y,
+                      BENCH_X, BENCH_Y + size, bench_color(iter));
+}
+
+static inline void bench_font_draw_string(uint32_t size, uint32_t iter) {
+    font_draw_string(BENCH_X, BENCH_Y, g_bench_text, bench_color(iter), size);
+}
+
+// ---------- gpu.h (into the back buffer) ----------
+static inline void bench_gpu_clear(uint32_t size, uint32_t iter) {
+    (void)size;
+    gpu_clear(bench_color(iter));
+}
+
+static inline void bench_gpu_fast_clear(uint32_t size, uint32_t iter) {
+    (void)size;
+    gpu_fast_clear(bench_color(iter));
+}
+
+static inline void bench_gpu_fill_rect(uint32_t size, uint32_t iter) {
+    gpu_fill_rect(BENCH_X, BENCH_Y, size, size, bench_color(iter));
+}
+
+static inline void bench_gpu_fill_circle(uint32_t size, uint32_t iter) {
+    gpu_fill_circle(BENCH_X + size, BENCH_Y + size, size, bench_color(iter));
+}
+
+static inline void bench_gpu_blit_sprite(uint32_t size, uint32_t iter) {
+    g_bench_sprite.width = size;
+    g_bench_sprite.height = size;
+    gpu_blit_sprite(&g_bench_sprite, BENCH_X + (iter & 1), BENCH_Y);
+}
+
+static inline void bench_gpu_blit_sprite_alpha(uint32_t size, uint32_t iter) {
+    g_bench_sprite_alpha.width = size;
+    g_bench_sprite_alpha.height = size;
+    gpu_blit_sprite(&g_bench_sprite_alpha, BENCH_X + (iter & 1), BENCH_Y);
+}
+
+// Icons come in the three test sizes: 16, 64, 256
+static inline uint32_t bench_icon_index(uint32_t size) {
+    return size >= 256 ? 2 : size >= 64 ? 1 : 0;
+}
+
+static inline void bench_gpu_blit_icon(uint32_t size, uint32_t iter) {
+    gpu_blit_sprite(&g_bench_icons[bench_icon_index(size)], BENCH_X + (iter & 1), BENCH_Y);
+}
+
+static inline void bench_gpu_blit_icon_rle(uint32_t size, uint32_t iter) {
+    gpu_blit_sprite_rle(&g_bench_icons_rle[bench_icon_index(size)], BENCH_X + (iter & 1), BENCH_Y);
+}
+
+static inline void bench_gpu_blit_asset_rle(uint32_t size, uint32_t iter) {
+    (void)size;
+    gpu_blit_sprite_rle(&g_bench_asset_rle, BENCH_X + (iter & 1), BENCH_Y);
+}
+
+static inline void bench_gpu_present(uint32_t size, uint32_t iter) {
+    (void)size; (void)iter;
+    gpu_present();
+}
+
+static inline void bench_gpu_present_rect(uint32_t size, uint32_t iter) {
+    (void)iter;
+    gpu_present_rect(BENCH_X, BENCH_Y, size, size);
+}
+
+// ---------- cmdbuf.h (recorded, tiled submission) ----------
+static CmdBuffer g_bench_cmdbuf;
+
+// Opaque 256x256 background, `size` 16x16 fills on top, one label, submit
+static inline void bench_cmd_submit(uint32_t size, uint32_t iter) {
+    CmdBuffer* cb = &g_bench_cmdbuf;
+    Color color = bench_color(iter);
+    cmd_fill_rect(cb, BENCH_X, BENCH_Y, 256, 256, color);
+    for (uint32_t i = 0; i < size; i++) {
+        cmd_fill_rect(cb, BENCH_X + (i & 15) * 16, BENCH_Y + (i >> 4) * 16, 16, 16, color ^ (i << 4));
+    }
+    cmd_text(cb, BENCH_X, BENCH_Y, "cmdbuf", ~color, 1);
+    cmd_submit(cb);
+}
+
+// ---------- display.h (layers and compositor) ----------
+static inline void bench_display_composite(uint32_t size, uint32_t iter) {
+    (void)size; (void)iter;
+    display_composite();
+}
+
+// Move the cursor and run a whole frame; the cursor backend draws it
+// outside the compositor, so the frame itself has nothing to present
+static inline void bench_display_cursor_frame(uint32_t size, uint32_t iter) {
+    (void)size;
+    display_begin_frame();
+    display_set_cursor_position(BENCH_X + (iter & 63), BENCH_Y + 64);
+    display_end_frame();
+}
+
+// Opaque background, translucent main layer, partial UI layer, cursor
+static inline void bench_display_setup(void) {
+    uint32_t w = display_get_width();
+    uint32_t h = display_get_height();
+
+    display_layer_clear(LAYER_BACKGROUND, 0xFF000000 | COLOR_DARK_BG);
+    display_layer_clear(LAYER_MAIN, 0);
+    display_layer_fill_rect(LAYER_MAIN, 0, 0, w / 2, h, 0x80000000 | COLOR_BLUE);
+    display_layer_set_visible(LAYER_UI, 1);
+    display_layer_clear(LAYER_UI, 0);
+    display_layer_fill_rect(LAYER_UI, 0, h - 64, w, 64, 0xFF000000 | COLOR_DARK_GRAY);
+    display_create_default_cursor();
+    display_set_cursor_visible(1);
+}
+
+static inline void bench_sprites_setup(void) {
+    uint32_t count = BENCH_SPRITE_MAX * BENCH_SPRITE_MAX;
+
+    gpu_create_gradient_sprite(&g_bench_sprite, BENCH_SPRITE_MAX, BENCH_SPRITE_MAX,
+                               COLOR_NEON_PINK, COLOR_NEON_BLUE, 1, 0);
+    uint32_t* pixels = g_bench_sprite.pixels;
+
+    // Same pixels at half alpha so every pixel takes the blend path
+    uint32_t* alpha = gpu_sprite_alloc_pixels(BENCH_SPRITE_MAX, BENCH_SPRITE_MAX);
+    if (!pixels || !alpha) return;
+    for (uint32_t i = 0; i < count; i++) alpha[i] = (pixels[i] & 0x00FFFFFF) | 0x80000000;
+    g_bench_sprite_alpha = g_bench_sprite;
+    g_bench_sprite_alpha.pixels = alpha;
+    gpu_sprite_premultiply(&g_bench_sprite_alpha);
+
+    static const uint16_t icon_sizes[3] = { 16, 64, 256 };
+    for (int i = 0; i < 3; i++) {
+        int32_t n = icon_sizes[i], r = n / 2;
+        Sprite* icon = &g_bench_icons[i];
+        gpu_create_solid_sprite(icon, n, n, COLOR_NEON_PINK, 0);
+        if (!icon->pixels) continue;
+        for (int32_t y = 0; y < n; y++) {
+            for (int32_t x = 0; x < n; x++) {
+                int32_t dx = 2 * x + 1 - n, dy = 2 * y + 1 - n;
+                int32_t d2 = dx * dx + dy * dy;
+                uint32_t* p = &icon->pixels[y * n + x];
+                if (d2 > 4 * r * r) *p = 0;
+                else if (d2 > 4 * (r - 2) * (r - 2)) *p = (*p & 0x00FFFFFF) | 0x80000000;
+            }
+        }
+        gpu_sprite_premultiply(icon);
+        gpu_sprite_rle_build(&g_bench_icons_rle[i], icon, 0);
+    }
+}
+
+// The converter's pixels and runs must be exactly what the kernel builds
+// for the same picture
+static inline int bench_asset_setup(void) {
+    const SpriteRLE* want = &g_bench_icons_rle[1];
+    SpriteRLE* got = &g_bench_asset_rle;
+    if (asset_load_sprite("icon64", 0, got) != 0) return -1;
+    if (got->width != want->width || got->height != want->height || got->run_count != want->run_count ||
+        got->opaque_pixels != want->opaque_pixels || got->blended_pixels != want->blended_pixels) {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < (uint32_t)want->width * want->height; i++) {
+        if (got->pixels[i] != want->pixels[i]) return -1;
+    }
+    for (uint32_t y = 0; y <= want->height; y++) {
+        if (got->row_start[y] != want->row_start[y]) return -1;
+    }
+    for (uint32_t i = 0; i < want->run_count; i++) {
+        const SpriteRun* a = &got->runs[i];
+        const SpriteRun* b = &want->runs[i];
+        if (a->x != b->x || a->len != b->len || a->type != b->type) return -1;
+    }
+    return 0;
+}
+
+// ---------- Report ----------
+// Draw the results into the back buffer through g_ctx and present them
+static inline void bench_show_results(void) {
+    g_ctx.framebuffer = g_backbuffer.data;
+    g_ctx.pitch = g_backbuffer.pitch;
+    g_ctx.ops = g_backbuffer.ops;
+
+    gfx_clear(COLOR_DARK_BG);
+    font_draw_string(8, 8, "MINI-OS BENCHMARK", COLOR_NEON_GREEN, 2);
+    font_draw_string(8, 30, "memops:", COLOR_GRAY, 1);
+    font_draw_string(72, 30, memops_get_name(), COLOR_WHITE, 1);
+    font_draw_string(160, 30, "tsc khz:", COLOR_GRAY, 1);
+    font_draw_int(232, 30, (int)timer_get_tsc_khz(), COLOR_WHITE, 1);
+    font_draw_string(336, 30, "pages:", COLOR_GRAY, 1);
+    font_draw_int(392, 30, gpu_get_page_count(), COLOR_WHITE, 1);
+
+    int y = 48;
+    for (uint32_t i = 0; i < g_bench_count && y + FONT_HEIGHT < g_ctx.height; i++) {
+        BenchLine line;
+        bench_format(&line, &g_bench_results[i]);
+        font_draw_string(8, y, line.text + 6, COLOR_WHITE, 1);
+        y += FONT_HEIGHT + 2;
+    }
+
+    gpu_present();
+}
+
+// Leave QEMU with status (code << 1) | 1; halt if the device is not there
+static inline void bench_exit(uint8_t code) {
+    outb(BENCH_EXIT_PORT, code);
+    for (;;) __asm__ volatile ("hlt");
+}
+
+// ---------- Entry ----------
+static inline void bench_main(void) {
+    paging_init();
+    smp_init();
+    serial_init();
+    gfx_init();
+    if (display_init() != 0) {
+        serial_write("BENCH-ERROR no framebuffer\n");
+        bench_exit(1);
+    }
+
+    // Measure raw throughput: never wait for retrace or pace frames
+    display_set_refresh_rate(0);
+
+    uint32_t w = gpu_get_width();
+    uint32_t h = gpu_get_height();
+    uint32_t screen = w * h;
+    static const uint32_t sizes[] = { 16, 64, 256 };
+    static const uint32_t radii[] = { 8, 32, 128 };
+    static const uint32_t scales[] = { 1, 2, 4 };
+
+    serial_write("BENCH-BEGIN ");
+    serial_write_uint(w);
+    serial_putc('x');
+    serial_write_uint(h);
+    serial_putc('x');
+    serial_write_uint(gpu_get_device()->bpp);
+    serial_write(" memops=");
+    serial_write(memops_get_name());
+    serial_write(" tsc_khz=");
+    serial_write_uint(timer_get_tsc_khz());
+    serial_write(" pages=");
+    serial_write_uint(gpu_get_page_count());
+    serial_write(" wc=");
+    serial_write_uint(paging_is_enabled() && g_paging.has_wc);
+    serial_write(" cpus=");
+    serial_write_uint(smp_get_cpu_count());
+    serial_putc('\n');
+
+    bench_run("gfx_clear", bench_gfx_clear, 0, screen);
+    for (int i = 0; i < 3; i++) {
+        bench_run("gfx_fill_rect", bench_gfx_fill_rect, sizes[i], sizes[i] * sizes[i]);
+    }
+    for (int i = 0; i < 3; i++) {
+        bench_run("gfx_fill_circle", bench_gfx_fill_circle, radii[i], bench_circle_area(radii[i]));
+    }
+    for (int i = 0; i < 3; i++) {
+        bench_run("gfx_fill_triangle", bench_gfx_fill_triangle, sizes[i], sizes[i] * sizes[i] / 2);
+    }
+    for (int i = 0; i < 3; i++) {
+        uint32_t cell = FONT_WIDTH * FONT_HEIGHT * scales[i] * scales[i];
+        bench_run("font_draw_string", bench_font_draw_string, scales[i], BENCH_TEXT_LEN * cell);
+    }
+
+    bench_run("gpu_clear", bench_gpu_clear, 0, screen);
+    bench_run("gpu_fast_clear", bench_gpu_fast_clear, 0, screen);
+    for (int i = 0; i < 3; i++) {
+        bench_run("gpu_fill_rect", bench_gpu_fill_rect, sizes[i], sizes[i] * sizes[i]);
+    }
+    for (int i = 0; i < 3; i++) {
+        bench_run("gpu_fill_circle", bench_gpu_fill_circle, radii[i], bench_circle_area(radii[i]));
+    }
+
+    bench_sprites_setup();
+    for (int i = 0; i < 3; i++) {
+        bench_run("gpu_blit_sprite", bench_gpu_blit_sprite, sizes[i], sizes[i] * sizes[i]);
+    }
+    for (int i = 0; i < 3; i++) {
+        bench_run("gpu_blit_sprite_alpha", bench_gpu_blit_sprite_alpha, sizes[i], sizes[i] * sizes[i]);
+    }
+
+    for (int i = 0; i < 3; i++) {
+        bench_run("gpu_blit_icon", bench_gpu_blit_icon, sizes[i], sizes[i] * sizes[i]);
+    }
+    for (int i = 0; i < 3; i++) {
+        bench_run("gpu_blit_icon_rle", bench_gpu_blit_icon_rle, sizes[i], sizes[i] * sizes[i]);
+    }
+    if (bench_asset_setup() != 0) {
+        serial_write("BENCH-ERROR asset icon64 missing or unlike gpu_sprite_rle_build\n");
+        bench_exit(1);
+    }
+    bench_run("gpu_blit_asset_rle", bench_gpu_blit_asset_rle, 64, 64 * 64);
+
+    static const uint32_t counts[] = { 16, 64, 256 };
+    for (int i = 0; i < 3; i++) {
+        bench_run("cmd_submit", bench_cmd_submit, counts[i], 256 * 256 + counts[i] * 16 * 16);
+    }
+
+    bench_run("gpu_present", bench_gpu_present, 0, screen);
+    for (int i = 1; i < 3; i++) {
+        bench_run("gpu_present_rect", bench_gpu_present_rect, sizes[i], sizes[i] * sizes[i]);
+    }
+
+    bench_display_setup();
+    bench_run("display_composite", bench_display_composite, 0, screen);
+    bench_run("display_cursor_frame", bench_display_cursor_frame, 16, 2 * 16 * 16);
+
+    serial_write("BENCH-END ");
+    serial_write_uint(g_bench_count);
+    serial_putc('\n');
+
+    bench_show_results();
+    timer_delay_ns((uint64_t)BENCH_HOLD_MS * 1000000);
+    bench_exit(0);
+}
+
+#endif // BENCH_H
@@ -0,0 +1,355 @@
+#ifndef CMDBUF_H
+#define CMDBUF_H
+
+#include "types.h"
+#include "gpu.h"
+#include "font.h"
+#include "pmm.h"
+#include "jobs.h"
+
+// ============================================================================
+// COMMAND BUFFER FOR MINI-OS
+// Record drawing commands during a frame, then submit them: commands are
+// binned into 64x64 screen tiles (the compositor's tile size), anything a
+// later opaque fill covers in a tile is dropped, and each tile replays its
+// commands with the viewport clipped to the tile. Tiles are independent,
+// so they are spread over every CPU with jobs.h.
+// ============================================================================
+
+#define CMD_MAX             1024    // Commands per submit (recording flushes when full)
+#define CMD_TEXT_BYTES      16384   // Text copied per submit
+#define CMD_BIN_ENTRIES     16384   // Command-in-tile references per submit
+
+// Same tiles as the compositor (DISPLAY_TILE_SHIFT)
+#define CMD_TILE_SHIFT      6
+#define CMD_TILE_SIZE       (1 << CMD_TILE_SHIFT)
+#define CMD_MAX_TILES_X     (2048 >> CMD_TILE_SHIFT)
+#define CMD_MAX_TILES_Y     (1536 >> CMD_TILE_SHIFT)
+
+#define CMD_BIN_END         0xFFFF
+
+typedef enum {
+    CMD_FILL_RECT = 0,
+    CMD_BLIT_SPRITE,
+    CMD_TEXT,
+    CMD_LINE,
+    CMD_FILL_CIRCLE,
+} CmdType;
+
+typedef struct {
+    uint8_t type;           // CmdType
+    uint8_t opaque;         // Writes every pixel of bounds without reading them
+    uint8_t scale;          // Text scale
+    uint8_t _pad;
+    Rect bounds;            // Screen pixels the command may touch (clipped)
+    Color color;
+    union {
+        struct { const Sprite* sprite; int32_t x, y; } blit;
+        struct { const char* str; int32_t x, y; } text;
+        struct { int32_t x0, y0, x1, y1; } line;
+        struct { int32_t cx, cy, r; } circle;
+    };
+} Cmd;
+
+typedef struct {
+    uint16_t cmd;
+    uint16_t next;
+} CmdBinEntry;
+
+typedef struct {
+    uint16_t head;
+    uint16_t tail;
+    uint16_t count;
+} CmdBin;
+
+typedef struct {
+    Arena arena;            // Commands, bin entries, then per-submit text
+    uint32_t text_mark;     // Arena position where text starts
+    Cmd* cmds;
+    uint32_t count;
+    CmdBinEntry* entries;
+    uint32_t entry_count;
+    CmdBin bins[CMD_MAX_TILES_Y][CMD_MAX_TILES_X];
+    uint16_t tiles_x, tiles_y;
+    uint8_t ready;
+    // Statistics since cmd_init
+    uint32_t recorded;      // Commands recorded
+    uint32_t merged;        // Fills folded into the previous fill
+    uint32_t culled;        // Command-in-tile entries dropped as covered
+    uint32_t executed;      // Command-in-tile entries replayed
+} CmdBuffer;
+
+// ---------- Setup ----------
+static inline int cmd_init(CmdBuffer* cb) {
+    uint32_t cmd_bytes = CMD_MAX * sizeof(Cmd);
+    uint32_t entry_bytes = CMD_BIN_ENTRIES * sizeof(CmdBinEntry);
+    if (!cb->ready) {
+        if (arena_init(&cb->arena, cmd_bytes + entry_bytes + CMD_TEXT_BYTES) != 0) return -1;
+        cb->cmds = (Cmd*)arena_alloc(&cb->arena, cmd_bytes, 16);
+        cb->entries = (CmdBinEntry*)arena_alloc(&cb->arena, entry_bytes, 16);
+        cb->text_mark = arena_save(&cb->arena);
+        cb->ready = 1;
+    }
+    cb->count = 0;
+    cb->recorded = cb->merged = cb->culled = cb->executed = 0;
+    arena_restore(&cb->arena, cb->text_mark);
+    return 0;
+}
+
+// Clip to the back buffer; returns 0 when nothing is left
+static inline int cmd_screen_clip(Rect* r) {
+    Rect screen = {0, 0, g_backbuffer.width, g_backbuffer.height};
+    return rect_intersect(r, &screen, r);
+}
+
+static inline void cmd_submit(CmdBuffer* cb);
+
+static inline Cmd* cmd_push(CmdBuffer* cb, uint8_t type, Rect bounds, Color color) {
+    if (!cb->ready && cmd_init(cb) != 0) return 0;
+    if (!cmd_screen_clip(&bounds)) return 0;
+    if (cb->count >= CMD_MAX) cmd_submit(cb);
+
+    Cmd* c = &cb->cmds[cb->count++];
+    c->type = type;
+    c->opaque = 0;
+    c->bounds = bounds;
+    c->color = color;
+    cb->recorded++;
+    return c;
+}
+
+// ---------- Recording ----------
+// Two fills of one color that share an edge become one rectangle. Only the
+// previous command is considered so the draw order never changes.
+static inline int cmd_try_merge_fill(CmdBuffer* cb, const Rect* r, Color color) {
+    if (cb->count == 0) return 0;
+    Cmd* last = &cb->cmds[cb->count - 1];
+    if (last->type != CMD_FILL_RECT || last->color != color) return 0;
+
+    Rect* b = &last->bounds;
+    if (b->y == r->y && b->height == r->height &&
+        (b->x + (int32_t)b->width == r->x || r->x + (int32_t)r->width == b->x)) {
+        if (r->x < b->x) b->x = r->x;
+        b->width += r->width;
+    } else if (b->x == r->x && b->width == r->width &&
+               (b->y + (int32_t)b->height == r->y || r->y + (int32_t)r->height == b->y)) {
+        if (r->y < b->y) b->y = r->y;
+        b->height += r->height;
+    } else if (!rect_contains(b, r)) {
+        return 0;
+    }
+    cb->merged++;
+    cb->recorded++;
+    return 1;
+}
+
+static inline void cmd_fill_rect(CmdBuffer* cb, int32_t x, int32_t y, uint32_t w, uint32_t h, Color color) {
+    Rect r = {x, y, w, h};
+    if (!cmd_screen_clip(&r)) return;
+    if (cmd_try_merge_fill(cb, &r, color)) return;
+    Cmd* c = cmd_push(cb, CMD_FILL_RECT, r, color);
+    if (c) c->opaque = 1;
+}
+
+// The sprite must stay alive until the next submit
+static inline void cmd_blit_sprite(CmdBuffer* cb, const Sprite* sprite, int32_t x, int32_t y) {
+    if (!sprite || !sprite->pixels) return;
+    Rect r = {x, y, sprite->width, sprite->height};
+    Cmd* c = cmd_push(cb, CMD_BLIT_SPRITE, r, 0);
+    if (!c) return;
+    c->blit.sprite = sprite;
+    c->blit.x = x;
+    c->blit.y = y;
+}
+
+// The string is copied, so it may change right after the call
+static inline void cmd_text(CmdBuffer* cb, int32_t x, int32_t y, const char* str, Color color, int scale) {
+    if (!cb->ready && cmd_init(cb) != 0) return;
+
+    // Bounds of the laid-out text (lines are FONT_HEIGHT + 1 cells apart)
+    uint32_t len = 0, lines = 1, col = 0, widest = 0;
+    for (const char* p = str; *p; p++, len++) {
+        if (*p == '\n') { lines++; col = 0; continue; }
+        if (++col > widest) widest = col;
+    }
+    Rect r = {x, y, widest * FONT_WIDTH * scale, (lines * (FONT_HEIGHT + 1) - 1) * scale};
+    if (!cmd_screen_clip(&r)) return;
+
+    // Flush first if needed: that would free the copy
+    if (cb->count >= CMD_MAX) cmd_submit(cb);
+    char* copy = (char*)arena_alloc(&cb->arena, len + 1, 1);
+    if (!copy) {
+        cmd_submit(cb);
+        copy = (char*)arena_alloc(&cb->arena, len + 1, 1);
+        if (!copy) return;
+    }
+    for (uint32_t i = 0; i <= len; i++) copy[i] = str[i];
+
+    Cmd* c = cmd_push(cb, CMD_TEXT, r, color);
+    if (!c) return;
+    c->scale = scale;
+    c->text.str = copy;
+    c->text.x = x;
+    c->text.y = y;
+}
+
+static inline void cmd_line(CmdBuffer* cb, int32_t x0, int32_t y0, int32_t x1, int32_t y1, Color color) {
+    Rect r = {x0 < x1 ? x0 : x1, y0 < y1 ? y0 : y1,
+              (uint32_t)gpu_abs(x1 - x0) + 1, (uint32_t)gpu_abs(y1 - y0) + 1};
+    Cmd* c = cmd_push(cb, CMD_LINE, r, color);
+    if (!c) return;
+    c->line.x0 = x0;
+    c->line.y0 = y0;
+    c->line.x1 = x1;
+    c->line.y1 = y1;
+}
+
+static inline void cmd_fill_circle(CmdBuffer* cb, int32_t cx, int32_t cy, int32_t radius, Color color) {
+    if (radius < 0) return;
+    Rect r = {cx - radius, cy - radius, (uint32_t)radius * 2 + 1, (uint32_t)radius * 2 + 1};
+    Cmd* c = cmd_push(cb, CMD_FILL_CIRCLE, r, color);
+    if (!c) return;
+    c->circle.cx = cx;
+    c->circle.cy = cy;
+    c->circle.r = radius;
+}
+
+// ---------- Binning ----------
+static inline void cmd_tile_rect(const CmdBuffer* cb, uint32_t tx, uint32_t ty, Rect* out) {
+    (void)cb;
+    Rect r = {(int32_t)(tx << CMD_TILE_SHIFT), (int32_t)(ty << CMD_TILE_SHIFT), CMD_TILE_SIZE, CMD_TILE_SIZE};
+    cmd_screen_clip(&r);
+    *out = r;
+}
+
+// Build the per-tile lists. Returns -1 when the entry budget runs out.
+static inline int cmd_bin(CmdBuffer* cb) {
+    cb->tiles_x = (g_backbuffer.width + CMD_TILE_SIZE - 1) >> CMD_TILE_SHIFT;
+    cb->tiles_y = (g_backbuffer.height + CMD_TILE_SIZE - 1) >> CMD_TILE_SHIFT;
+    if (cb->tiles_x > CMD_MAX_TILES_X || cb->tiles_y > CMD_MAX_TILES_Y) return -1;
+
+    for (uint32_t ty = 0; ty < cb->tiles_y; ty++) {
+        for (uint32_t tx = 0; tx < cb->tiles_x; tx++) {
+            CmdBin* bin = &cb->bins[ty][tx];
+            bin->head = bin->tail = CMD_BIN_END;
+            bin->count = 0;
+        }
+    }
+    cb->entry_count = 0;
+
+    for (uint32_t i = 0; i < cb->count; i++) {
+        const Cmd* c = &cb->cmds[i];
+        uint32_t tx0 = c->bounds.x >> CMD_TILE_SHIFT;
+        uint32_t ty0 = c->bounds.y >> CMD_TILE_SHIFT;
+        uint32_t tx1 = (c->bounds.x + c->bounds.width - 1) >> CMD_TILE_SHIFT;
+        uint32_t ty1 = (c->bounds.y + c->bounds.height - 1) >> CMD_TILE_SHIFT;
+
+        for (uint32_t ty = ty0; ty <= ty1; ty++) {
+            for (uint32_t tx = tx0; tx <= tx1; tx++) {
+                CmdBin* bin = &cb->bins[ty][tx];
+
+                // An opaque command over the whole tile hides everything before it
+                if (c->opaque && bin->count) {
+                    Rect tile;
+                    cmd_tile_rect(cb, tx, ty, &tile);
+                    if (rect_contains(&c->bounds, &tile)) {
+                        cb->culled += bin->count;
+                        bin->head = bin->tail = CMD_BIN_END;
+                        bin->count = 0;
+                    }
+                }
+
+                if (cb->entry_count >= CMD_BIN_ENTRIES) return -1;
+                uint16_t e = cb->entry_count++;
+                cb->entries[e].cmd = i;
+                cb->entries[e].next = CMD_BIN_END;
+                if (bin->tail == CMD_BIN_END) bin->head = e;
+                else cb->entries[bin->tail].next = e;
+                bin->tail = e;
+                bin->count++;
+            }
+        }
+    }
+    return 0;
+}
+
+// ---------- Execution ----------
+// Text goes through graphics.h: g_ctx is pointed at the viewport's corner
+// of the back buffer so its own clipping keeps text inside the tile
+static inline void cmd_target_text(void) {
+    uint32_t bytes_pp = g_backbuffer.bpp / 8;
+    g_ctx.framebuffer = g_backbuffer.data + g_viewport.y * g_backbuffer.pitch + g_viewport.x * bytes_pp;
+    g_ctx.width = g_viewport.width;
+    g_ctx.height = g_viewport.height;
+    g_ctx.pitch = g_backbuffer.pitch;
+    g_ctx.bpp = g_backbuffer.bpp;
+    g_ctx.ops = g_backbuffer.ops;
+}
+
+static inline void cmd_execute(const Cmd* c) {
+    switch (c->type) {
+        case CMD_FILL_RECT:
+            gpu_fill_rect(c->bounds.x, c->bounds.y, c->bounds.width, c->bounds.height, c->color);
+            break;
+        case CMD_BLIT_SPRITE:
+            gpu_blit_sprite(c->blit.sprite, c->blit.x, c->blit.y);
+            break;
+        case CMD_TEXT:
+            font_draw_string(c->text.x - g_viewport.x, c->text.y - g_viewport.y,
+                             c->text.str, c->color, c->scale);
+            break;
+        case CMD_LINE:
+            gpu_draw_line(c->line.x0, c->line.y0, c->line.x1, c->line.y1, c->color);
+            break;
+        case CMD_FILL_CIRCLE:
+            gpu_fill_circle(c->circle.cx, c->circle.cy, c->circle.r, c->color);
+            break;
+    }
+}
+
+// Replay one tile's list with the viewport (and text target) on the tile
+static inline void cmd_render_tile(CmdBuffer* cb, uint32_t tx, uint32_t ty) {
+    CmdBin* bin = &cb->bins[ty][tx];
+    if (bin->head == CMD_BIN_END) return;
+
+    Rect tile;
+    cmd_tile_rect(cb, tx, ty, &tile);
+    gpu_set_viewport(tile.x, tile.y, tile.width, tile.height);
+    cmd_target_text();
+
+    for (uint16_t e = bin->head; e != CMD_BIN_END; e = cb->entries[e].next) {
+        cmd_execute(&cb->cmds[cb->entries[e].cmd]);
+    }
+}
+
+static inline void cmd_tile_job(void* arg, uint32_t index) {
+    CmdBuffer* cb = (CmdBuffer*)arg;
+    cmd_render_tile(cb, index % cb->tiles_x, index / cb->tiles_x);
+}
+
+// Draw everything recorded so far into the back buffer and start over.
+// Falls back to plain in-order drawing if the tile lists do not fit.
+static inline void cmd_submit(CmdBuffer* cb) {
+    if (!cb->ready || cb->count == 0) return;
+    GraphicsContext saved_ctx = g_ctx;
+    Viewport saved_viewport = g_viewport;
+
+    uint32_t culled = cb->culled;
+    if (cmd_bin(cb) == 0) {
+        font_init();    // Shared glyph tables must exist before workers draw text
+        jobs_parallel_for(cmd_tile_job, cb, cb->tiles_x * cb->tiles_y);
+        cb->executed += cb->entry_count - (cb->culled - culled);
+    } else {
+        gpu_reset_viewport();
+        cmd_target_text();
+        for (uint32_t i = 0; i < cb->count; i++) cmd_execute(&cb->cmds[i]);
+        cb->executed += cb->count;
+    }
+
+    g_viewport = saved_viewport;
+    g_ctx = saved_ctx;
+    cb->count = 0;
+    arena_restore(&cb->arena, cb->text_mark);
+}
+
+#endif // CMDBUF_H
@@ -1,28 +1,78 @@
 #!/bin/bash
 set -e
 
-echo "[1] Build kernel (32-bit ELF)..."
-clang --target=i386-elf -m32 -ffreestanding -fno-pie -nostdlib -O2 -c kernel.c -o kernel.o
-nasm -f elf32 kernel_entry.asm -o kernel_entry.o
-ld.lld -m elf_i386 -T kernel.ld kernel_entry.o kernel.o -o kernel.elf
+# ./compile-and-run.sh            normal build
+# ./compile-and-run.sh --bench    benchmark build: results on screen and stdout, QEMU exits when done
+# ./compile-and-run.sh --profile  profiler build: per-stage frame times drawn over the screen
+BENCH=0
+PROFILE=0
+for arg in "$@"; do
+  if [ "$arg" = "--bench" ]; then
+    BENCH=1
+  elif [ "$arg" = "--profile" ]; then
+    PROFILE=1
+  fi
+done
 
-echo "[2] Convert kernel ELF -> flat binary..."
-if command -v llvm-objcopy >/dev/null 2>&1; then
-  llvm-objcopy -O binary kernel.elf kernel.bin
-else
-  objcopy -O binary kernel.elf kernel.bin
+CFLAGS=""
+if [ "$BENCH" = 1 ]; then
+  CFLAGS="-DBENCHMARK"
+fi
+if [ "$PROFILE" = 1 ]; then
+  CFLAGS="$CFLAGS -DPROFILE"
 fi
 
-echo "[3] Build boot sector..."
+echo "[1] Convert assets/*.png to sprites..."
+# The blob goes into .rodata.assets; no PNGs gives an empty blob
+shopt -s nullglob
+python3 tools/png2sprite.py -o assets.bin assets/*.png
+shopt -u nullglob
+# 16-byte aligned like the assets inside it (objcopy leaves the section at 1)
+if command -v llvm-objcopy >/dev/null 2>&1; then OBJCOPY=llvm-objcopy; else OBJCOPY=objcopy; fi
+$OBJCOPY -I binary -O elf32-i386 -B i386 \
+  --rename-section .data=.rodata.assets,alloc,load,readonly,data,contents \
+  --set-section-alignment .data=16 \
+  assets.bin assets.o
+
+echo "[2] Build kernel (32-bit ELF)..."
+clang --target=i386-elf -m32 -ffreestanding -fno-pie -nostdlib -O2 $CFLAGS -c kernel.c -o kernel.o
+nasm -f elf32 kernel_entry.asm -o kernel_entry.o
+ld.lld -m elf_i386 -T kernel.ld kernel_entry.o kernel.o assets.o -o kernel.elf
+
+echo "[3] Convert kernel ELF -> flat binary..."
+$OBJCOPY -O binary kernel.elf kernel.bin
+
+echo "[4] Build boot sector and stage 2 loader..."
 nasm -f bin boot.asm -o boot.bin
+nasm -f bin stage2.asm -o stage2.bin
 
-echo "[4] Create floppy disk image..."
-dd if=/dev/zero of=disk.img bs=512 count=2880 2>/dev/null
+echo "[5] Create hard disk image..."
+# LBA 0 boot sector, LBA 1-4 stage 2, LBA 5 on the kernel (its header holds the size)
+dd if=/dev/zero of=disk.img bs=1M count=4 2>/dev/null
 dd if=boot.bin of=disk.img conv=notrunc 2>/dev/null
-dd if=kernel.bin of=disk.img bs=512 seek=1 conv=notrunc 2>/dev/null
+dd if=stage2.bin of=disk.img bs=512 seek=1 conv=notrunc 2>/dev/null
+dd if=kernel.bin of=disk.img bs=512 seek=5 conv=notrunc 2>/dev/null
+
+echo "[6] Run in QEMU..."
+if [ "$BENCH" = 1 ]; then
+  # isa-debug-exit turns a write of 0 into exit status 1
+  status=0
+  qemu-system-x86_64 \
+    -drive file=disk.img,format=raw,if=ide \
+    -boot order=c \
+    -net none \
+    -smp 4 \
+    -serial stdio \
+    -device isa-debug-exit,iobase=0xf4,iosize=0x04 || status=$?
+  if [ "$status" -ne 1 ]; then
+    echo "Benchmark failed (QEMU exit status $status)"
+    exit 1
+  fi
+  exit 0
+fi
 
-echo "[5] Run in QEMU..."
 qemu-system-x86_64 \
-  -drive file=disk.img,format=raw,if=floppy \
-  -boot order=a \
-  -net none
+  -drive file=disk.img,format=raw,if=ide \
+  -boot order=c \
+  -net none \
+  -smp 4
@@ -0,0 +1,209 @@
+#ifndef CPU_H
+#define CPU_H
+
+#include <stdint.h>
+
+// ============================================================================
+// CPU FEATURES FOR MINI-OS
+// CPUID detection and control register access
+// ============================================================================
+
+// CPUID leaf 1 feature bits
+#define CPUID_EDX_PSE       (1u << 3)
+#define CPUID_EDX_TSC       (1u << 4)
+#define CPUID_EDX_MSR       (1u << 5)
+#define CPUID_EDX_PAT       (1u << 16)
+#define CPUID_EDX_SSE       (1u << 25)
+#define CPUID_EDX_SSE2      (1u << 26)
+#define CPUID_ECX_XSAVE     (1u << 26)
+#define CPUID_ECX_OSXSAVE   (1u << 27)
+#define CPUID_ECX_AVX       (1u << 28)
+
+// Control register bits
+#define CR0_MP              (1u << 1)
+#define CR0_EM              (1u << 2)
+#define CR0_PG              (1u << 31)
+#define CR4_PSE             (1u << 4)
+#define CR4_OSFXSR          (1u << 9)
+#define CR4_OSXMMEXCPT      (1u << 10)
+#define CR4_OSXSAVE         (1u << 18)
+
+// Model-specific registers
+#define MSR_IA32_APIC_BASE  0x1B
+#define MSR_IA32_PAT        0x277
+
+// XCR0 state components
+#define XCR0_X87            (1u << 0)
+#define XCR0_SSE            (1u << 1)
+#define XCR0_AVX            (1u << 2)
+
+// ---------- Detected features ----------
+typedef struct {
+    uint32_t max_leaf;
+    uint32_t features_ecx;
+    uint32_t features_edx;
+    uint8_t  has_sse2;      // SSE2 usable (kernel_entry enabled OSFXSR)
+    uint8_t  has_avx;       // AVX usable (XCR0 has YMM state enabled)
+    uint8_t  has_tsc;
+    uint8_t  has_pse;       // 4 MB pages
+    uint8_t  has_pat;       // Page attribute table (needs MSRs)
+    uint8_t  initialized;
+} CPUInfo;
+
+static CPUInfo g_cpu;
+
+// ---------- Raw access ----------
+static inline void cpuid(uint32_t leaf, uint32_t subleaf,
+                         uint32_t* a, uint32_t* b, uint32_t* c, uint32_t* d) {
+    __asm__ volatile ("cpuid"
+                      : "=a"(*a), "=b"(*b), "=c"(*c), "=d"(*d)
+                      : "a"(leaf), "c"(subleaf));
+}
+
+static inline uint32_t read_cr0(void) {
+    uint32_t v;
+    __asm__ volatile ("mov %%cr0, %0" : "=r"(v));
+    return v;
+}
+
+static inline void write_cr0(uint32_t v) {
+    __asm__ volatile ("mov %0, %%cr0" : : "r"(v) : "memory");
+}
+
+static inline uint32_t read_cr4(void) {
+    uint32_t v;
+    __asm__ volatile ("mov %%cr4, %0" : "=r"(v));
+    return v;
+}
+
+static inline void write_cr4(uint32_t v) {
+    __asm__ volatile ("mov %0, %%cr4" : : "r"(v) : "memory");
+}
+
+static inline uint32_t read_cr3(void) {
+    uint32_t v;
+    __asm__ volatile ("mov %%cr3, %0" : "=r"(v));
+    return v;
+}
+
+static inline void write_cr3(uint32_t v) {
+    __asm__ volatile ("mov %0, %%cr3" : : "r"(v) : "memory");
+}
+
+static inline uint64_t rdmsr(uint32_t msr) {
+    uint32_t lo, hi;
+    __asm__ volatile ("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t value) {
+    __asm__ volatile ("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)) : "memory");
+}
+
+static inline void wbinvd(void) {
+    __asm__ volatile ("wbinvd" : : : "memory");
+}
+
+static inline uint64_t xgetbv(uint32_t index) {
+    uint32_t lo, hi;
+    __asm__ volatile ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(index));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void xsetbv(uint32_t index, uint64_t value) {
+    __asm__ volatile ("xsetbv" : : "c"(index), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    __asm__ volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+// ---------- Per-CPU identity ----------
+// CPUs are numbered 0 (the BSP) to CPU_MAX - 1. Every CPU runs with FS
+// loaded with its own flat data selector, GDT_DATA + 8 * index, so finding
+// the index is one register read. The BSP keeps the boot loader's FS and
+// is CPU 0 without any setup; smp.h gives APs their selectors.
+#define CPU_MAX             16
+#define GDT_CODE            0x08
+#define GDT_DATA            0x10
+
+static inline uint32_t cpu_index(void) {
+    uint16_t sel;
+    __asm__ ("mov %%fs, %0" : "=r"(sel));
+    return (uint32_t)(sel - GDT_DATA) >> 3;
+}
+
+// ---------- Idling ----------
+#define EFLAGS_IF           (1u << 9)
+
+static inline int cpu_interrupts_enabled(void) {
+    uint32_t flags;
+    __asm__ volatile ("pushf\n\tpop %0" : "=r"(flags));
+    return (flags & EFLAGS_IF) != 0;
+}
+
+// Background work run from every idle poll (e.g. draining telemetry)
+typedef void (*CPUIdleHook)(void);
+static CPUIdleHook g_cpu_idle_hook;
+
+static inline void cpu_set_idle_hook(CPUIdleHook hook) {
+    g_cpu_idle_hook = hook;
+}
+
+static inline void cpu_relax(void) {
+    __asm__ volatile ("pause" ::: "memory");
+}
+
+// Wait a little: sleep until the next interrupt when one can arrive,
+// otherwise just relax the pipeline
+static inline void cpu_idle(void) {
+    if (g_cpu_idle_hook) g_cpu_idle_hook();
+    if (cpu_interrupts_enabled()) {
+        __asm__ volatile ("hlt");
+    } else {
+        __asm__ volatile ("pause");
+    }
+}
+
+// ---------- Initialization ----------
+// Detect features and turn on AVX state if the CPU has it.
+// SSE itself is enabled in kernel_entry.asm before any C code runs.
+static inline void cpu_init(void) {
+    if (g_cpu.initialized) return;
+
+    uint32_t a, b, c, d;
+    cpuid(0, 0, &a, &b, &c, &d);
+    g_cpu.max_leaf = a;
+
+    if (g_cpu.max_leaf >= 1) {
+        cpuid(1, 0, &a, &b, &c, &d);
+        g_cpu.features_ecx = c;
+        g_cpu.features_edx = d;
+    }
+
+    g_cpu.has_tsc = (g_cpu.features_edx & CPUID_EDX_TSC) != 0;
+    g_cpu.has_pse = (g_cpu.features_edx & CPUID_EDX_PSE) != 0;
+    g_cpu.has_pat = (g_cpu.features_edx & CPUID_EDX_PAT) && (g_cpu.features_edx & CPUID_EDX_MSR);
+    g_cpu.has_sse2 = (g_cpu.features_edx & CPUID_EDX_SSE2) && (read_cr4() & CR4_OSFXSR);
+
+    if (g_cpu.has_sse2 && (g_cpu.features_ecx & CPUID_ECX_XSAVE) &&
+        (g_cpu.features_ecx & CPUID_ECX_AVX)) {
+        write_cr4(read_cr4() | CR4_OSXSAVE);
+        xsetbv(0, xgetbv(0) | XCR0_X87 | XCR0_SSE | XCR0_AVX);
+        g_cpu.has_avx = (xgetbv(0) & (XCR0_SSE | XCR0_AVX)) == (XCR0_SSE | XCR0_AVX);
+    }
+
+    g_cpu.initialized = 1;
+}
+
+// Per-CPU part of the setup for an AP: same AVX state as the BSP found
+static inline void cpu_init_local(void) {
+    if (g_cpu.has_avx) {
+        write_cr4(read_cr4() | CR4_OSXSAVE);
+        xsetbv(0, xgetbv(0) | XCR0_X87 | XCR0_SSE | XCR0_AVX);
+    }
+}
+
+#endif // CPU_H
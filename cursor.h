@@ -0,0 +1,213 @@
+#ifndef CURSOR_H
+#define CURSOR_H
+
+#include "types.h"
+#include "gpu.h"
+
+// ============================================================================
+// MOUSE CURSOR FOR MINI-OS
+// One backend per device, picked at cursor_init. Hardware backends move the
+// cursor with a register write. The software backend draws straight into
+// the page being scanned out and keeps the pixels it covered (save-under),
+// so a move restores one cursor-sized rect and draws another: the
+// compositor never sees the cursor. Presents that would overwrite or flip
+// away from it are bracketed by cursor_begin_present / cursor_end_present.
+// ============================================================================
+
+#define CURSOR_MAX_SIZE     32
+
+typedef struct {
+    const char* name;
+    // Premultiplied ARGB, hotspot inside the image
+    int  (*define)(const uint32_t* pixels, uint16_t w, uint16_t h, int16_t hot_x, int16_t hot_y);
+    void (*update)(void);       // Position or visibility changed
+    // Optional: around presents of these screen rects (flips pass 0, 0)
+    void (*begin_present)(const Rect* rects, uint32_t count);
+    void (*end_present)(void);
+} CursorOps;
+
+typedef struct {
+    const CursorOps* ops;
+    uint32_t image[CURSOR_MAX_SIZE * CURSOR_MAX_SIZE];
+    uint32_t under[CURSOR_MAX_SIZE * CURSOR_MAX_SIZE];  // Software: front pixels beneath it
+    uint16_t width, height;
+    int16_t  hot_x, hot_y;
+    int32_t  x, y;              // Hotspot on screen
+    uint8_t  visible;
+    uint8_t  drawn;             // Software: image is on the front page over `drawn_rect`
+    uint8_t  hw_shown;          // Hardware: device is showing the shape
+    uint8_t  hw_shape;          // Hardware: shape changed since it was last shown
+    Rect     drawn_rect;
+} CursorState;
+
+static CursorState g_cursor;
+
+// ---------- Software backend ----------
+static inline Rect cursor_sw_rect(void) {
+    Rect r = {g_cursor.x - g_cursor.hot_x, g_cursor.y - g_cursor.hot_y, g_cursor.width, g_cursor.height};
+    Rect screen = {0, 0, g_gpu.width, g_gpu.height};
+    if (!rect_intersect(&r, &screen, &r)) r.width = r.height = 0;
+    return r;
+}
+
+// Put back what the cursor covers
+static inline void cursor_sw_hide(void) {
+    if (!g_cursor.drawn) return;
+    g_cursor.drawn = 0;
+
+    const Rect* r = &g_cursor.drawn_rect;
+    uint8_t* front = gpu_front_addr();
+    for (uint32_t dy = 0; dy < r->height; dy++) {
+        g_backbuffer.ops->copy(front + (r->y + dy) * g_gpu.pitch, r->x,
+                               g_cursor.under + dy * CURSOR_MAX_SIZE, r->width);
+    }
+}
+
+// Save the pixels underneath, then blend the image over a copy of them
+static inline void cursor_sw_draw(void) {
+    if (g_cursor.drawn || !g_cursor.visible || !g_cursor.width) return;
+    Rect r = cursor_sw_rect();
+    if (rect_is_empty(&r)) return;
+
+    uint32_t row[CURSOR_MAX_SIZE];
+    int32_t ix = r.x - (g_cursor.x - g_cursor.hot_x);
+    int32_t iy = r.y - (g_cursor.y - g_cursor.hot_y);
+    uint8_t* front = gpu_front_addr();
+    for (uint32_t dy = 0; dy < r.height; dy++) {
+        uint8_t* line = front + (r.y + dy) * g_gpu.pitch;
+        uint32_t* under = g_cursor.under + dy * CURSOR_MAX_SIZE;
+        for (uint32_t i = 0; i < r.width; i++) {
+            under[i] = g_backbuffer.ops->get(line, r.x + i);
+            row[i] = under[i];
+        }
+        g_blend_row(row, g_cursor.image + (iy + dy) * CURSOR_MAX_SIZE + ix, r.width, 255);
+        g_backbuffer.ops->copy(line, r.x, row, r.width);
+    }
+    g_cursor.drawn_rect = r;
+    g_cursor.drawn = 1;
+}
+
+static inline int cursor_sw_define(const uint32_t* pixels, uint16_t w, uint16_t h,
+                                   int16_t hot_x, int16_t hot_y) {
+    (void)pixels; (void)w; (void)h; (void)hot_x; (void)hot_y;
+    return 0;       // Drawn from g_cursor.image
+}
+
+static inline void cursor_sw_update(void) {
+    cursor_sw_hide();
+    cursor_sw_draw();
+}
+
+// Only a copy that lands on the cursor, or a flip, needs it out of the way
+static inline void cursor_sw_begin_present(const Rect* rects, uint32_t count) {
+    if (!g_cursor.drawn) return;
+    if (g_swap.pages) {
+        cursor_sw_hide();
+        return;
+    }
+    Rect in;
+    for (uint32_t i = 0; i < count; i++) {
+        if (rect_intersect(&rects[i], &g_cursor.drawn_rect, &in)) {
+            cursor_sw_hide();
+            return;
+        }
+    }
+}
+
+static const CursorOps g_cursor_sw = {
+    "software", cursor_sw_define, cursor_sw_update, cursor_sw_begin_present, cursor_sw_draw,
+};
+
+// ---------- VMware SVGA backend ----------
+static inline void cursor_vmware_update(void) {
+    vmware_move_cursor(g_cursor.x, g_cursor.y, g_cursor.visible);
+}
+
+static const CursorOps g_cursor_vmware = {
+    "vmware-svga", vmware_define_cursor, cursor_vmware_update, 0, 0,
+};
+
+// ---------- virtio-gpu backend ----------
+// A move is one MOVE_CURSOR on the cursor queue; shape or visibility
+// changes resend UPDATE_CURSOR
+static inline int cursor_virtio_define(const uint32_t* pixels, uint16_t w, uint16_t h,
+                                       int16_t hot_x, int16_t hot_y) {
+    (void)hot_x; (void)hot_y;
+    if (virtio_gpu_define_cursor(pixels, w, h) != 0) return -1;
+    g_cursor.hw_shape = 1;
+    return 0;
+}
+
+static inline void cursor_virtio_update(void) {
+    uint8_t show = g_cursor.visible && g_cursor.width;
+    if (g_cursor.hw_shape || show != g_cursor.hw_shown) {
+        virtio_gpu_show_cursor(g_cursor.x, g_cursor.y, g_cursor.hot_x, g_cursor.hot_y, show);
+        g_cursor.hw_shown = show;
+        g_cursor.hw_shape = 0;
+    } else if (show) {
+        virtio_gpu_move_cursor(g_cursor.x, g_cursor.y);
+    }
+}
+
+static const CursorOps g_cursor_virtio = {
+    "virtio-gpu", cursor_virtio_define, cursor_virtio_update, 0, 0,
+};
+
+// ---------- Interface ----------
+// Call after gpu_init (again after a mode change); the cursor starts hidden
+static inline void cursor_init(void) {
+    g_cursor.ops = &g_cursor_sw;
+    if (g_gpu_hw.type == GPU_HW_VMWARE_SVGA && g_gpu_hw.has_cursor) g_cursor.ops = &g_cursor_vmware;
+    if (g_gpu.type == GPU_TYPE_VIRTIO) g_cursor.ops = &g_cursor_virtio;
+    g_cursor.visible = 0;
+    g_cursor.drawn = 0;
+    g_cursor.hw_shown = 0;
+    g_cursor.hw_shape = 0;
+    g_cursor.x = g_gpu.width / 2;
+    g_cursor.y = g_gpu.height / 2;
+}
+
+// Image is copied; a hardware backend that refuses it falls back to software
+static inline int cursor_define(const uint32_t* pixels, uint16_t w, uint16_t h, int16_t hot_x, int16_t hot_y) {
+    if (w > CURSOR_MAX_SIZE || h > CURSOR_MAX_SIZE) return -1;
+    cursor_sw_hide();
+
+    for (uint32_t y = 0; y < h; y++) {
+        for (uint32_t x = 0; x < w; x++) g_cursor.image[y * CURSOR_MAX_SIZE + x] = pixels[y * w + x];
+    }
+    g_cursor.width = w;
+    g_cursor.height = h;
+    g_cursor.hot_x = hot_x;
+    g_cursor.hot_y = hot_y;
+
+    if (g_cursor.ops->define(pixels, w, h, hot_x, hot_y) != 0) g_cursor.ops = &g_cursor_sw;
+    g_cursor.ops->update();
+    return 0;
+}
+
+static inline void cursor_move(int32_t x, int32_t y) {
+    if (x == g_cursor.x && y == g_cursor.y) return;
+    g_cursor.x = x;
+    g_cursor.y = y;
+    g_cursor.ops->update();
+}
+
+static inline void cursor_show(uint8_t visible) {
+    if (visible == g_cursor.visible) return;
+    g_cursor.visible = visible;
+    g_cursor.ops->update();
+}
+
+static inline void cursor_begin_present(const Rect* rects, uint32_t count) {
+    if (g_cursor.ops && g_cursor.ops->begin_present) g_cursor.ops->begin_present(rects, count);
+}
+
+static inline void cursor_end_present(void) {
+    if (g_cursor.ops && g_cursor.ops->end_present) g_cursor.ops->end_present();
+}
+
+static inline const char* cursor_get_backend(void) {
+    return g_cursor.ops ? g_cursor.ops->name : "none";
+}
+
+#endif // CURSOR_H
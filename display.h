@@ -2,6 +2,14 @@
 #define DISPLAY_H
 
 #include "gpu.h"
+#include "telemetry.h"
+#include "jobs.h"
+#include "cursor.h"
+#include "profile.h"
+
+#ifdef PROFILE
+#include "font.h"
+#endif
 
 // ============================================================================
 // DISPLAY MANAGER FOR MINI-OS
@@ -14,18 +22,47 @@ typedef enum {
     LAYER_MAIN,
     LAYER_UI,
     LAYER_OVERLAY,
-    LAYER_CURSOR,
+    LAYER_CURSOR,           // Cursor image only; cursor.h puts it on screen
     LAYER_COUNT
 } LayerType;
 
+// ---------- Damage List ----------
+// Bounded set of screen-space rectangles that need recompositing.
+// Overlapping or nearby rects are merged; when full, the pair that grows
+// least is merged so the list never overflows.
+#define DAMAGE_MAX_RECTS 16
+
+typedef struct {
+    Rect rects[DAMAGE_MAX_RECTS];
+    uint32_t count;
+} DamageList;
+
+// ---------- Compositor Tiles ----------
+// Each layer keeps a coarse per-tile coverage class (in layer-local tiles)
+// so the compositor can skip empty tiles and start at the topmost opaque one.
+#define DISPLAY_TILE_SHIFT   6
+#define DISPLAY_TILE_SIZE    (1 << DISPLAY_TILE_SHIFT)
+#define DISPLAY_MAX_WIDTH    2048
+#define DISPLAY_MAX_HEIGHT   1536
+#define DISPLAY_MAX_TILES_X  (DISPLAY_MAX_WIDTH / DISPLAY_TILE_SIZE)
+#define DISPLAY_MAX_TILES_Y  (DISPLAY_MAX_HEIGHT / DISPLAY_TILE_SIZE)
+
+typedef enum {
+    TILE_UNKNOWN = 0,       // Content changed, reclassify before use
+    TILE_EMPTY,             // Every pixel has alpha 0
+    TILE_OPAQUE,            // Every pixel has alpha 255
+    TILE_TRANSLUCENT,       // Anything else
+} TileClass;
+
 // ---------- Layer Structure ----------
 typedef struct {
     int32_t x, y;           // Position
     uint32_t width, height; // Size
     uint8_t visible;        // Visibility flag
     uint8_t alpha;          // Layer alpha (0-255)
-    uint32_t* buffer;       // Pixel buffer (ARGB)
-    uint8_t dirty;          // Needs redraw
+    uint32_t* buffer;       // Pixel buffer (premultiplied ARGB)
+    DamageList damage;      // Screen areas this layer changed since last frame
+    uint8_t tile_class[DISPLAY_MAX_TILES_Y][DISPLAY_MAX_TILES_X]; // TileClass per local tile
 } Layer;
 
 // ---------- Display State ----------
@@ -33,22 +70,142 @@ typedef struct {
     uint16_t width;
     uint16_t height;
     uint32_t frame_count;
-    uint32_t fps;
-    uint32_t last_fps_time;
-    uint32_t frame_time;
+    uint32_t fps;           // Frames completed in the last full second
+    uint32_t last_fps_time; // ms timestamp of the last fps update
+    uint32_t frame_time;    // us from display_begin_frame to display_end_frame
+    uint32_t composite_time; // us spent compositing last frame
+    uint32_t present_time;  // us spent copying or flipping last frame
+    uint32_t vsync_time;    // us spent waiting for the present slot last frame
+    uint32_t fps_frames;    // Frames counted since last_fps_time
+    uint64_t frame_start_ns; // timer_ns() at display_begin_frame
     Layer layers[LAYER_COUNT];
+    DamageList damage;      // Screen-wide damage not owned by one layer
+    DamageList frame_damage; // New damage of the last display_end_frame
+    DamageList damage_history[GPU_MAX_PAGES - 1]; // Older frames, for flip pages
+    uint32_t history_head;
+    uint32_t damaged_pixels; // Pixels composited by the last frame
+    uint32_t target_hz;     // Frame pacing target (0 = as fast as possible)
     uint8_t cursor_visible;
     int32_t cursor_x, cursor_y;
 } Display;
 
 static Display g_display;
 
-// Layer buffers - statically allocated at known addresses
-#define LAYER_BG_ADDR     0x00300000
-#define LAYER_MAIN_ADDR   0x00400000
-#define LAYER_UI_ADDR     0x00500000
-#define LAYER_OVERLAY_ADDR 0x00600000
-#define LAYER_CURSOR_ADDR 0x00700000
+// Refresh rate assumed for frame pacing (VGA gives no way to query it)
+#define DISPLAY_MONITOR_HZ 60
+
+// Layer buffers come from one arena sized to the mode at display_init
+#define DISPLAY_CURSOR_SIZE  16
+#define DISPLAY_LAYER_ALIGN  64     // Cache line, and wide enough for AVX rows
+
+static Arena g_display_arena;
+
+// ============================================================================
+// DAMAGE TRACKING
+// ============================================================================
+
+static inline void damage_clear(DamageList* list) {
+    list->count = 0;
+}
+
+static inline void damage_remove(DamageList* list, uint32_t index) {
+    list->rects[index] = list->rects[--list->count];
+}
+
+// Add a rect, merging it with neighbours when the bounding box wastes no
+// more pixels than the overlap it saves
+static inline void damage_add(DamageList* list, Rect r) {
+    if (rect_is_empty(&r)) return;
+    
+    int merged = 1;
+    while (merged) {
+        merged = 0;
+        for (uint32_t i = 0; i < list->count; i++) {
+            Rect* e = &list->rects[i];
+            if (rect_contains(e, &r)) return;
+            Rect u = rect_union(e, &r);
+            if (rect_area(&u) <= rect_area(e) + rect_area(&r)) {
+                r = u;
+                damage_remove(list, i);
+                merged = 1;
+                break;
+            }
+        }
+    }
+    
+    if (list->count < DAMAGE_MAX_RECTS) {
+        list->rects[list->count++] = r;
+        return;
+    }
+    
+    // Full: fold into the rect whose bounding box grows least
+    uint32_t best = 0;
+    uint32_t best_growth = 0xFFFFFFFF;
+    for (uint32_t i = 0; i < list->count; i++) {
+        Rect u = rect_union(&list->rects[i], &r);
+        uint32_t growth = rect_area(&u) - rect_area(&list->rects[i]);
+        if (growth < best_growth) {
+            best_growth = growth;
+            best = i;
+        }
+    }
+    r = rect_union(&list->rects[best], &r);
+    damage_remove(list, best);
+    damage_add(list, r);
+}
+
+static inline void damage_add_list(DamageList* dst, const DamageList* src) {
+    for (uint32_t i = 0; i < src->count; i++) {
+        damage_add(dst, src->rects[i]);
+    }
+}
+
+// Screen-space bounds of a layer
+static inline Rect display_layer_bounds(const Layer* layer) {
+    Rect r = {layer->x, layer->y, layer->width, layer->height};
+    return r;
+}
+
+// Forget the coverage class of every local tile touched by a layer-local rect
+static inline void display_layer_invalidate_tiles(Layer* layer, int32_t x, int32_t y, uint32_t w, uint32_t h) {
+    Rect r = {x, y, w, h};
+    Rect local = {0, 0, layer->width, layer->height};
+    if (!rect_intersect(&r, &local, &r)) return;
+    
+    int32_t tx1 = (r.x + (int32_t)r.width - 1) >> DISPLAY_TILE_SHIFT;
+    int32_t ty1 = (r.y + (int32_t)r.height - 1) >> DISPLAY_TILE_SHIFT;
+    if (tx1 >= DISPLAY_MAX_TILES_X) tx1 = DISPLAY_MAX_TILES_X - 1;
+    if (ty1 >= DISPLAY_MAX_TILES_Y) ty1 = DISPLAY_MAX_TILES_Y - 1;
+    for (int32_t ty = r.y >> DISPLAY_TILE_SHIFT; ty <= ty1; ty++) {
+        for (int32_t tx = r.x >> DISPLAY_TILE_SHIFT; tx <= tx1; tx++) {
+            layer->tile_class[ty][tx] = TILE_UNKNOWN;
+        }
+    }
+}
+
+// Record a layer-local rect as damaged (use after drawing into layer->buffer
+// directly). Hidden layers cannot change the screen, so only the tile
+// classes are dropped; showing the layer later damages its whole area.
+static inline void display_layer_damage(Layer* layer, int32_t x, int32_t y, uint32_t w, uint32_t h) {
+    display_layer_invalidate_tiles(layer, x, y, w, h);
+    if (!layer->visible) return;
+    Rect r = {layer->x + x, layer->y + y, w, h};
+    Rect bounds = display_layer_bounds(layer);
+    if (rect_intersect(&r, &bounds, &r)) {
+        damage_add(&layer->damage, r);
+    }
+}
+
+// Record the whole layer as damaged
+static inline void display_layer_damage_all(Layer* layer) {
+    damage_add(&layer->damage, display_layer_bounds(layer));
+}
+
+// Force the whole screen to be recomposited on the next frame
+static inline void display_invalidate(void) {
+    Rect r = {0, 0, g_display.width, g_display.height};
+    damage_add(&g_display.damage, r);
+}
 
 // ============================================================================
 // DISPLAY INITIALIZATION
@@ -63,41 +220,55 @@ static inline int display_init(void) {
     g_display.height = gpu_get_height();
     g_display.frame_count = 0;
     g_display.fps = 0;
-    g_display.last_fps_time = 0;
     g_display.frame_time = 0;
+    g_display.composite_time = 0;
+    g_display.present_time = 0;
+    g_display.vsync_time = 0;
+    g_display.fps_frames = 0;
+    g_display.frame_start_ns = timer_ns();
+    g_display.last_fps_time = timer_ms();
+    g_display.target_hz = DISPLAY_MONITOR_HZ;
+    gpu_set_swap_interval(1);
+    cursor_init();
     g_display.cursor_visible = 0;
     g_display.cursor_x = g_display.width / 2;
     g_display.cursor_y = g_display.height / 2;
     
-    // Initialize layers
-    uint32_t* layer_addrs[] = {
-        (uint32_t*)LAYER_BG_ADDR,
-        (uint32_t*)LAYER_MAIN_ADDR,
-        (uint32_t*)LAYER_UI_ADDR,
-        (uint32_t*)LAYER_OVERLAY_ADDR,
-        (uint32_t*)LAYER_CURSOR_ADDR
-    };
+    // Screen-sized layers plus a cursor-sized one, allocated once per mode size
+    uint32_t screen_bytes = pmm_align_up((uint32_t)g_display.width * g_display.height * 4, DISPLAY_LAYER_ALIGN);
+    uint32_t cursor_bytes = pmm_align_up(DISPLAY_CURSOR_SIZE * DISPLAY_CURSOR_SIZE * 4, DISPLAY_LAYER_ALIGN);
+    uint32_t needed = screen_bytes * (LAYER_COUNT - 1) + cursor_bytes;
+    if (g_display_arena.size < needed && arena_init(&g_display_arena, needed) != 0) {
+        return -1;
+    }
+    arena_reset(&g_display_arena);
     
+    // Initialize layers
     for (int i = 0; i < LAYER_COUNT; i++) {
-        g_display.layers[i].x = 0;
-        g_display.layers[i].y = 0;
-        g_display.layers[i].width = g_display.width;
-        g_display.layers[i].height = g_display.height;
-        g_display.layers[i].visible = (i == LAYER_BACKGROUND || i == LAYER_MAIN);
-        g_display.layers[i].alpha = 255;
-        g_display.layers[i].buffer = layer_addrs[i];
-        g_display.layers[i].dirty = 1;
+        Layer* layer = &g_display.layers[i];
+        int cursor = (i == LAYER_CURSOR);
+        layer->x = 0;
+        layer->y = 0;
+        layer->width = cursor ? DISPLAY_CURSOR_SIZE : g_display.width;
+        layer->height = cursor ? DISPLAY_CURSOR_SIZE : g_display.height;
+        layer->visible = (i == LAYER_BACKGROUND || i == LAYER_MAIN);
+        layer->alpha = 255;
+        layer->buffer = (uint32_t*)arena_alloc(&g_display_arena, cursor ? cursor_bytes : screen_bytes,
+                                               DISPLAY_LAYER_ALIGN);
+        damage_clear(&layer->damage);
+        display_layer_invalidate_tiles(layer, 0, 0, layer->width, layer->height);
         
         // Clear layer buffer
-        uint32_t size = g_display.width * g_display.height;
-        for (uint32_t j = 0; j < size; j++) {
-            layer_addrs[i][j] = 0;
-        }
+        gpu_memset32(layer->buffer, 0, layer->width * layer->height);
     }
     
-    // Cursor layer is smaller
-    g_display.layers[LAYER_CURSOR].width = 16;
-    g_display.layers[LAYER_CURSOR].height = 16;
+    // First frame composites everything
+    damage_clear(&g_display.damage);
+    damage_clear(&g_display.frame_damage);
+    for (int i = 0; i < GPU_MAX_PAGES - 1; i++) damage_clear(&g_display.damage_history[i]);
+    g_display.history_head = 0;
+    g_display.damaged_pixels = 0;
+    display_invalidate();
     
     return 0;
 }
@@ -113,38 +284,61 @@ static inline Layer* display_get_layer(LayerType type) {
 
 static inline void display_layer_set_visible(LayerType type, uint8_t visible) {
     if (type >= LAYER_COUNT) return;
-    g_display.layers[type].visible = visible;
-    g_display.layers[type].dirty = 1;
+    Layer* layer = &g_display.layers[type];
+    if (layer->visible == visible) return;
+    layer->visible = visible;
+    display_layer_damage_all(layer);
 }
 
 static inline void display_layer_set_alpha(LayerType type, uint8_t alpha) {
     if (type >= LAYER_COUNT) return;
-    g_display.layers[type].alpha = alpha;
-    g_display.layers[type].dirty = 1;
+    Layer* layer = &g_display.layers[type];
+    if (layer->alpha == alpha) return;
+    layer->alpha = alpha;
+    if (layer->visible) display_layer_damage_all(layer);
 }
 
 static inline void display_layer_set_position(LayerType type, int32_t x, int32_t y) {
     if (type >= LAYER_COUNT) return;
-    g_display.layers[type].x = x;
-    g_display.layers[type].y = y;
-    g_display.layers[type].dirty = 1;
+    Layer* layer = &g_display.layers[type];
+    if (layer->x == x && layer->y == y) return;
+    // Uncover the old area, cover the new one
+    if (layer->visible) display_layer_damage_all(layer);
+    layer->x = x;
+    layer->y = y;
+    if (layer->visible) display_layer_damage_all(layer);
 }
 
+// Layer drawing takes straight-alpha colors and stores them premultiplied
 static inline void display_layer_clear(LayerType type, Color color) {
     if (type >= LAYER_COUNT) return;
     Layer* layer = &g_display.layers[type];
-    uint32_t size = layer->width * layer->height;
-    for (uint32_t i = 0; i < size; i++) {
-        layer->buffer[i] = color;
-    }
-    layer->dirty = 1;
+    gpu_memset32(layer->buffer, blend_premultiply(color), layer->width * layer->height);
+    display_layer_damage(layer, 0, 0, layer->width, layer->height);
 }
 
 static inline void display_layer_put_pixel(LayerType type, int32_t x, int32_t y, Color color) {
     if (type >= LAYER_COUNT) return;
     Layer* layer = &g_display.layers[type];
     if (x < 0 || x >= (int32_t)layer->width || y < 0 || y >= (int32_t)layer->height) return;
-    layer->buffer[y * layer->width + x] = color;
+    layer->buffer[y * layer->width + x] = blend_premultiply(color);
+    display_layer_damage(layer, x, y, 1, 1);
+}
+
+// Set alpha to 255 over a rect and damage it, for layers drawn through
+// graphics.h (whose RGB colors carry no alpha)
+static inline void display_layer_make_opaque(LayerType type, int32_t x, int32_t y, uint32_t w, uint32_t h) {
+    if (type >= LAYER_COUNT) return;
+    Layer* layer = &g_display.layers[type];
+    Rect r = {x, y, w, h};
+    Rect local = {0, 0, layer->width, layer->height};
+    Rect in;
+    if (!rect_intersect(&r, &local, &in)) return;
+    for (uint32_t row = 0; row < in.height; row++) {
+        uint32_t* p = layer->buffer + (in.y + row) * layer->width + in.x;
+        for (uint32_t i = 0; i < in.width; i++) p[i] |= 0xFF000000;
+    }
+    display_layer_damage(layer, in.x, in.y, in.width, in.height);
 }
 
 static inline void display_layer_fill_rect(LayerType type, int32_t x, int32_t y, 
@@ -152,84 +346,373 @@ static inline void display_layer_fill_rect(LayerType type, int32_t x, int32_t y,
     if (type >= LAYER_COUNT) return;
     Layer* layer = &g_display.layers[type];
     
-    for (uint32_t dy = 0; dy < h; dy++) {
-        for (uint32_t dx = 0; dx < w; dx++) {
-            int32_t px = x + dx;
-            int32_t py = y + dy;
-            if (px >= 0 && px < (int32_t)layer->width && py >= 0 && py < (int32_t)layer->height) {
-                layer->buffer[py * layer->width + px] = color;
-            }
-        }
+    Rect r = {x, y, w, h};
+    Rect local = {0, 0, layer->width, layer->height};
+    if (!rect_intersect(&r, &local, &r)) return;
+    
+    color = blend_premultiply(color);
+    for (uint32_t dy = 0; dy < r.height; dy++) {
+        gpu_memset32(layer->buffer + (r.y + dy) * layer->width + r.x, color, r.width);
     }
-    layer->dirty = 1;
+    display_layer_damage(layer, r.x, r.y, r.width, r.height);
 }
 
 // ============================================================================
 // COMPOSITING & RENDERING
 // ============================================================================
 
-// Composite all visible layers to the GPU back buffer
-static inline void display_composite(void) {
-    // Start with background
-    for (int32_t y = 0; y < g_display.height; y++) {
-        for (int32_t x = 0; x < g_display.width; x++) {
-            Color pixel = 0;
-            
-            // Blend layers from bottom to top
-            for (int i = 0; i < LAYER_COUNT; i++) {
-                Layer* layer = &g_display.layers[i];
-                if (!layer->visible) continue;
-                
-                int32_t lx = x - layer->x;
-                int32_t ly = y - layer->y;
-                
-                if (lx >= 0 && lx < (int32_t)layer->width && 
-                    ly >= 0 && ly < (int32_t)layer->height) {
-                    Color src = layer->buffer[ly * layer->width + lx];
-                    uint8_t src_alpha = GET_A(src);
-                    
-                    if (layer->alpha < 255) {
-                        src_alpha = (src_alpha * layer->alpha) / 255;
-                    }
-                    
-                    if (src_alpha == 255) {
-                        pixel = src;
-                    } else if (src_alpha > 0) {
-                        pixel = gpu_blend(src, pixel, src_alpha);
-                    }
-                }
+// Scratch row (one tile wide) per CPU for back buffers that are not 32 bpp
+static uint32_t g_composite_row[CPU_MAX][DISPLAY_TILE_SIZE];
+
+// Scan one local tile and work out its coverage class
+static inline uint8_t display_classify_tile(const Layer* layer, int32_t tx, int32_t ty) {
+    int32_t x0 = tx << DISPLAY_TILE_SHIFT;
+    int32_t y0 = ty << DISPLAY_TILE_SHIFT;
+    int32_t x1 = x0 + DISPLAY_TILE_SIZE;
+    int32_t y1 = y0 + DISPLAY_TILE_SIZE;
+    if (x1 > (int32_t)layer->width) x1 = layer->width;
+    if (y1 > (int32_t)layer->height) y1 = layer->height;
+    
+    uint32_t all = 0xFFFFFFFF, any = 0;
+    for (int32_t y = y0; y < y1; y++) {
+        const uint32_t* p = layer->buffer + y * layer->width;
+        for (int32_t x = x0; x < x1; x++) {
+            all &= p[x];
+            any |= p[x];
+        }
+    }
+    if ((any >> 24) == 0) return TILE_EMPTY;
+    if ((all >> 24) == 0xFF) return TILE_OPAQUE;
+    return TILE_TRANSLUCENT;
+}
+
+// Coverage of a layer over a screen rect (at most one screen tile in size)
+static inline uint8_t display_layer_coverage(Layer* layer, const Rect* r) {
+    if (!layer->visible || layer->alpha == 0) return TILE_EMPTY;
+    
+    Rect bounds = display_layer_bounds(layer);
+    Rect in;
+    if (!rect_intersect(r, &bounds, &in)) return TILE_EMPTY;
+    
+    int32_t lx0 = in.x - layer->x;
+    int32_t ly0 = in.y - layer->y;
+    int32_t tx0 = lx0 >> DISPLAY_TILE_SHIFT;
+    int32_t ty0 = ly0 >> DISPLAY_TILE_SHIFT;
+    int32_t tx1 = (lx0 + (int32_t)in.width - 1) >> DISPLAY_TILE_SHIFT;
+    int32_t ty1 = (ly0 + (int32_t)in.height - 1) >> DISPLAY_TILE_SHIFT;
+    if (tx1 >= DISPLAY_MAX_TILES_X || ty1 >= DISPLAY_MAX_TILES_Y) return TILE_TRANSLUCENT;
+    
+    // An unaligned layer covers a screen tile with up to 2x2 local tiles
+    int all_empty = 1, all_opaque = 1;
+    for (int32_t ty = ty0; ty <= ty1; ty++) {
+        for (int32_t tx = tx0; tx <= tx1; tx++) {
+            uint8_t c = layer->tile_class[ty][tx];
+            if (c == TILE_UNKNOWN) {
+                // Tile jobs on other CPUs may race here; they store the same class
+                c = display_classify_tile(layer, tx, ty);
+                layer->tile_class[ty][tx] = c;
             }
+            if (c != TILE_EMPTY) all_empty = 0;
+            if (c != TILE_OPAQUE) all_opaque = 0;
+        }
+    }
+    if (all_empty) return TILE_EMPTY;
+    if (all_opaque && layer->alpha == 255 && rect_contains(&bounds, r)) return TILE_OPAQUE;
+    return TILE_TRANSLUCENT;
+}
+
+// Composite one screen rect that lies within a single tile
+static inline void display_composite_tile(const Rect* r) {
+    uint8_t cover[LAYER_COUNT];
+    int base = -1;
+    
+    // Topmost fully opaque layer hides everything below it
+    for (int i = LAYER_COUNT - 1; i >= 0; i--) {
+        cover[i] = display_layer_coverage(&g_display.layers[i], r);
+        if (cover[i] == TILE_OPAQUE) {
+            base = i;
+            break;
+        }
+    }
+    
+    // VRAM is never read back: blend in the scratch row, then stream it out
+    int direct = (g_backbuffer.bpp == 32 && !g_backbuffer.in_vram);
+    for (uint32_t dy = 0; dy < r->height; dy++) {
+        int32_t y = r->y + dy;
+        uint8_t* bb_row = g_backbuffer.data + y * g_backbuffer.pitch;
+        uint32_t* dst = direct ? (uint32_t*)bb_row + r->x : g_composite_row[cpu_index()];
+        
+        // Opaque base layer is copied straight through
+        if (base >= 0) {
+            Layer* l = &g_display.layers[base];
+            gpu_memcpy32(dst, l->buffer + (y - l->y) * l->width + (r->x - l->x), r->width);
+        } else {
+            gpu_memset32(dst, 0, r->width);
+        }
+        
+        for (int i = base + 1; i < LAYER_COUNT; i++) {
+            if (cover[i] != TILE_TRANSLUCENT) continue;
+            Layer* l = &g_display.layers[i];
             
-            gpu_put_pixel(x, y, pixel);
+            // Only the part of the row the layer actually covers
+            int32_t x0 = r->x, x1 = r->x + (int32_t)r->width;
+            if (y < l->y || y >= l->y + (int32_t)l->height) continue;
+            if (x0 < l->x) x0 = l->x;
+            if (x1 > l->x + (int32_t)l->width) x1 = l->x + (int32_t)l->width;
+            if (x0 >= x1) continue;
+            
+            g_blend_row(dst + (x0 - r->x), l->buffer + (y - l->y) * l->width + (x0 - l->x),
+                        x1 - x0, l->alpha);
+        }
+        
+        if (direct) continue;
+        if (g_backbuffer.bpp == 32) {
+            g_memops.stream_copy32((uint32_t*)bb_row + r->x, dst, r->width);
+        } else {
+            g_backbuffer.ops->copy(bb_row, r->x, dst, r->width);
+        }
+    }
+}
+
+typedef struct {
+    Rect area;
+    int32_t tx0, ty0;
+    uint32_t tiles_x;
+} CompositeJob;
+
+static inline void display_composite_job(void* arg, uint32_t index) {
+    const CompositeJob* job = (const CompositeJob*)arg;
+    int32_t tx = job->tx0 + (int32_t)(index % job->tiles_x);
+    int32_t ty = job->ty0 + (int32_t)(index / job->tiles_x);
+    Rect tile = {tx << DISPLAY_TILE_SHIFT, ty << DISPLAY_TILE_SHIFT,
+                 DISPLAY_TILE_SIZE, DISPLAY_TILE_SIZE};
+    Rect part;
+    if (rect_intersect(&tile, &job->area, &part)) display_composite_tile(&part);
+}
+
+// Composite all visible layers into one screen rect of the GPU back buffer,
+// one tile at a time, tiles spread over every CPU
+static inline void display_composite_rect(const Rect* area) {
+    PROFILE_ZONE(PROFILE_COMPOSITE);
+    Rect screen = {0, 0, g_display.width, g_display.height};
+    CompositeJob job;
+    if (!rect_intersect(area, &screen, &job.area)) return;
+    
+    job.tx0 = job.area.x >> DISPLAY_TILE_SHIFT;
+    job.ty0 = job.area.y >> DISPLAY_TILE_SHIFT;
+    int32_t tx1 = (job.area.x + (int32_t)job.area.width - 1) >> DISPLAY_TILE_SHIFT;
+    int32_t ty1 = (job.area.y + (int32_t)job.area.height - 1) >> DISPLAY_TILE_SHIFT;
+    job.tiles_x = tx1 - job.tx0 + 1;
+    jobs_parallel_for(display_composite_job, &job, job.tiles_x * (ty1 - job.ty0 + 1));
+}
+
+// Composite the whole screen
+static inline void display_composite(void) {
+    Rect screen = {0, 0, g_display.width, g_display.height};
+    display_composite_rect(&screen);
+}
+
+// Gather every layer's damage (and screen-wide damage) into frame_damage
+static inline void display_collect_damage(void) {
+    DamageList* frame = &g_display.frame_damage;
+    Rect screen = {0, 0, g_display.width, g_display.height};
+    
+    damage_clear(frame);
+    for (uint32_t i = 0; i < g_display.damage.count; i++) {
+        Rect r;
+        if (rect_intersect(&g_display.damage.rects[i], &screen, &r)) damage_add(frame, r);
+    }
+    damage_clear(&g_display.damage);
+    
+    for (int i = 0; i < LAYER_COUNT; i++) {
+        DamageList* d = &g_display.layers[i].damage;
+        for (uint32_t j = 0; j < d->count; j++) {
+            Rect r;
+            if (rect_intersect(&d->rects[j], &screen, &r)) damage_add(frame, r);
         }
+        damage_clear(d);
+    }
+}
+
+// Work out what must be composited into the current back buffer: this
+// frame's damage plus whatever the page missed while it was off screen
+static inline void display_build_composite_area(DamageList* area) {
+    uint32_t age = gpu_get_buffer_age();
+    *area = g_display.frame_damage;
+    
+    if (age == 0 || age > GPU_MAX_PAGES) {
+        damage_clear(area);
+        Rect screen = {0, 0, g_display.width, g_display.height};
+        damage_add(area, screen);
+        return;
+    }
+    for (uint32_t k = 1; k < age; k++) {
+        uint32_t slot = (g_display.history_head + GPU_MAX_PAGES - 1 - k) % (GPU_MAX_PAGES - 1);
+        damage_add_list(area, &g_display.damage_history[slot]);
     }
 }
 
+// Remember this frame's damage for pages that are still behind
+static inline void display_push_damage_history(void) {
+    g_display.damage_history[g_display.history_head] = g_display.frame_damage;
+    g_display.history_head = (g_display.history_head + 1) % (GPU_MAX_PAGES - 1);
+}
+
 // ============================================================================
 // FRAME MANAGEMENT
 // ============================================================================
 
-// Simple tick counter (increments each frame)
-static volatile uint32_t g_tick_count = 0;
-
+// Milliseconds since boot (frame count if the TSC could not be calibrated)
 static inline uint32_t display_get_ticks(void) {
-    return g_tick_count;
+    return timer_is_ready() ? timer_ms() : g_display.frame_count;
 }
 
 static inline void display_begin_frame(void) {
     g_display.frame_count++;
-    g_tick_count++;
+    g_display.frame_start_ns = timer_ns();
+}
+
+// Sleep out the rest of the frame when pacing cannot lean on vsync
+static inline void display_pace_frame(void) {
+    if (!g_display.target_hz || !timer_is_ready()) return;
+    if (gpu_vsync_available() && gpu_get_swap_interval()) return;
+    
+    uint64_t period = udiv64_32(1000000000ULL, g_display.target_hz);
+    uint64_t deadline = g_display.frame_start_ns + period;
+    while (timer_ns() < deadline) cpu_idle();
+}
+
+// Fill in frame_time and fps once a frame is done
+static inline void display_update_stats(void) {
+    uint64_t now = timer_ns();
+    g_display.frame_time = timer_ns_to_us(now - g_display.frame_start_ns);
+    
+    g_display.fps_frames++;
+    uint32_t now_ms = timer_ms();
+    if (now_ms - g_display.last_fps_time >= 1000) {
+        g_display.fps = g_display.fps_frames * 1000 / (now_ms - g_display.last_fps_time);
+        g_display.fps_frames = 0;
+        g_display.last_fps_time = now_ms;
+    }
+}
+
+#ifdef PROFILE
+// ---------- Profiler overlay ----------
+// Last, p50 and p99 microseconds of each zone in a panel at the top right
+// of LAYER_OVERLAY, redrawn a few times a second. Only the panel is
+// damaged, so the overlay costs one small composite and present.
+#define DISPLAY_PROFILE_MS      250
+#define DISPLAY_PROFILE_LINE    (FONT_HEIGHT + 2)
+#define DISPLAY_PROFILE_WIDTH   (28 * FONT_WIDTH + 8)
+#define DISPLAY_PROFILE_HEIGHT  ((PROFILE_ZONE_COUNT + 1) * DISPLAY_PROFILE_LINE + 6)
+
+static uint32_t g_display_profile_ms;
+
+static inline void display_draw_profile_value(int right_x, int y, uint32_t us) {
+    char buf[12];
+    int_to_str((int)us, buf);
+    font_draw_string_right(right_x, y, buf, COLOR_WHITE, 1);
+}
+
+static inline void display_draw_profile(void) {
+    Layer* layer = &g_display.layers[LAYER_OVERLAY];
+    const ProfileFrame* last = profile_last_frame();
+    uint32_t now = timer_ms();
+    if (!last || (layer->visible && now - g_display_profile_ms < DISPLAY_PROFILE_MS)) return;
+    if (layer->width < DISPLAY_PROFILE_WIDTH + 8 || layer->height < DISPLAY_PROFILE_HEIGHT + 8) return;
+    g_display_profile_ms = now;
+    
+    // Draw through graphics.h into the layer, then put the target back
+    GraphicsContext saved = g_ctx;
+    g_ctx.framebuffer = (uint8_t*)layer->buffer;
+    g_ctx.width = layer->width;
+    g_ctx.height = layer->height;
+    g_ctx.pitch = layer->width * 4;
+    g_ctx.bpp = 32;
+    g_ctx.ops = span_select(32);
+    
+    int x = layer->width - DISPLAY_PROFILE_WIDTH - 8;
+    int y = 8;
+    gfx_fill_rect(x, y, DISPLAY_PROFILE_WIDTH, DISPLAY_PROFILE_HEIGHT, COLOR_BLACK);
+    int text_x = x + 4;
+    int text_y = y + 4;
+    font_draw_string(text_x, text_y, "us", COLOR_GRAY, 1);
+    font_draw_string_right(text_x + 16 * FONT_WIDTH, text_y, "last", COLOR_GRAY, 1);
+    font_draw_string_right(text_x + 22 * FONT_WIDTH, text_y, "p50", COLOR_GRAY, 1);
+    font_draw_string_right(text_x + 28 * FONT_WIDTH, text_y, "p99", COLOR_GRAY, 1);
+    for (uint32_t z = 0; z < PROFILE_ZONE_COUNT; z++) {
+        int row = text_y + (int)(z + 1) * DISPLAY_PROFILE_LINE;
+        font_draw_string(text_x, row, profile_zone_name(z), COLOR_NEON_GREEN, 1);
+        display_draw_profile_value(text_x + 16 * FONT_WIDTH, row, last->us[z]);
+        display_draw_profile_value(text_x + 22 * FONT_WIDTH, row, profile_percentile(z, 50));
+        display_draw_profile_value(text_x + 28 * FONT_WIDTH, row, profile_percentile(z, 99));
+    }
+    
+    g_ctx = saved;
+    display_layer_make_opaque(LAYER_OVERLAY, x, y, DISPLAY_PROFILE_WIDTH, DISPLAY_PROFILE_HEIGHT);
+    display_layer_set_visible(LAYER_OVERLAY, 1);
 }
+#endif
 
 static inline void display_end_frame(void) {
-    // Composite layers
-    display_composite();
+#ifdef PROFILE
+    display_draw_profile();
+#endif
+    display_collect_damage();
+    DamageList* frame = &g_display.frame_damage;
+    g_display.damaged_pixels = 0;
     
-    // Present to screen
-    gpu_present();
+    // Nothing changed: no composite, no present, back page keeps its age
+    uint64_t t0 = timer_ns();
+    if (frame->count) {
+        // Composite only what changed (plus what a flip page has missed)
+        DamageList area;
+        display_build_composite_area(&area);
+        for (uint32_t i = 0; i < area.count; i++) {
+            display_composite_rect(&area.rects[i]);
+            g_display.damaged_pixels += rect_area(&area.rects[i]);
+        }
+    }
+    uint64_t t1 = timer_ns();
+    
+    // Keep the frame cadence even when there is nothing to show
+    gpu_wait_frame();
+    display_pace_frame();
+    uint64_t t2 = timer_ns();
     
-    // Wait for vsync (approximate)
-    gpu_wait_vsync();
+    if (frame->count) {
+        // Present only what changed, in the retrace; with a swap chain
+        // this is a single flip
+        cursor_begin_present(frame->rects, frame->count);
+        gpu_present_rects_immediate(frame->rects, frame->count);
+        cursor_end_present();
+        display_push_damage_history();
+    }
+    uint64_t t3 = timer_ns();
+    
+    g_display.composite_time = timer_ns_to_us(t1 - t0);
+    g_display.vsync_time = timer_ns_to_us(t2 - t1);
+    g_display.present_time = timer_ns_to_us(t3 - t2);
+    display_update_stats();
+#ifdef PROFILE
+    profile_end_frame(g_display.frame_count, g_display.frame_time);
+#endif
+    
+    // Queue this frame's numbers; they go out on COM1 while idle
+    telemetry_frame(g_display.frame_count, g_display.frame_time, g_display.composite_time,
+                    g_display.vsync_time, g_display.present_time, g_display.damaged_pixels);
+    telemetry_drain();
+}
+
+// Pace frames to `hz` by presenting every Nth retrace (0 = unpaced)
+static inline void display_set_refresh_rate(uint32_t hz) {
+    g_display.target_hz = hz;
+    if (hz == 0) {
+        gpu_set_swap_interval(0);
+        return;
+    }
+    uint32_t interval = (DISPLAY_MONITOR_HZ + hz / 2) / hz;
+    gpu_set_swap_interval(interval ? interval : 1);
 }
 
 // Quick present without compositing (direct GPU buffer)
@@ -241,15 +724,28 @@ static inline void display_present_direct(void) {
 // CURSOR SUPPORT
 // ============================================================================
 
+// The cursor bypasses the compositor: a move costs one cursor-sized
+// restore and draw (software) or a register write (hardware)
 static inline void display_set_cursor_visible(uint8_t visible) {
     g_display.cursor_visible = visible;
-    display_layer_set_visible(LAYER_CURSOR, visible);
+    cursor_show(visible);
 }
 
 static inline void display_set_cursor_position(int32_t x, int32_t y) {
     g_display.cursor_x = x;
     g_display.cursor_y = y;
-    display_layer_set_position(LAYER_CURSOR, x, y);
+    cursor_move(x, y);
+}
+
+// Relative motion (mouse input); the hotspot stays on screen
+static inline void display_move_cursor(int32_t dx, int32_t dy) {
+    int32_t x = g_display.cursor_x + dx;
+    int32_t y = g_display.cursor_y + dy;
+    if (x < 0) x = 0;
+    if (y < 0) y = 0;
+    if (x >= (int32_t)g_display.width) x = g_display.width - 1;
+    if (y >= (int32_t)g_display.height) y = g_display.height - 1;
+    display_set_cursor_position(x, y);
 }
 
 static inline void display_create_default_cursor(void) {
@@ -283,6 +779,7 @@ static inline void display_create_default_cursor(void) {
             cursor->buffer[y * cursor->width + x] = c;
         }
     }
+    cursor_define(cursor->buffer, cursor->width, cursor->height, 0, 0);
 }
 
 // ============================================================================
@@ -292,5 +789,7 @@ static inline void display_create_default_cursor(void) {
 static inline uint16_t display_get_width(void) { return g_display.width; }
 static inline uint16_t display_get_height(void) { return g_display.height; }
 static inline uint32_t display_get_frame_count(void) { return g_display.frame_count; }
+static inline uint32_t display_get_fps(void) { return g_display.fps; }
+static inline uint32_t display_get_frame_time(void) { return g_display.frame_time; }
 
 #endif // DISPLAY_H
@@ -0,0 +1,162 @@
+#ifndef DRAW_H
+#define DRAW_H
+
+#include "types.h"
+#include "span.h"
+#include "raster.h"
+
+// ============================================================================
+// SHARED PRIMITIVES FOR MINI-OS
+// One implementation of the basic primitives over a DrawTarget: rows, a
+// pitch, the format's PixelOps and a clip rect. graphics.h wraps these
+// for g_ctx, clipped to the whole context, and gpu.h wraps them for
+// g_backbuffer, clipped to the viewport. Each primitive clips once, then
+// hands whole runs to the span writers.
+// ============================================================================
+
+typedef struct {
+    uint8_t* data;
+    uint32_t pitch;
+    const PixelOps* ops;
+    int32_t  clip_x0, clip_y0;  // Drawable pixels are [clip_x0, clip_x1) x [clip_y0, clip_y1)
+    int32_t  clip_x1, clip_y1;
+} DrawTarget;
+
+// Raster callbacks get the target and the color through one pointer
+typedef struct {
+    const DrawTarget* target;
+    Color color;
+} DrawPaint;
+
+// ---------- Pixels and runs ----------
+static inline void draw_put_pixel(const DrawTarget* t, int32_t x, int32_t y, Color color) {
+    if (x < t->clip_x0 || x >= t->clip_x1 || y < t->clip_y0 || y >= t->clip_y1) return;
+    t->ops->put(t->data + y * t->pitch, x, color);
+}
+
+// Pixels [x, x + len) of row y
+static inline void draw_fill_span(const DrawTarget* t, int32_t x, int32_t y, int32_t len, Color color) {
+    if (y < t->clip_y0 || y >= t->clip_y1) return;
+    int32_t x2 = x + len;
+    if (x < t->clip_x0) x = t->clip_x0;
+    if (x2 > t->clip_x1) x2 = t->clip_x1;
+    if (x >= x2) return;
+    t->ops->fill(t->data + y * t->pitch, x, x2 - x, color);
+}
+
+// Pixels [y, y + len) of column x
+static inline void draw_fill_column(const DrawTarget* t, int32_t x, int32_t y, int32_t len, Color color) {
+    if (x < t->clip_x0 || x >= t->clip_x1) return;
+    int32_t y2 = y + len;
+    if (y < t->clip_y0) y = t->clip_y0;
+    if (y2 > t->clip_y1) y2 = t->clip_y1;
+    if (y >= y2) return;
+    t->ops->column(t->data + y * t->pitch, x, t->pitch, y2 - y, color);
+}
+
+// Span callback for raster.h: arg is a DrawPaint
+static inline void draw_raster_span(void* arg, int x, int y, int len) {
+    const DrawPaint* p = (const DrawPaint*)arg;
+    draw_fill_span(p->target, x, y, len, p->color);
+}
+
+// Line runs from raster_line, already clipped to the target
+static inline void draw_line_hrun(void* arg, int x, int y, int len) {
+    const DrawPaint* p = (const DrawPaint*)arg;
+    p->target->ops->fill(p->target->data + y * p->target->pitch, x, len, p->color);
+}
+
+static inline void draw_line_vrun(void* arg, int x, int y, int len) {
+    const DrawPaint* p = (const DrawPaint*)arg;
+    p->target->ops->column(p->target->data + y * p->target->pitch, x, p->target->pitch, len, p->color);
+}
+
+// ---------- Lines and rectangles ----------
+// Clipped once, then drawn as horizontal or vertical runs. The pixels do
+// not depend on the clip rect, so a line split across tiles has no seams.
+static inline void draw_line(const DrawTarget* t, int32_t x0, int32_t y0, int32_t x1, int32_t y1, Color color) {
+    DrawPaint p = {t, color};
+    raster_line(x0, y0, x1, y1, t->clip_x0, t->clip_y0, t->clip_x1, t->clip_y1,
+                draw_line_hrun, draw_line_vrun, &p);
+}
+
+// One filled quad with square caps
+static inline void draw_line_thick(const DrawTarget* t, int32_t x0, int32_t y0, int32_t x1, int32_t y1,
+                                   int32_t thickness, Color color) {
+    if (thickness <= 1) {
+        draw_line(t, x0, y0, x1, y1, color);
+        return;
+    }
+    DrawPaint p = {t, color};
+    raster_thick_line(x0, y0, x1, y1, thickness, t->clip_y0, t->clip_y1, draw_raster_span, &p);
+}
+
+static inline void draw_rect(const DrawTarget* t, int32_t x, int32_t y, int32_t w, int32_t h, Color color) {
+    if (w <= 0 || h <= 0) return;
+    draw_fill_span(t, x, y, w, color);
+    draw_fill_span(t, x, y + h - 1, w, color);
+    draw_fill_column(t, x, y, h, color);
+    draw_fill_column(t, x + w - 1, y, h, color);
+}
+
+// Clip once, then write whole rows
+static inline void draw_fill_rect(const DrawTarget* t, int32_t x, int32_t y, int32_t w, int32_t h, Color color) {
+    int32_t x2 = x + w, y2 = y + h;
+    if (x < t->clip_x0) x = t->clip_x0;
+    if (y < t->clip_y0) y = t->clip_y0;
+    if (x2 > t->clip_x1) x2 = t->clip_x1;
+    if (y2 > t->clip_y1) y2 = t->clip_y1;
+    if (x >= x2 || y >= y2) return;
+
+    uint8_t* row = t->data + y * t->pitch;
+    for (int32_t dy = y; dy < y2; dy++) {
+        t->ops->fill(row, x, x2 - x, color);
+        row += t->pitch;
+    }
+}
+
+// ---------- Circles, ellipses and polygons ----------
+// Midpoint circle outline
+static inline void draw_circle(const DrawTarget* t, int32_t cx, int32_t cy, int32_t r, Color color) {
+    int32_t x = 0, y = r;
+    int32_t d = 1 - r;
+
+    while (x <= y) {
+        draw_put_pixel(t, cx + x, cy + y, color);
+        draw_put_pixel(t, cx - x, cy + y, color);
+        draw_put_pixel(t, cx + x, cy - y, color);
+        draw_put_pixel(t, cx - x, cy - y, color);
+        draw_put_pixel(t, cx + y, cy + x, color);
+        draw_put_pixel(t, cx - y, cy + x, color);
+        draw_put_pixel(t, cx + y, cy - x, color);
+        draw_put_pixel(t, cx - y, cy - x, color);
+
+        if (d < 0) {
+            d += 2 * x + 3;
+        } else {
+            d += 2 * (x - y) + 5;
+            y--;
+        }
+        x++;
+    }
+}
+
+// Fills are row spans (raster.h); only rows inside the clip are visited
+static inline void draw_fill_ellipse(const DrawTarget* t, int32_t cx, int32_t cy, int32_t rx, int32_t ry, Color color) {
+    DrawPaint p = {t, color};
+    raster_fill_ellipse(cx, cy, rx, ry, t->clip_y0, t->clip_y1, draw_raster_span, &p);
+}
+
+static inline void draw_fill_ring(const DrawTarget* t, int32_t cx, int32_t cy, int32_t r_outer, int32_t r_inner,
+                                  Color color) {
+    DrawPaint p = {t, color};
+    raster_fill_ring(cx, cy, r_outer, r_inner, t->clip_y0, t->clip_y1, draw_raster_span, &p);
+}
+
+// Outline of `count` (x, y) pairs, nonzero winding
+static inline void draw_fill_polygon(const DrawTarget* t, const int* points, int count, Color color) {
+    DrawPaint p = {t, color};
+    raster_fill_polygon(points, count, t->clip_y0, t->clip_y1, draw_raster_span, &p);
+}
+
+#endif // DRAW_H
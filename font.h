@@ -3,6 +3,7 @@
 
 #include "types.h"
 #include "graphics.h"
+#include "profile.h"
 
 // ============================================================================
 // BITMAP FONT RENDERING FOR MINI-OS
@@ -208,61 +209,194 @@ static const uint8_t font_data[95][8] = {
     { 0x76, 0xDC, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
 };
 
-// ---------- Character rendering ----------
-static inline void font_draw_char(int x, int y, char c, Color fg, int scale) {
-    if (c < FONT_FIRST_CHAR || c > FONT_LAST_CHAR) return;
-    
-    const uint8_t* glyph = font_data[c - FONT_FIRST_CHAR];
+// ---------- Glyph row tables ----------
+// A glyph row is one byte, MSB = leftmost column. Its lit runs are looked
+// up once per row instead of re-scanning the bits for every character.
+#define FONT_MAX_RUNS       5   // 10-bit outline rows have at most 5 runs
+#define FONT_BG_MAX_SCALE   8   // Widest cell font_draw_char_bg expands in one go
+
+typedef struct {
+    uint8_t count;
+    uint8_t start[FONT_MAX_RUNS];
+    uint8_t len[FONT_MAX_RUNS];
+} FontRuns;
+
+static FontRuns g_font_runs[256];
+static uint8_t g_font_ready;
+
+// Split the low `width` bits of `bits` (highest bit = column 0) into runs
+static inline void font_find_runs(uint32_t bits, int width, FontRuns* out) {
+    out->count = 0;
+    int col = 0;
+    while (col < width && out->count < FONT_MAX_RUNS) {
+        if (!((bits >> (width - 1 - col)) & 1)) { col++; continue; }
+        int start = col;
+        while (col < width && ((bits >> (width - 1 - col)) & 1)) col++;
+        out->start[out->count] = start;
+        out->len[out->count] = col - start;
+        out->count++;
+    }
+}
+
+static inline void font_init(void) {
+    if (g_font_ready) return;
+    for (int b = 0; b < 256; b++) font_find_runs(b, FONT_WIDTH, &g_font_runs[b]);
+    g_font_ready = 1;
+}
+
+// Unprintable characters draw as a space
+static inline const uint8_t* font_glyph(char c) {
+    if (c < FONT_FIRST_CHAR || c > FONT_LAST_CHAR) return font_data[0];
+    return font_data[c - FONT_FIRST_CHAR];
+}
+
+// ---------- Span output ----------
+static inline int font_needs_clip(int x, int y, int w, int h) {
+    return x < 0 || y < 0 || x + w > g_ctx.width || y + h > g_ctx.height;
+}
+
+// Draw `lines` scanlines of `runs` as `scale`-wide cells starting at (x, y).
+// Text that lies fully on screen skips per-span clipping.
+static inline void font_emit_runs(const FontRuns* runs, int x, int y, int scale, int lines,
+                                  Color color, int clip) {
+    for (int k = 0; k < lines; k++, y++) {
+        uint8_t* row = g_ctx.framebuffer + y * g_ctx.pitch;
+        for (int i = 0; i < runs->count; i++) {
+            int sx = x + runs->start[i] * scale;
+            int len = runs->len[i] * scale;
+            if (clip) gfx_fill_span(sx, y, len, color);
+            else g_ctx.ops->fill(row, sx, len, color);
+        }
+    }
+}
+
+// Characters up to the next '\n' or the end
+static inline int font_line_length(const char* str) {
+    int len = 0;
+    while (str[len] && str[len] != '\n') len++;
+    return len;
+}
+
+// ---------- Line rendering ----------
+// One text line, glyph row by glyph row across all of its characters
+static inline void font_draw_line(int x, int y, const char* str, int len, Color fg, int scale) {
+    int cell = FONT_WIDTH * scale;
+    int clip = font_needs_clip(x, y, len * cell, FONT_HEIGHT * scale);
     
     for (int row = 0; row < FONT_HEIGHT; row++) {
-        uint8_t bits = glyph[row];
-        for (int col = 0; col < FONT_WIDTH; col++) {
-            if (bits & (0x80 >> col)) {
-                if (scale == 1) {
-                    gfx_put_pixel(x + col, y + row, fg);
-                } else {
-                    gfx_fill_rect(x + col * scale, y + row * scale, scale, scale, fg);
-                }
+        int ry = y + row * scale;
+        for (int i = 0; i < len; i++) {
+            uint8_t bits = font_glyph(str[i])[row];
+            if (bits) font_emit_runs(&g_font_runs[bits], x + i * cell, ry, scale, scale, fg, clip);
+        }
+    }
+}
+
+// Shadow and glyph in one pass: per scanline the shadow goes down first so
+// the glyph lands on top, exactly as drawing two whole strings did
+static inline void font_draw_line_shadow(int x, int y, const char* str, int len,
+                                         Color fg, Color shadow, int scale, int offset) {
+    int cell = FONT_WIDTH * scale;
+    int h = FONT_HEIGHT * scale;
+    int lo = offset < 0 ? offset : 0;
+    int hi = offset > 0 ? offset : 0;
+    int clip = font_needs_clip(x + lo, y + lo, len * cell + hi - lo, h + hi - lo);
+    
+    for (int sy = lo; sy < h + hi; sy++) {
+        int ss = sy - offset;
+        if (ss >= 0 && ss < h) {
+            for (int i = 0; i < len; i++) {
+                uint8_t bits = font_glyph(str[i])[ss / scale];
+                if (bits) font_emit_runs(&g_font_runs[bits], x + offset + i * cell, y + sy, scale, 1, shadow, clip);
             }
         }
+        if (sy >= 0 && sy < h) {
+            for (int i = 0; i < len; i++) {
+                uint8_t bits = font_glyph(str[i])[sy / scale];
+                if (bits) font_emit_runs(&g_font_runs[bits], x + i * cell, y + sy, scale, 1, fg, clip);
+            }
+        }
+    }
+}
+
+// Outline and glyph in one pass. The outline of a cell row is the glyph
+// grown by one cell each way (10 bits: column -1 .. 8) minus the glyph.
+// All outlines of a row go down before any glyph of that row.
+static inline void font_draw_line_outline(int x, int y, const char* str, int len,
+                                          Color fg, Color outline, int scale) {
+    int cell = FONT_WIDTH * scale;
+    int clip = font_needs_clip(x - scale, y - scale, len * cell + 2 * scale, (FONT_HEIGHT + 2) * scale);
+    
+    for (int row = -1; row <= FONT_HEIGHT; row++) {
+        int ry = y + row * scale;
+        for (int i = 0; i < len; i++) {
+            const uint8_t* glyph = font_glyph(str[i]);
+            uint32_t up = row > 0 ? glyph[row - 1] : 0;
+            uint32_t cur = row >= 0 && row < FONT_HEIGHT ? glyph[row] : 0;
+            uint32_t down = row + 1 < FONT_HEIGHT ? glyph[row + 1] : 0;
+            uint32_t m = (up | cur | down) << 1;
+            uint32_t ring = (m | (m << 1) | (m >> 1)) & ~(cur << 1) & 0x3FF;
+            if (!ring) continue;
+            FontRuns runs;
+            font_find_runs(ring, FONT_WIDTH + 2, &runs);
+            font_emit_runs(&runs, x + i * cell - scale, ry, scale, scale, outline, clip);
+        }
+        if (row < 0 || row >= FONT_HEIGHT) continue;
+        for (int i = 0; i < len; i++) {
+            uint8_t bits = font_glyph(str[i])[row];
+            if (bits) font_emit_runs(&g_font_runs[bits], x + i * cell, ry, scale, scale, fg, clip);
+        }
     }
 }
 
+// ---------- Character rendering ----------
+static inline void font_draw_char(int x, int y, char c, Color fg, int scale) {
+    font_init();
+    font_draw_line(x, y, &c, 1, fg, scale);
+}
+
+// Each glyph row is expanded to finished pixels once and stored `scale`
+// times as a whole row, so the background costs no extra pass
 static inline void font_draw_char_bg(int x, int y, char c, Color fg, Color bg, int scale) {
-    if (c < FONT_FIRST_CHAR || c > FONT_LAST_CHAR) {
-        gfx_fill_rect(x, y, FONT_WIDTH * scale, FONT_HEIGHT * scale, bg);
+    int cell = FONT_WIDTH * scale;
+    if (scale < 1) return;
+    if (scale > FONT_BG_MAX_SCALE || font_needs_clip(x, y, cell, FONT_HEIGHT * scale)) {
+        gfx_fill_rect(x, y, cell, FONT_HEIGHT * scale, bg);
+        font_draw_char(x, y, c, fg, scale);
         return;
     }
     
-    const uint8_t* glyph = font_data[c - FONT_FIRST_CHAR];
+    const uint8_t* glyph = font_glyph(c);
+    uint32_t colors[FONT_WIDTH];
+    uint32_t pixels[FONT_WIDTH * FONT_BG_MAX_SCALE];
+    Color diff = fg ^ bg;
+    uint8_t* dst = g_ctx.framebuffer + y * g_ctx.pitch;
     
     for (int row = 0; row < FONT_HEIGHT; row++) {
-        uint8_t bits = glyph[row];
+        uint32_t bits = glyph[row];
         for (int col = 0; col < FONT_WIDTH; col++) {
-            Color color = (bits & (0x80 >> col)) ? fg : bg;
-            if (scale == 1) {
-                gfx_put_pixel(x + col, y + row, color);
-            } else {
-                gfx_fill_rect(x + col * scale, y + row * scale, scale, scale, color);
-            }
+            uint32_t mask = 0u - ((bits >> (FONT_WIDTH - 1 - col)) & 1);
+            colors[col] = bg ^ (diff & mask);
+        }
+        span_repeat32(pixels, colors, cell, scale, 0);
+        for (int k = 0; k < scale; k++, dst += g_ctx.pitch) {
+            g_ctx.ops->copy(dst, x, pixels, cell);
         }
     }
 }
 
 // ---------- String rendering ----------
 static inline int font_draw_string(int x, int y, const char* str, Color fg, int scale) {
-    int start_x = x;
-    while (*str) {
-        if (*str == '\n') {
-            x = start_x;
-            y += FONT_HEIGHT * scale + scale;
-        } else {
-            font_draw_char(x, y, *str, fg, scale);
-            x += FONT_WIDTH * scale;
-        }
+    PROFILE_ZONE(PROFILE_FONT);
+    font_init();
+    for (;;) {
+        int len = font_line_length(str);
+        font_draw_line(x, y, str, len, fg, scale);
+        str += len;
+        if (!*str) return x + len * FONT_WIDTH * scale;
         str++;
+        y += FONT_HEIGHT * scale + scale;
     }
-    return x;
 }
 
 static inline void font_draw_string_bg(int x, int y, const char* str, Color fg, Color bg, int scale) {
@@ -346,19 +480,35 @@ static inline void font_draw_hex(int x, int y, uint32_t value, Color fg, int sca
 
 // ---------- Text effects ----------
 static inline void font_draw_string_shadow(int x, int y, const char* str, Color fg, Color shadow, int scale, int offset) {
-    font_draw_string(x + offset, y + offset, str, shadow, scale);
-    font_draw_string(x, y, str, fg, scale);
+    font_init();
+    
+    // A shadow reaching past the line gap would land on the neighbouring
+    // line's glyphs; keep the two-pass order for that case
+    if ((offset > scale || -offset > scale) && str[font_line_length(str)]) {
+        font_draw_string(x + offset, y + offset, str, shadow, scale);
+        font_draw_string(x, y, str, fg, scale);
+        return;
+    }
+    for (;;) {
+        int len = font_line_length(str);
+        font_draw_line_shadow(x, y, str, len, fg, shadow, scale, offset);
+        str += len;
+        if (!*str) return;
+        str++;
+        y += FONT_HEIGHT * scale + scale;
+    }
 }
 
 static inline void font_draw_string_outline(int x, int y, const char* str, Color fg, Color outline, int scale) {
-    for (int dy = -1; dy <= 1; dy++) {
-        for (int dx = -1; dx <= 1; dx++) {
-            if (dx != 0 || dy != 0) {
-                font_draw_string(x + dx * scale, y + dy * scale, str, outline, scale);
-            }
-        }
+    font_init();
+    for (;;) {
+        int len = font_line_length(str);
+        font_draw_line_outline(x, y, str, len, fg, outline, scale);
+        str += len;
+        if (!*str) return;
+        str++;
+        y += FONT_HEIGHT * scale + scale;
     }
-    font_draw_string(x, y, str, fg, scale);
 }
 
 static inline void font_draw_text_box(int x, int y, int w, int h, const char* str, Color fg, Color bg, Color border, int scale) {
@@ -2,6 +2,15 @@
 #define GPU_H
 
 #include "types.h"
+#include "span.h"
+#include "memops.h"
+#include "blend.h"
+#include "raster.h"
+#include "draw.h"
+#include "pmm.h"
+#include "gpu_hw.h"
+#include "timer.h"
+#include "profile.h"
 
 // ============================================================================
 // GPU DRIVER FOR MINI-OS
@@ -14,6 +23,7 @@ typedef enum {
     GPU_TYPE_VBE,           // VESA BIOS Extensions (what we're using)
     GPU_TYPE_BOCHS,         // Bochs VBE extensions
     GPU_TYPE_QEMU_STD,      // QEMU standard VGA
+    GPU_TYPE_VIRTIO,        // virtio-gpu: host copies out of the back buffer
 } GPUType;
 
 // ---------- Pixel Formats ----------
@@ -45,6 +55,8 @@ typedef struct {
     uint16_t height;
     uint16_t pitch;
     uint8_t  bpp;
+    uint8_t  in_vram;       // Lives in video memory: write-only, never read back
+    const PixelOps* ops;    // Writers for this pixel format (span.h)
 } Framebuffer;
 
 // ---------- Rectangle structure ----------
@@ -67,20 +79,77 @@ typedef struct {
     uint32_t width, height;
 } Viewport;
 
+// ---------- Swap chain (hardware page flipping) ----------
+// Pages live back to back in VRAM starting at the LFB. Rendering goes
+// straight into the back page and gpu_present flips the scanout offset.
+#define GPU_MAX_PAGES 3
+
+// Pages requested at gpu_init; define as 0 before including to force copy present
+#ifndef GPU_SWAP_PAGES
+#define GPU_SWAP_PAGES GPU_MAX_PAGES
+#endif
+
+typedef struct {
+    uint8_t  pages;         // 0 = copy present, 2 = double, 3 = triple buffered
+    uint8_t  front;         // Page being scanned out
+    uint8_t  back;          // Page being rendered
+    uint32_t page_size;     // Bytes per page (pitch * height)
+    uint32_t frame;         // Frames presented so far
+    uint32_t page_frame[GPU_MAX_PAGES]; // Frame each page was last rendered in (0 = never)
+} SwapChain;
+
 // ---------- Global GPU state ----------
 static GPUDevice g_gpu;
 static Framebuffer g_backbuffer;
-static Viewport g_viewport;
+static Viewport g_cpu_viewport[CPU_MAX];   // Per CPU, like g_ctx
+#define g_viewport (g_cpu_viewport[cpu_index()])
+static SwapChain g_swap;
 static uint8_t* g_backbuffer_memory;
+static uint32_t g_backbuffer_size;  // Bytes allocated at g_backbuffer_memory
 
-// Reserve 3MB for back buffer (enough for 1024x768x32bpp)
-#define BACKBUFFER_ADDR 0x00200000
-#define BACKBUFFER_SIZE (1024 * 768 * 4)
+// Mode policy applied at gpu_init on Bochs/QEMU; change before display_init
+static GPUModePolicy g_gpu_mode_policy = { GPU_MODE_MAX_PIXELS, 32 };
+static uint8_t g_gpu_mode_set;      // gpu_set_mode was called: keep that mode
 
 // ============================================================================
 // GPU INITIALIZATION
 // ============================================================================
 
+static inline uint8_t* gpu_page_addr(uint8_t page) {
+    return (uint8_t*)(uintptr_t)g_gpu.framebuffer_addr + page * g_swap.page_size;
+}
+
+// Switch to rendering directly into VRAM pages if the hardware can flip.
+// Returns the number of pages in use (0 = copy present).
+static inline int gpu_swapchain_init(uint8_t pages) {
+    g_swap.pages = 0;
+    if (pages > GPU_MAX_PAGES) pages = GPU_MAX_PAGES;
+    if (pages < 2) return 0;
+    
+    int got = gpu_hw_setup_flip(g_gpu.width, g_gpu.height, g_gpu.bpp, g_gpu.pitch, pages);
+    if (got < 2) return 0;
+    
+    g_swap.pages = got;
+    g_swap.front = 0;
+    g_swap.back = 1;
+    g_swap.page_size = (uint32_t)g_gpu.pitch * g_gpu.height;
+    g_swap.frame = 0;
+    for (int i = 0; i < GPU_MAX_PAGES; i++) g_swap.page_frame[i] = 0;
+    
+    // Every page is scanned out at some point: all of them write-combining
+    paging_map(g_gpu.framebuffer_addr, got * g_swap.page_size, PAGE_CACHE_WC);
+    
+    // Hidden pages start black; page 0 stays on screen until the first flip
+    for (int i = 1; i < got; i++) {
+        g_memops.stream_set32((uint32_t*)gpu_page_addr(i), 0, g_swap.page_size / 4);
+    }
+    
+    g_backbuffer.data = gpu_page_addr(g_swap.back);
+    g_backbuffer.pitch = g_gpu.pitch;
+    g_backbuffer.in_vram = 1;
+    return got;
+}
+
 static inline PixelFormat gpu_detect_format(uint8_t bpp) {
     switch (bpp) {
         case 16: return PIXEL_FORMAT_RGB565;
@@ -90,6 +159,41 @@ static inline PixelFormat gpu_detect_format(uint8_t bpp) {
     }
 }
 
+// Reprogram the mode and publish it in BootInfo for the next gpu_init
+static inline int gpu_switch_mode(uint16_t width, uint16_t height, uint8_t bpp) {
+    if (gpu_hw_set_mode(width, height, bpp) != 0) return -1;
+    
+    struct BootInfo* info = BOOTINFO;
+    info->fb_width = width;
+    info->fb_height = height;
+    info->fb_bpp = bpp;
+    info->fb_pitch = g_gpu_hw.pitch;
+    if (g_gpu_hw.type == GPU_HW_VMWARE_SVGA) info->fb_addr = g_gpu_hw.fb_addr;
+    paging_map(info->fb_addr, (uint32_t)info->fb_pitch * height, PAGE_CACHE_WC);
+    return 0;
+}
+
+// Move to the policy's best listed mode if it is not the one the loader set
+static inline void gpu_apply_mode_policy(const GPUModePolicy* policy) {
+    struct BootInfo* info = BOOTINFO;
+    const struct VBEModeEntry* m = gpu_hw_pick_mode(policy);
+    if (!m || (m->width == info->fb_width && m->height == info->fb_height && m->bpp == info->fb_bpp)) return;
+    if (gpu_switch_mode(m->width, m->height, m->bpp) == 0) info->vbe_mode = m->mode;
+}
+
+// virtio-gpu takes any size: the host's preferred one if the policy allows
+// it, otherwise the loader's, always at 32 bpp
+static inline void gpu_apply_host_mode(const GPUModePolicy* policy) {
+    struct BootInfo* info = BOOTINFO;
+    uint16_t w = info->fb_width, h = info->fb_height;
+    uint32_t pref = (uint32_t)g_virtio_gpu.pref_width * g_virtio_gpu.pref_height;
+    if (pref && (!policy->max_pixels || pref <= policy->max_pixels)) {
+        w = g_virtio_gpu.pref_width;
+        h = g_virtio_gpu.pref_height;
+    }
+    if (w != info->fb_width || h != info->fb_height || info->fb_bpp != 32) gpu_switch_mode(w, h, 32);
+}
+
 static inline int gpu_init(void) {
     struct BootInfo* info = BOOTINFO;
     
@@ -97,6 +201,22 @@ static inline int gpu_init(void) {
         return -1; // No framebuffer available
     }
     
+    // Pick the fill/copy kernels for this CPU; calibrate the clock
+    memops_init();
+    blend_init();
+    timer_init();
+    
+    // Find the hardware first: on Bochs/QEMU and VMware the mode can still change
+    GPUHardwareType hw = gpu_hw_init() == 0 ? gpu_hw_get_info()->type : GPU_HW_NONE;
+    int bochs = hw == GPU_HW_BOCHS;
+    int vmware = hw == GPU_HW_VMWARE_SVGA;
+    if ((bochs || vmware) && !g_gpu_mode_set) gpu_apply_mode_policy(&g_gpu_mode_policy);
+    
+    // SVGA only runs its FIFO (and cursor) once enabled: take over the VBE mode
+    if (vmware && !vmware_is_enabled()) gpu_switch_mode(info->fb_width, info->fb_height, info->fb_bpp);
+    int virtio = hw == GPU_HW_VIRTIO_GPU;
+    if (virtio && !g_gpu_mode_set) gpu_apply_host_mode(&g_gpu_mode_policy);
+    
     // Initialize GPU device info
     g_gpu.type = GPU_TYPE_VBE;
     g_gpu.format = gpu_detect_format(info->fb_bpp);
@@ -108,13 +228,14 @@ static inline int gpu_init(void) {
     g_gpu.bytes_per_pixel = info->fb_bpp / 8;
     g_gpu.framebuffer_size = info->fb_pitch * info->fb_height;
     
-    // Initialize back buffer
-    g_backbuffer_memory = (uint8_t*)BACKBUFFER_ADDR;
-    g_backbuffer.data = g_backbuffer_memory;
+    // Initialize back buffer (memory is only needed for copy present)
+    g_backbuffer.data = 0;
     g_backbuffer.width = info->fb_width;
     g_backbuffer.height = info->fb_height;
     g_backbuffer.pitch = info->fb_width * g_gpu.bytes_per_pixel;
     g_backbuffer.bpp = info->fb_bpp;
+    g_backbuffer.in_vram = 0;
+    g_backbuffer.ops = span_select(info->fb_bpp);
     
     // Initialize viewport to full screen
     g_viewport.x = 0;
@@ -122,14 +243,43 @@ static inline int gpu_init(void) {
     g_viewport.width = info->fb_width;
     g_viewport.height = info->fb_height;
     
-    // Clear back buffer
-    for (uint32_t i = 0; i < g_backbuffer.pitch * g_backbuffer.height; i++) {
-        g_backbuffer_memory[i] = 0;
+    // Render straight into VRAM and flip on Bochs/QEMU; plain VBE copies
+    g_swap.pages = 0;
+    if (bochs) {
+        g_gpu.type = GPU_TYPE_BOCHS;
+        gpu_swapchain_init(GPU_SWAP_PAGES);
+    }
+    
+    // Copy present renders into RAM sized to the real mode
+    if (!g_swap.pages) {
+        uint32_t size = (uint32_t)g_backbuffer.pitch * g_backbuffer.height;
+        if (g_backbuffer_size < size) {
+            g_backbuffer_memory = (uint8_t*)pmm_alloc(size, PMM_PAGE_SIZE);
+            g_backbuffer_size = g_backbuffer_memory ? size : 0;
+            if (!g_backbuffer_memory) return -1;
+        }
+        g_backbuffer.data = g_backbuffer_memory;
+        mem_zero(g_backbuffer_memory, size);
+    }
+    
+    // virtio-gpu scans the back buffer out itself: presents become host transfers
+    if (virtio && gpu_hw_attach_backbuffer(g_backbuffer.data, g_backbuffer.width, g_backbuffer.height,
+                                           g_backbuffer.pitch) == 0) {
+        g_gpu.type = GPU_TYPE_VIRTIO;
     }
     
     return 0;
 }
 
+// Change mode after boot (Bochs/QEMU and VMware, after display_init). Layers and
+// buffers are sized at init: call display_init() again to use the new mode.
+static inline int gpu_set_mode(uint16_t width, uint16_t height, uint8_t bpp) {
+    if (bpp != 16 && bpp != 24 && bpp != 32) return -1;
+    if (gpu_switch_mode(width, height, bpp) != 0) return -1;
+    g_gpu_mode_set = 1;
+    return 0;
+}
+
 // ============================================================================
 // GPU INFO FUNCTIONS
 // ============================================================================
@@ -155,6 +305,7 @@ static inline const char* gpu_get_type_string(void) {
         case GPU_TYPE_VBE: return "VBE";
         case GPU_TYPE_BOCHS: return "Bochs";
         case GPU_TYPE_QEMU_STD: return "QEMU Std";
+        case GPU_TYPE_VIRTIO: return "virtio-gpu";
         default: return "Unknown";
     }
 }
@@ -174,10 +325,20 @@ static inline const char* gpu_get_format_string(void) {
 // ============================================================================
 
 static inline void gpu_set_viewport(int32_t x, int32_t y, uint32_t w, uint32_t h) {
+    // Keep the viewport inside the back buffer so clipping against it is enough
+    int32_t x2 = x + (int32_t)w;
+    int32_t y2 = y + (int32_t)h;
+    if (x < 0) x = 0;
+    if (y < 0) y = 0;
+    if (x2 > g_backbuffer.width)  x2 = g_backbuffer.width;
+    if (y2 > g_backbuffer.height) y2 = g_backbuffer.height;
+    if (x2 < x) x2 = x;
+    if (y2 < y) y2 = y;
+    
     g_viewport.x = x;
     g_viewport.y = y;
-    g_viewport.width = w;
-    g_viewport.height = h;
+    g_viewport.width = x2 - x;
+    g_viewport.height = y2 - y;
 }
 
 static inline void gpu_reset_viewport(void) {
@@ -218,6 +379,56 @@ static inline int gpu_clip_rect(Rect* r) {
     return 1;
 }
 
+// ============================================================================
+// RECTANGLE HELPERS
+// ============================================================================
+
+static inline uint32_t rect_area(const Rect* r) {
+    return r->width * r->height;
+}
+
+static inline int rect_is_empty(const Rect* r) {
+    return r->width == 0 || r->height == 0;
+}
+
+// Returns 1 if `outer` fully contains `inner`
+static inline int rect_contains(const Rect* outer, const Rect* inner) {
+    return inner->x >= outer->x && inner->y >= outer->y &&
+           inner->x + (int32_t)inner->width <= outer->x + (int32_t)outer->width &&
+           inner->y + (int32_t)inner->height <= outer->y + (int32_t)outer->height;
+}
+
+// Intersection of a and b into out; returns 0 if they do not overlap
+static inline int rect_intersect(const Rect* a, const Rect* b, Rect* out) {
+    int32_t x1 = a->x > b->x ? a->x : b->x;
+    int32_t y1 = a->y > b->y ? a->y : b->y;
+    int32_t ax2 = a->x + (int32_t)a->width, bx2 = b->x + (int32_t)b->width;
+    int32_t ay2 = a->y + (int32_t)a->height, by2 = b->y + (int32_t)b->height;
+    int32_t x2 = ax2 < bx2 ? ax2 : bx2;
+    int32_t y2 = ay2 < by2 ? ay2 : by2;
+    
+    if (x1 >= x2 || y1 >= y2) return 0;
+    out->x = x1;
+    out->y = y1;
+    out->width = x2 - x1;
+    out->height = y2 - y1;
+    return 1;
+}
+
+// Bounding box of a and b
+static inline Rect rect_union(const Rect* a, const Rect* b) {
+    int32_t x1 = a->x < b->x ? a->x : b->x;
+    int32_t y1 = a->y < b->y ? a->y : b->y;
+    int32_t ax2 = a->x + (int32_t)a->width, bx2 = b->x + (int32_t)b->width;
+    int32_t ay2 = a->y + (int32_t)a->height, by2 = b->y + (int32_t)b->height;
+    Rect r;
+    r.x = x1;
+    r.y = y1;
+    r.width = (ax2 > bx2 ? ax2 : bx2) - x1;
+    r.height = (ay2 > by2 ? ay2 : by2) - y1;
+    return r;
+}
+
 // ============================================================================
 // BACK BUFFER PIXEL OPERATIONS
 // ============================================================================
@@ -230,239 +441,503 @@ static inline int gpu_clip_rect(Rect* r) {
 #define GPU_GET_B(c)         GET_B(c)
 #define GPU_GET_A(c)         GET_A(c)
 
+// The back buffer, clipped to this CPU's viewport, as a draw.h target
+static inline DrawTarget gpu_target(void) {
+    DrawTarget t = {g_backbuffer.data, g_backbuffer.pitch, g_backbuffer.ops, g_viewport.x, g_viewport.y,
+                    g_viewport.x + (int32_t)g_viewport.width, g_viewport.y + (int32_t)g_viewport.height};
+    return t;
+}
+
+// The viewport always lies inside the back buffer
 static inline void gpu_put_pixel(int32_t x, int32_t y, Color color) {
-    if (x < 0 || x >= g_backbuffer.width || y < 0 || y >= g_backbuffer.height) return;
-    
-    uint8_t* row = g_backbuffer.data + y * g_backbuffer.pitch;
-    
-    if (g_backbuffer.bpp == 32) {
-        ((uint32_t*)row)[x] = color;
-    } else if (g_backbuffer.bpp == 24) {
-        uint8_t* p = row + x * 3;
-        p[0] = GET_B(color);
-        p[1] = GET_G(color);
-        p[2] = GET_R(color);
-    } else if (g_backbuffer.bpp == 16) {
-        uint16_t* p = (uint16_t*)row;
-        p[x] = ((GET_R(color) >> 3) << 11) | 
-               ((GET_G(color) >> 2) << 5) | 
-               (GET_B(color) >> 3);
-    }
+    DrawTarget t = gpu_target();
+    draw_put_pixel(&t, x, y, color);
 }
 
 static inline Color gpu_get_pixel(int32_t x, int32_t y) {
     if (x < 0 || x >= g_backbuffer.width || y < 0 || y >= g_backbuffer.height) return 0;
-    
-    uint8_t* row = g_backbuffer.data + y * g_backbuffer.pitch;
-    
-    if (g_backbuffer.bpp == 32) {
-        return ((uint32_t*)row)[x];
-    } else if (g_backbuffer.bpp == 24) {
-        uint8_t* p = row + x * 3;
-        return RGB(p[2], p[1], p[0]);
-    } else if (g_backbuffer.bpp == 16) {
-        uint16_t v = ((uint16_t*)row)[x];
-        return RGB(((v >> 11) & 0x1F) << 3, ((v >> 5) & 0x3F) << 2, (v & 0x1F) << 3);
-    }
-    return 0;
+    return g_backbuffer.ops->get(g_backbuffer.data + y * g_backbuffer.pitch, x);
 }
 
-// Alpha blending
+// Alpha blending of straight colors (fg over bg with the given alpha)
 static inline Color gpu_blend(Color fg, Color bg, uint8_t alpha) {
     uint8_t inv = 255 - alpha;
     return RGB(
-        (GET_R(fg) * alpha + GET_R(bg) * inv) / 255,
-        (GET_G(fg) * alpha + GET_G(bg) * inv) / 255,
-        (GET_B(fg) * alpha + GET_B(bg) * inv) / 255
+        blend_div255(GET_R(fg) * alpha + GET_R(bg) * inv),
+        blend_div255(GET_G(fg) * alpha + GET_G(bg) * inv),
+        blend_div255(GET_B(fg) * alpha + GET_B(bg) * inv)
     );
 }
 
+// Blend a premultiplied pixel (sprite data) over the back buffer
+static inline void gpu_put_pixel_premul(int32_t x, int32_t y, Color pixel) {
+    if (!gpu_clip_point(&x, &y)) return;
+    g_backbuffer.ops->blend(g_backbuffer.data + y * g_backbuffer.pitch, x, &pixel, 1);
+}
+
+// Blend a straight-alpha color
 static inline void gpu_put_pixel_alpha(int32_t x, int32_t y, Color color) {
-    uint8_t alpha = GET_A(color);
-    if (alpha == 0) return;
-    if (alpha == 255) {
-        gpu_put_pixel(x, y, color);
-        return;
-    }
-    Color bg = gpu_get_pixel(x, y);
-    gpu_put_pixel(x, y, gpu_blend(color, bg, alpha));
+    gpu_put_pixel_premul(x, y, blend_premultiply(color));
 }
 
 // ============================================================================
 // BACK BUFFER OPERATIONS
 // ============================================================================
 
+// Fill pixels [x, x + len) of row y, clipped once against the viewport
+static inline void gpu_fill_span(int32_t x, int32_t y, int32_t len, Color color) {
+    DrawTarget t = gpu_target();
+    draw_fill_span(&t, x, y, len, color);
+}
+
 static inline void gpu_clear(Color color) {
+    uint8_t* row = g_backbuffer.data;
     for (int32_t y = 0; y < g_backbuffer.height; y++) {
-        for (int32_t x = 0; x < g_backbuffer.width; x++) {
-            gpu_put_pixel(x, y, color);
-        }
+        g_backbuffer.ops->fill(row, 0, g_backbuffer.width, color);
+        row += g_backbuffer.pitch;
     }
 }
 
 static inline void gpu_clear_rect(int32_t x, int32_t y, uint32_t w, uint32_t h, Color color) {
-    Rect r = {x, y, w, h};
-    if (!gpu_clip_rect(&r)) return;
+    DrawTarget t = gpu_target();
+    draw_fill_rect(&t, x, y, (int32_t)w, (int32_t)h, color);
+}
+
+// ============================================================================
+// VSYNC (VGA input status register polling)
+// ============================================================================
+
+#define VGA_INPUT_STATUS_1   0x3DA
+#define VGA_STATUS_VRETRACE  0x08
+
+// How long one wait may take before it counts as a miss (polls are
+// counted instead when the clock is not calibrated). Vsync is given up
+// after GPU_VSYNC_MAX_MISSES misses in a row.
+#define GPU_VSYNC_TIMEOUT_NS 50000000ULL
+#define GPU_VSYNC_TIMEOUT    1000000
+#define GPU_VSYNC_MAX_MISSES 3
+
+// Retrace period bounds (250 Hz to 30 Hz) and how early the halt before a
+// predicted retrace stops; the PIT tick only wakes hlt once a millisecond
+#define GPU_VSYNC_MIN_PERIOD_NS 4000000u
+#define GPU_VSYNC_MAX_PERIOD_NS 34000000u
+#define GPU_VSYNC_SPIN_NS       2000000u
+
+static uint8_t g_swap_interval = 1;     // Retraces per present (0 = don't wait)
+static uint8_t g_vsync_available = 1;   // Cleared after GPU_VSYNC_MAX_MISSES misses in a row
+static uint8_t g_vsync_misses;
+static uint64_t g_vsync_last_ns;        // Start of the last retrace seen
+static uint32_t g_vsync_period_ns;      // Measured retrace period (0 = unknown)
+
+// Halt until shortly before the retrace predicted from the last one, so
+// the edge itself is still caught by spinning
+static inline void gpu_vsync_sleep(void) {
+    if (!g_vsync_period_ns || !timer_is_ready()) return;
     
-    for (uint32_t dy = 0; dy < r.height; dy++) {
-        for (uint32_t dx = 0; dx < r.width; dx++) {
-            gpu_put_pixel(r.x + dx, r.y + dy, color);
+    uint64_t now = timer_ns();
+    uint64_t n = udiv64_32(now - g_vsync_last_ns, g_vsync_period_ns) + 1;
+    uint64_t wake = g_vsync_last_ns + n * g_vsync_period_ns - GPU_VSYNC_SPIN_NS;
+    while (timer_ns() < wake) cpu_idle();
+}
+
+// Spin to the start of the next retrace. The pulse is shorter than the
+// 1 ms between timer interrupts, so the edges are polled with pause.
+static inline int gpu_vsync_edge(void) {
+    uint64_t deadline = timer_ns() + GPU_VSYNC_TIMEOUT_NS;
+    uint32_t spins = GPU_VSYNC_TIMEOUT;
+    
+    // Let a retrace already in progress finish, then catch a fresh one
+    for (int phase = 0; phase < 2; phase++) {
+        uint8_t want = phase ? VGA_STATUS_VRETRACE : 0;
+        while ((inb(VGA_INPUT_STATUS_1) & VGA_STATUS_VRETRACE) != want) {
+            if (timer_is_ready() ? timer_ns() > deadline : --spins == 0) return 0;
+            cpu_relax();
         }
     }
+    return 1;
+}
+
+// Wait for the start of the next vertical retrace. Returns 0 if the
+// hardware did not signal one in time. Without a known period the wait
+// runs on to the retrace after, which measures it.
+static inline int gpu_wait_vsync(void) {
+    if (!g_vsync_available) return 0;
+    
+    gpu_vsync_sleep();
+    int ok = gpu_vsync_edge();
+    if (ok && !g_vsync_period_ns && timer_is_ready()) {
+        uint64_t first = timer_ns();
+        ok = gpu_vsync_edge();
+        uint64_t gap = timer_ns() - first;
+        if (ok && gap >= GPU_VSYNC_MIN_PERIOD_NS && gap <= GPU_VSYNC_MAX_PERIOD_NS) {
+            g_vsync_period_ns = (uint32_t)gap;
+        }
+    }
+    
+    if (!ok) {
+        g_vsync_period_ns = 0;
+        if (++g_vsync_misses >= GPU_VSYNC_MAX_MISSES) g_vsync_available = 0;
+        return 0;
+    }
+    g_vsync_misses = 0;
+    g_vsync_last_ns = timer_ns();
+    return 1;
+}
+
+static inline int gpu_vsync_available(void) {
+    return g_vsync_available;
+}
+
+// Present every `interval` retraces (0 disables vsync, 2 halves the rate...)
+static inline void gpu_set_swap_interval(uint8_t interval) {
+    g_swap_interval = interval;
+}
+
+static inline uint8_t gpu_get_swap_interval(void) {
+    return g_swap_interval;
+}
+
+// Block until the next present slot
+static inline void gpu_wait_frame(void) {
+    for (uint8_t i = 0; i < g_swap_interval; i++) {
+        if (!gpu_wait_vsync()) break;
+    }
 }
 
 // ============================================================================
 // PRESENT / FLIP (Copy back buffer to front buffer)
+// gpu_present and gpu_present_rects wait for the present slot first, so a
+// flip or copy lands in the vertical retrace; gpu_present_rect does not.
 // ============================================================================
 
+// Pages in use by the swap chain (0 when presenting by copy)
+static inline uint8_t gpu_get_page_count(void) {
+    return g_swap.pages;
+}
+
+// Page being scanned out (the LFB itself when presenting by copy)
+static inline uint8_t* gpu_front_addr(void) {
+    if (g_swap.pages) return gpu_page_addr(g_swap.front);
+    return (uint8_t*)(uintptr_t)g_gpu.framebuffer_addr;
+}
+
+// How many frames old the back buffer contents are: 1 means it holds the
+// previous frame (copy present always), N means it was last rendered N
+// frames ago, 0 means its contents are undefined and must be redrawn
+static inline uint32_t gpu_get_buffer_age(void) {
+    if (!g_swap.pages) return 1;
+    uint32_t last = g_swap.page_frame[g_swap.back];
+    return last ? g_swap.frame + 1 - last : 0;
+}
+
+// Show the back page and move rendering to the next one
+static inline void gpu_flip(void) {
+    g_swap.frame++;
+    g_swap.page_frame[g_swap.back] = g_swap.frame;
+    gpu_hw_flip(g_swap.back);
+    g_swap.front = g_swap.back;
+    g_swap.back = (g_swap.back + 1) % g_swap.pages;
+    g_backbuffer.data = gpu_page_addr(g_swap.back);
+}
+
 static inline void gpu_present(void) {
+    PROFILE_ZONE(PROFILE_PRESENT);
+    gpu_wait_frame();
+    if (g_swap.pages) {
+        gpu_flip();
+        return;
+    }
+    if (g_gpu.type == GPU_TYPE_VIRTIO) {
+        gpu_hw_present_rect(0, 0, g_backbuffer.width, g_backbuffer.height);
+        gpu_hw_present_done();
+        return;
+    }
+    
     uint8_t* src = g_backbuffer.data;
     uint8_t* dst = (uint8_t*)(uintptr_t)g_gpu.framebuffer_addr;
     
-    // Copy each row (handles different pitches)
+    // One streaming copy when the pitches match, otherwise row by row
     uint32_t row_bytes = g_backbuffer.width * g_gpu.bytes_per_pixel;
+    if (g_backbuffer.pitch == row_bytes && g_gpu.pitch == row_bytes) {
+        mem_stream_copy(dst, src, row_bytes * g_backbuffer.height);
+        return;
+    }
     for (uint32_t y = 0; y < g_backbuffer.height; y++) {
-        uint8_t* src_row = src + y * g_backbuffer.pitch;
-        uint8_t* dst_row = dst + y * g_gpu.pitch;
-        for (uint32_t i = 0; i < row_bytes; i++) {
-            dst_row[i] = src_row[i];
-        }
+        mem_stream_copy(dst + y * g_gpu.pitch, src + y * g_backbuffer.pitch, row_bytes);
     }
 }
 
-// Present only a dirty region (optimization)
+// Present only a dirty region (optimization). With a swap chain the whole
+// page flips, so callers need the page complete (see gpu_get_buffer_age).
 static inline void gpu_present_rect(int32_t x, int32_t y, uint32_t w, uint32_t h) {
+    if (g_swap.pages) {
+        gpu_flip();
+        return;
+    }
+    
     Rect r = {x, y, w, h};
     if (!gpu_clip_rect(&r)) return;
+    if (g_gpu.type == GPU_TYPE_VIRTIO) {
+        gpu_hw_present_rect(r.x, r.y, r.width, r.height);
+        gpu_hw_present_done();
+        return;
+    }
     
     uint8_t* src = g_backbuffer.data;
     uint8_t* dst = (uint8_t*)(uintptr_t)g_gpu.framebuffer_addr;
     
+    uint32_t bytes = r.width * g_gpu.bytes_per_pixel;
     for (uint32_t dy = 0; dy < r.height; dy++) {
         uint8_t* src_row = src + (r.y + dy) * g_backbuffer.pitch + r.x * g_gpu.bytes_per_pixel;
         uint8_t* dst_row = dst + (r.y + dy) * g_gpu.pitch + r.x * g_gpu.bytes_per_pixel;
-        uint32_t bytes = r.width * g_gpu.bytes_per_pixel;
-        for (uint32_t i = 0; i < bytes; i++) {
-            dst_row[i] = src_row[i];
+        mem_stream_copy(dst_row, src_row, bytes);
+    }
+}
+
+// Present a set of dirty regions right now: copied one by one, or a single flip
+static inline void gpu_present_rects_immediate(const Rect* rects, uint32_t count) {
+    PROFILE_ZONE(PROFILE_PRESENT);
+    if (g_swap.pages) {
+        gpu_flip();
+        return;
+    }
+    // virtio-gpu: all the transfers and flushes go out in as few kicks as fit
+    if (g_gpu.type == GPU_TYPE_VIRTIO) {
+        for (uint32_t i = 0; i < count; i++) {
+            Rect r = rects[i];
+            if (gpu_clip_rect(&r)) gpu_hw_present_rect(r.x, r.y, r.width, r.height);
         }
+        gpu_hw_present_done();
+        return;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        gpu_present_rect(rects[i].x, rects[i].y, rects[i].width, rects[i].height);
     }
 }
 
+// Same, in the next present slot
+static inline void gpu_present_rects(const Rect* rects, uint32_t count) {
+    gpu_wait_frame();
+    gpu_present_rects_immediate(rects, count);
+}
+
 // ============================================================================
 // DRAWING PRIMITIVES (on back buffer)
 // ============================================================================
 
 static inline void gpu_draw_hline(int32_t x, int32_t y, uint32_t len, Color color) {
-    for (uint32_t i = 0; i < len; i++) {
-        gpu_put_pixel(x + i, y, color);
-    }
+    gpu_fill_span(x, y, (int32_t)len, color);
 }
 
+// Pixels [y, y + len) of column x, clipped once against the viewport
 static inline void gpu_draw_vline(int32_t x, int32_t y, uint32_t len, Color color) {
-    for (uint32_t i = 0; i < len; i++) {
-        gpu_put_pixel(x, y + i, color);
-    }
+    DrawTarget t = gpu_target();
+    draw_fill_column(&t, x, y, (int32_t)len, color);
 }
 
 static inline int32_t gpu_abs(int32_t x) { return x < 0 ? -x : x; }
 
+// Clipped once, then drawn as horizontal or vertical runs. The pixels do
+// not depend on the viewport, so a line split across tiles has no seams.
 static inline void gpu_draw_line(int32_t x0, int32_t y0, int32_t x1, int32_t y1, Color color) {
-    int32_t dx = gpu_abs(x1 - x0);
-    int32_t dy = gpu_abs(y1 - y0);
-    int32_t sx = x0 < x1 ? 1 : -1;
-    int32_t sy = y0 < y1 ? 1 : -1;
-    int32_t err = dx - dy;
-    
-    while (1) {
-        gpu_put_pixel(x0, y0, color);
-        if (x0 == x1 && y0 == y1) break;
-        int32_t e2 = 2 * err;
-        if (e2 > -dy) { err -= dy; x0 += sx; }
-        if (e2 < dx)  { err += dx; y0 += sy; }
-    }
+    DrawTarget t = gpu_target();
+    draw_line(&t, x0, y0, x1, y1, color);
 }
 
 static inline void gpu_draw_rect(int32_t x, int32_t y, uint32_t w, uint32_t h, Color color) {
-    gpu_draw_hline(x, y, w, color);
-    gpu_draw_hline(x, y + h - 1, w, color);
-    gpu_draw_vline(x, y, h, color);
-    gpu_draw_vline(x + w - 1, y, h, color);
+    DrawTarget t = gpu_target();
+    draw_rect(&t, x, y, (int32_t)w, (int32_t)h, color);
 }
 
 static inline void gpu_fill_rect(int32_t x, int32_t y, uint32_t w, uint32_t h, Color color) {
-    for (uint32_t dy = 0; dy < h; dy++) {
-        for (uint32_t dx = 0; dx < w; dx++) {
-            gpu_put_pixel(x + dx, y + dy, color);
-        }
-    }
+    gpu_clear_rect(x, y, w, h, color);
 }
 
 static inline void gpu_draw_circle(int32_t cx, int32_t cy, int32_t r, Color color) {
-    int32_t x = 0, y = r;
-    int32_t d = 1 - r;
-    
-    while (x <= y) {
-        gpu_put_pixel(cx + x, cy + y, color);
-        gpu_put_pixel(cx - x, cy + y, color);
-        gpu_put_pixel(cx + x, cy - y, color);
-        gpu_put_pixel(cx - x, cy - y, color);
-        gpu_put_pixel(cx + y, cy + x, color);
-        gpu_put_pixel(cx - y, cy + x, color);
-        gpu_put_pixel(cx + y, cy - x, color);
-        gpu_put_pixel(cx - y, cy - x, color);
-        
-        if (d < 0) { d += 2 * x + 3; }
-        else { d += 2 * (x - y) + 5; y--; }
-        x++;
-    }
+    DrawTarget t = gpu_target();
+    draw_circle(&t, cx, cy, r, color);
+}
+
+// Circle, ellipse and ring fills are row spans; only viewport rows are visited
+static inline void gpu_fill_ellipse(int32_t cx, int32_t cy, int32_t rx, int32_t ry, Color color) {
+    DrawTarget t = gpu_target();
+    draw_fill_ellipse(&t, cx, cy, rx, ry, color);
 }
 
 static inline void gpu_fill_circle(int32_t cx, int32_t cy, int32_t r, Color color) {
-    for (int32_t y = -r; y <= r; y++) {
-        for (int32_t x = -r; x <= r; x++) {
-            if (x * x + y * y <= r * r) {
-                gpu_put_pixel(cx + x, cy + y, color);
-            }
-        }
-    }
+    gpu_fill_ellipse(cx, cy, r, r, color);
+}
+
+static inline void gpu_fill_ring(int32_t cx, int32_t cy, int32_t r_outer, int32_t r_inner, Color color) {
+    DrawTarget t = gpu_target();
+    draw_fill_ring(&t, cx, cy, r_outer, r_inner, color);
 }
 
 // ============================================================================
 // SPRITE / BITMAP RENDERING
 // ============================================================================
 
+// Sprite pixels are premultiplied (see gpu_sprite_premultiply)
 static inline void gpu_blit_sprite(const Sprite* sprite, int32_t x, int32_t y) {
     if (!sprite || !sprite->pixels) return;
     
-    for (int32_t sy = 0; sy < sprite->height; sy++) {
-        for (int32_t sx = 0; sx < sprite->width; sx++) {
-            Color pixel = sprite->pixels[sy * sprite->width + sx];
-            uint8_t alpha = GET_A(pixel);
-            if (alpha > 0) {
-                if (alpha == 255) {
-                    gpu_put_pixel(x + sx, y + sy, pixel);
-                } else {
-                    gpu_put_pixel_alpha(x + sx, y + sy, pixel);
-                }
-            }
+    // Only walk the part of the sprite inside the viewport
+    Rect r = {x, y, sprite->width, sprite->height};
+    if (!gpu_clip_rect(&r)) return;
+    int32_t sx0 = r.x - x;
+    int32_t sy0 = r.y - y, sy1 = sy0 + (int32_t)r.height;
+    
+    // Whole rows through the format's blend writer (exact for alpha 0 and 255)
+    uint8_t* row = g_backbuffer.data + r.y * g_backbuffer.pitch;
+    for (int32_t sy = sy0; sy < sy1; sy++, row += g_backbuffer.pitch) {
+        g_backbuffer.ops->blend(row, r.x, sprite->pixels + sy * sprite->width + sx0, r.width);
+    }
+}
+
+// ---------- Scaled blits ----------
+// The destination is clipped once, then source positions are stepped from
+// pixel centers: an exact quotient/remainder DDA for nearest sampling,
+// 16.16 fixed point for bilinear. Nearest scaling at exactly 2x, 3x or 4x
+// expands rows with span_repeat32, and destination rows that land on the
+// same source row are scaled once and blended again. Bilinear filtering
+// interpolates the premultiplied pixels, which keeps edges free of halos.
+#define GPU_SCALE_CHUNK 256     // Destination pixels scaled per pass
+#define GPU_SCALE_MAX   0x7FFF  // Largest source or destination side
+
+typedef enum {
+    GPU_FILTER_NEAREST = 0,
+    GPU_FILTER_BILINEAR,
+} GPUFilter;
+
+// a + (b - a) * w / 256 for all four channels, two at a time
+static inline uint32_t gpu_lerp_premul(uint32_t a, uint32_t b, uint32_t w) {
+    uint32_t rb = (((a & 0x00FF00FF) * (256 - w) + (b & 0x00FF00FF) * w) >> 8) & 0x00FF00FF;
+    uint32_t ag = (((a >> 8) & 0x00FF00FF) * (256 - w) + ((b >> 8) & 0x00FF00FF) * w) & 0xFF00FF00;
+    return rb | ag;
+}
+
+// Source index of destination pixel d is floor((2d + 1) * src / (2 * dst)),
+// advanced by a whole part and a remainder with no division per pixel
+typedef struct {
+    uint32_t index;
+    uint32_t rem;
+    uint32_t whole;
+    uint32_t frac;
+    uint32_t den;
+} GPUScaleDDA;
+
+static inline void gpu_scale_dda_init(GPUScaleDDA* dda, uint32_t src, uint32_t dst, uint32_t d) {
+    uint32_t n = (2 * d + 1) * src;
+    dda->den = 2 * dst;
+    dda->index = n / dda->den;
+    dda->rem = n % dda->den;
+    dda->whole = src / dst;
+    dda->frac = 2 * (src % dst);
+}
+
+static inline void gpu_scale_dda_step(GPUScaleDDA* dda) {
+    dda->index += dda->whole;
+    dda->rem += dda->frac;
+    if (dda->rem >= dda->den) {
+        dda->rem -= dda->den;
+        dda->index++;
+    }
+}
+
+static inline void gpu_scale_row_nearest(uint32_t* dst, const uint32_t* src, GPUScaleDDA* dda, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) {
+        dst[i] = src[dda->index];
+        gpu_scale_dda_step(dda);
+    }
+}
+
+// fx may start negative (left of the first center): those pixels clamp
+static inline void gpu_scale_row_bilinear(uint32_t* dst, const uint32_t* row0, const uint32_t* row1, uint32_t wy,
+                                          int32_t fx, uint32_t step, uint32_t last, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++, fx += (int32_t)step) {
+        uint32_t x0 = 0, x1 = 0, wx = 0;
+        if (fx > 0) {
+            x0 = (uint32_t)fx >> 16;
+            wx = ((uint32_t)fx >> 8) & 0xFF;
+            if (x0 >= last) x0 = last;
+            x1 = x0 < last ? x0 + 1 : last;
         }
+        uint32_t top = gpu_lerp_premul(row0[x0], row0[x1], wx);
+        uint32_t bottom = gpu_lerp_premul(row1[x0], row1[x1], wx);
+        dst[i] = gpu_lerp_premul(top, bottom, wy);
     }
 }
 
-static inline void gpu_blit_sprite_scaled(const Sprite* sprite, int32_t x, int32_t y, 
-                                          uint32_t dst_w, uint32_t dst_h) {
-    if (!sprite || !sprite->pixels || dst_w == 0 || dst_h == 0) return;
-    
-    for (uint32_t dy = 0; dy < dst_h; dy++) {
-        uint32_t sy = (dy * sprite->height) / dst_h;
-        for (uint32_t dx = 0; dx < dst_w; dx++) {
-            uint32_t sx = (dx * sprite->width) / dst_w;
-            Color pixel = sprite->pixels[sy * sprite->width + sx];
-            if (GET_A(pixel) > 0) {
-                gpu_put_pixel_alpha(x + dx, y + dy, pixel);
+static inline void gpu_blit_sprite_scaled_filter(const Sprite* sprite, int32_t x, int32_t y,
+                                                 uint32_t dst_w, uint32_t dst_h, GPUFilter filter) {
+    if (!sprite || !sprite->pixels || !sprite->width || !sprite->height || dst_w == 0 || dst_h == 0) return;
+    uint32_t sw = sprite->width, sh = sprite->height;
+    if (sw > GPU_SCALE_MAX || sh > GPU_SCALE_MAX || dst_w > GPU_SCALE_MAX || dst_h > GPU_SCALE_MAX) return;
+    if (dst_w == sw && dst_h == sh) {
+        gpu_blit_sprite(sprite, x, y);
+        return;
+    }
+    
+    Rect r = {x, y, dst_w, dst_h};
+    if (!gpu_clip_rect(&r)) return;
+    uint32_t dx0 = r.x - x, dy0 = r.y - y;
+    uint32_t chunk[GPU_SCALE_CHUNK];
+    uint8_t* row = g_backbuffer.data + r.y * g_backbuffer.pitch;
+    
+    if (filter == GPU_FILTER_BILINEAR) {
+        uint32_t step_x = (sw << 16) / dst_w;
+        uint32_t step_y = (sh << 16) / dst_h;
+        int32_t fy = (int32_t)(dy0 * step_y + step_y / 2) - 0x8000;
+        for (uint32_t dy = 0; dy < r.height; dy++, row += g_backbuffer.pitch, fy += (int32_t)step_y) {
+            uint32_t y0 = 0, y1 = 0, wy = 0;
+            if (fy > 0) {
+                y0 = (uint32_t)fy >> 16;
+                wy = ((uint32_t)fy >> 8) & 0xFF;
+                if (y0 >= sh - 1) y0 = sh - 1;
+                y1 = y0 < sh - 1 ? y0 + 1 : y0;
+            }
+            const uint32_t* row0 = sprite->pixels + y0 * sw;
+            const uint32_t* row1 = sprite->pixels + y1 * sw;
+            for (uint32_t cx = 0; cx < r.width; cx += GPU_SCALE_CHUNK) {
+                uint32_t n = r.width - cx < GPU_SCALE_CHUNK ? r.width - cx : GPU_SCALE_CHUNK;
+                int32_t fx = (int32_t)((dx0 + cx) * step_x + step_x / 2) - 0x8000;
+                gpu_scale_row_bilinear(chunk, row0, row1, wy, fx, step_x, sw - 1, n);
+                g_backbuffer.ops->blend(row, r.x + cx, chunk, n);
             }
         }
+        return;
     }
+    
+    // Whole-number ratio the same on both axes: pure pixel repetition
+    uint32_t k = 0;
+    if (dst_w % sw == 0 && dst_h % sh == 0 && dst_w / sw == dst_h / sh) k = dst_w / sw;
+    if (k != 2 && k != 3 && k != 4) k = 0;
+    
+    GPUScaleDDA dda_y, dda_x;
+    gpu_scale_dda_init(&dda_y, sh, dst_h, dy0);
+    uint32_t cached = 0xFFFFFFFF;
+    int reuse = r.width <= GPU_SCALE_CHUNK;
+    for (uint32_t dy = 0; dy < r.height; dy++, row += g_backbuffer.pitch, gpu_scale_dda_step(&dda_y)) {
+        uint32_t sy = dda_y.index;
+        const uint32_t* src = sprite->pixels + sy * sw;
+        int fresh = !reuse || sy != cached;
+        if (fresh && !k) gpu_scale_dda_init(&dda_x, sw, dst_w, dx0);
+        for (uint32_t cx = 0; cx < r.width; cx += GPU_SCALE_CHUNK) {
+            uint32_t n = r.width - cx < GPU_SCALE_CHUNK ? r.width - cx : GPU_SCALE_CHUNK;
+            if (fresh) {
+                uint32_t sx = dx0 + cx;
+                if (k) span_repeat32(chunk, src + sx / k, n, k, sx % k);
+                else gpu_scale_row_nearest(chunk, src, &dda_x, n);
+            }
+            g_backbuffer.ops->blend(row, r.x + cx, chunk, n);
+        }
+        cached = sy;
+    }
+}
+
+static inline void gpu_blit_sprite_scaled(const Sprite* sprite, int32_t x, int32_t y, 
+                                          uint32_t dst_w, uint32_t dst_h) {
+    gpu_blit_sprite_scaled_filter(sprite, x, y, dst_w, dst_h, GPU_FILTER_NEAREST);
 }
 
 static inline void gpu_blit_sprite_region(const Sprite* sprite, int32_t dx, int32_t dy,
@@ -474,21 +949,55 @@ static inline void gpu_blit_sprite_region(const Sprite* sprite, int32_t dx, int3
             int32_t src_x = sx + rx;
             int32_t src_y = sy + ry;
             if (src_x >= 0 && src_x < sprite->width && src_y >= 0 && src_y < sprite->height) {
-                Color pixel = sprite->pixels[src_y * sprite->width + src_x];
-                if (GET_A(pixel) > 0) {
-                    gpu_put_pixel_alpha(dx + rx, dy + ry, pixel);
-                }
+                gpu_put_pixel_premul(dx + rx, dy + ry, sprite->pixels[src_y * sprite->width + src_x]);
             }
         }
     }
 }
 
+// ============================================================================
+// SPRITE MEMORY
+// ============================================================================
+
+// Sprites up to GPU_SPRITE_BLOCK bytes share a pool and can be freed;
+// larger ones take pages from the boot-time allocator for good
+#define GPU_SPRITE_BLOCK        (64 * 64 * 4)
+#define GPU_SPRITE_POOL_BLOCKS  32
+
+static Pool g_sprite_pool;
+
+static inline uint32_t* gpu_sprite_alloc_pixels(uint16_t w, uint16_t h) {
+    uint32_t size = (uint32_t)w * h * 4;
+    if (size == 0) return 0;
+    if (size <= GPU_SPRITE_BLOCK) {
+        if (!g_sprite_pool.base) pool_init(&g_sprite_pool, GPU_SPRITE_BLOCK, GPU_SPRITE_POOL_BLOCKS);
+        uint32_t* pixels = (uint32_t*)pool_alloc(&g_sprite_pool);
+        if (pixels) return pixels;
+    }
+    return (uint32_t*)pmm_alloc(size, PMM_PAGE_SIZE);
+}
+
+static inline void gpu_sprite_free(Sprite* sprite) {
+    pool_free(&g_sprite_pool, sprite->pixels);
+    sprite->pixels = 0;
+}
+
+// Convert straight-alpha pixels (e.g. loaded images) to the premultiplied
+// form every blitter expects. Opaque pixels are unchanged.
+static inline void gpu_sprite_premultiply(Sprite* sprite) {
+    uint32_t count = (uint32_t)sprite->width * sprite->height;
+    for (uint32_t i = 0; i < count; i++) sprite->pixels[i] = blend_premultiply(sprite->pixels[i]);
+}
+
 // ============================================================================
 // BITMAP CREATION HELPERS
+// `buffer` may be 0 to allocate with gpu_sprite_alloc_pixels
 // ============================================================================
 
 static inline void gpu_create_solid_sprite(Sprite* sprite, uint16_t w, uint16_t h, 
                                            Color color, uint32_t* buffer) {
+    if (!buffer) buffer = gpu_sprite_alloc_pixels(w, h);
+    if (!buffer) w = h = 0;
     sprite->width = w;
     sprite->height = h;
     sprite->pixels = buffer;
@@ -502,6 +1011,8 @@ static inline void gpu_create_solid_sprite(Sprite* sprite, uint16_t w, uint16_t
 
 static inline void gpu_create_gradient_sprite(Sprite* sprite, uint16_t w, uint16_t h,
                                               Color c1, Color c2, int vertical, uint32_t* buffer) {
+    if (!buffer) buffer = gpu_sprite_alloc_pixels(w, h);
+    if (!buffer) w = h = 0;
     sprite->width = w;
     sprite->height = h;
     sprite->pixels = buffer;
@@ -523,31 +1034,156 @@ static inline void gpu_create_gradient_sprite(Sprite* sprite, uint16_t w, uint16
 }
 
 // ============================================================================
-// VSYNC (best effort - no real hardware sync without PCI access)
+// RUN-LENGTH SPRITES
+// A Sprite pre-split into per-row runs of opaque pixels (copied) and
+// partly transparent pixels (blended); fully transparent pixels are not
+// stored at all. Build once, blit many times. The source pixels must stay
+// alive and unchanged while the RLE form is in use.
 // ============================================================================
 
-static inline void gpu_wait_vsync(void) {
-    for (volatile uint32_t i = 0; i < 100000; i++);
+#define SPRITE_RUN_COPY         0
+#define SPRITE_RUN_BLEND        1
+
+// Arena used when gpu_sprite_rle_build gets none
+#define GPU_SPRITE_RLE_ARENA    (64 * 1024)
+
+typedef struct {
+    uint16_t x;
+    uint16_t len;
+    uint16_t type;          // SPRITE_RUN_COPY or SPRITE_RUN_BLEND
+} SpriteRun;
+
+typedef struct {
+    const uint32_t* pixels;
+    uint16_t width;
+    uint16_t height;
+    uint32_t* row_start;    // height + 1 offsets into runs
+    SpriteRun* runs;
+    uint32_t run_count;
+    uint32_t opaque_pixels;
+    uint32_t blended_pixels;
+} SpriteRLE;
+
+static Arena g_sprite_rle_arena;
+
+static inline uint16_t gpu_sprite_run_type(Color pixel) {
+    uint8_t a = GET_A(pixel);
+    return a == 0 ? 0xFFFF : a == 255 ? SPRITE_RUN_COPY : SPRITE_RUN_BLEND;
+}
+
+// Walk one row; store the runs when `out` is set. Returns the run count.
+static inline uint32_t gpu_sprite_scan_row(const uint32_t* row, uint16_t width, SpriteRun* out) {
+    uint32_t n = 0;
+    uint16_t x = 0;
+    while (x < width) {
+        uint16_t type = gpu_sprite_run_type(row[x]);
+        uint16_t start = x;
+        while (x < width && gpu_sprite_run_type(row[x]) == type) x++;
+        if (type == 0xFFFF) continue;
+        if (out) {
+            out[n].x = start;
+            out[n].len = x - start;
+            out[n].type = type;
+        }
+        n++;
+    }
+    return n;
+}
+
+// Returns 0, or -1 when the arena (g_sprite_rle_arena if 0) is full
+static inline int gpu_sprite_rle_build(SpriteRLE* rle, const Sprite* sprite, Arena* arena) {
+    rle->run_count = 0;
+    rle->height = 0;
+    if (!sprite || !sprite->pixels) return -1;
+    if (!arena) {
+        if (!g_sprite_rle_arena.base && arena_init(&g_sprite_rle_arena, GPU_SPRITE_RLE_ARENA) != 0) return -1;
+        arena = &g_sprite_rle_arena;
+    }
+    
+    uint32_t total = 0;
+    for (uint16_t y = 0; y < sprite->height; y++) {
+        total += gpu_sprite_scan_row(sprite->pixels + y * sprite->width, sprite->width, 0);
+    }
+    
+    uint32_t mark = arena_save(arena);
+    rle->row_start = (uint32_t*)arena_alloc(arena, (sprite->height + 1) * sizeof(uint32_t), 4);
+    rle->runs = (SpriteRun*)arena_alloc(arena, (total ? total : 1) * sizeof(SpriteRun), 4);
+    if (!rle->row_start || !rle->runs) {
+        arena_restore(arena, mark);
+        return -1;
+    }
+    
+    rle->pixels = sprite->pixels;
+    rle->width = sprite->width;
+    rle->height = sprite->height;
+    rle->opaque_pixels = 0;
+    rle->blended_pixels = 0;
+    for (uint16_t y = 0; y < sprite->height; y++) {
+        rle->row_start[y] = rle->run_count;
+        rle->run_count += gpu_sprite_scan_row(sprite->pixels + y * sprite->width, sprite->width,
+                                              rle->runs + rle->run_count);
+    }
+    rle->row_start[sprite->height] = rle->run_count;
+    
+    for (uint32_t i = 0; i < rle->run_count; i++) {
+        if (rle->runs[i].type == SPRITE_RUN_COPY) rle->opaque_pixels += rle->runs[i].len;
+        else rle->blended_pixels += rle->runs[i].len;
+    }
+    return 0;
+}
+
+// Clipped once against the viewport, then whole runs at a time
+static inline void gpu_blit_sprite_rle(const SpriteRLE* rle, int32_t x, int32_t y) {
+    if (!rle || rle->height == 0) return;
+    
+    Rect r = {x, y, rle->width, rle->height};
+    if (!gpu_clip_rect(&r)) return;
+    int32_t sx0 = r.x - x, sx1 = sx0 + (int32_t)r.width;
+    int32_t sy0 = r.y - y, sy1 = sy0 + (int32_t)r.height;
+    
+    uint8_t* row = g_backbuffer.data + r.y * g_backbuffer.pitch;
+    for (int32_t sy = sy0; sy < sy1; sy++, row += g_backbuffer.pitch) {
+        const uint32_t* src = rle->pixels + sy * rle->width;
+        for (uint32_t i = rle->row_start[sy]; i < rle->row_start[sy + 1]; i++) {
+            const SpriteRun* run = &rle->runs[i];
+            int32_t a = run->x, b = run->x + run->len;
+            if (b <= sx0) continue;
+            if (a >= sx1) break;
+            if (a < sx0) a = sx0;
+            if (b > sx1) b = sx1;
+            
+            if (run->type == SPRITE_RUN_COPY) g_backbuffer.ops->copy(row, x + a, src + a, b - a);
+            else g_backbuffer.ops->blend(row, x + a, src + a, b - a);
+        }
+    }
 }
 
 // ============================================================================
 // MEMORY OPERATIONS (fast fills)
 // ============================================================================
 
+// Dispatch through the kernels memops_init() picked (AVX, SSE2 or rep)
 static inline void gpu_memset32(uint32_t* dst, uint32_t val, uint32_t count) {
-    while (count--) *dst++ = val;
+    g_memops.set32(dst, val, count);
 }
 
 static inline void gpu_memcpy32(uint32_t* dst, const uint32_t* src, uint32_t count) {
-    while (count--) *dst++ = *src++;
+    g_memops.copy32(dst, src, count);
 }
 
 static inline void gpu_fast_clear(Color color) {
-    if (g_backbuffer.bpp == 32) {
-        gpu_memset32((uint32_t*)g_backbuffer.data, color, 
-                     g_backbuffer.width * g_backbuffer.height);
-    } else {
+    if (g_backbuffer.bpp != 32) {
         gpu_clear(color);
+        return;
+    }
+    if (g_backbuffer.pitch == g_backbuffer.width * 4u) {
+        gpu_memset32((uint32_t*)g_backbuffer.data, color,
+                     g_backbuffer.width * g_backbuffer.height);
+        return;
+    }
+    for (uint32_t y = 0; y < g_backbuffer.height; y++) {
+        gpu_memset32((uint32_t*)(g_backbuffer.data + y * g_backbuffer.pitch), color,
+                     g_backbuffer.width);
     }
 }
 
@@ -2,7 +2,11 @@
 #define GPU_HW_H
 
 #include <stdint.h>
+#include "types.h"
 #include "pci.h"
+#include "paging.h"
+#include "cpu.h"
+#include "virtio_gpu.h"
 
 // ============================================================================
 // HARDWARE GPU DRIVER FOR MINI-OS
@@ -53,6 +57,51 @@ typedef enum {
 #define VBE_DISPI_ID4           0xB0C4
 #define VBE_DISPI_ID5           0xB0C5
 
+// ---------- VMware SVGA II Registers ----------
+// Index/value port pair at BAR0 (I/O), framebuffer at BAR1, command FIFO at BAR2
+#define SVGA_INDEX_PORT         0x0
+#define SVGA_VALUE_PORT         0x1
+
+#define SVGA_REG_ID             0
+#define SVGA_REG_ENABLE         1
+#define SVGA_REG_WIDTH          2
+#define SVGA_REG_HEIGHT         3
+#define SVGA_REG_MAX_WIDTH      4
+#define SVGA_REG_MAX_HEIGHT     5
+#define SVGA_REG_BITS_PER_PIXEL 7
+#define SVGA_REG_BYTES_PER_LINE 12
+#define SVGA_REG_FB_START       13
+#define SVGA_REG_FB_OFFSET      14
+#define SVGA_REG_VRAM_SIZE      15
+#define SVGA_REG_CAPABILITIES   17
+#define SVGA_REG_MEM_SIZE       19
+#define SVGA_REG_CONFIG_DONE    20
+#define SVGA_REG_SYNC           21
+#define SVGA_REG_BUSY           22
+#define SVGA_REG_CURSOR_ID      24
+#define SVGA_REG_CURSOR_X       25
+#define SVGA_REG_CURSOR_Y       26
+#define SVGA_REG_CURSOR_ON      27
+
+#define SVGA_ID_2               0x90000002
+
+#define SVGA_CAP_CURSOR         0x00000020
+#define SVGA_CAP_CURSOR_BYPASS_2 0x00000080
+#define SVGA_CAP_ALPHA_CURSOR   0x00000200
+
+// FIFO header (32-bit words); commands follow from fifo[SVGA_FIFO_MIN]
+#define SVGA_FIFO_MIN           0
+#define SVGA_FIFO_MAX           1
+#define SVGA_FIFO_NEXT_CMD      2
+#define SVGA_FIFO_STOP          3
+#define SVGA_FIFO_HEADER        16          // Bytes
+
+#define SVGA_CMD_DEFINE_CURSOR       19     // AND mask + color image
+#define SVGA_CMD_DEFINE_ALPHA_CURSOR 22     // Premultiplied ARGB
+
+#define SVGA_CURSOR_ID          1
+#define SVGA_SYNC_TIMEOUT       1000000
+
 // ---------- GPU Hardware State ----------
 typedef struct {
     GPUHardwareType type;
@@ -81,6 +130,15 @@ typedef struct {
 
 static GPUHardware g_gpu_hw;
 
+// VMware SVGA II: device capabilities and the command FIFO (0 = none)
+typedef struct {
+    uint32_t caps;
+    volatile uint32_t* fifo;
+    uint32_t fifo_size;
+} VMwareSVGA;
+
+static VMwareSVGA g_vmware;
+
 // ---------- Bochs VGA I/O Access ----------
 static inline void bochs_write(uint16_t index, uint16_t value) {
     outw(VBE_DISPI_IOPORT_INDEX, index);
@@ -141,6 +199,165 @@ static inline void bochs_set_y_offset(uint16_t y_offset) {
     bochs_write(VBE_DISPI_INDEX_Y_OFFSET, y_offset);
 }
 
+// Ask for `pages` screens of virtual height; returns how many fit.
+// QEMU derives VIRT_HEIGHT from VRAM size and ignores the write, so the
+// value is read back rather than trusted.
+static inline int bochs_set_virtual_pages(uint16_t width, uint16_t height, uint8_t pages) {
+    bochs_write(VBE_DISPI_INDEX_VIRT_WIDTH, width);
+    bochs_write(VBE_DISPI_INDEX_VIRT_HEIGHT, height * pages);
+    return bochs_read(VBE_DISPI_INDEX_VIRT_HEIGHT) / height;
+}
+
+// ---------- VMware SVGA I/O Access ----------
+static inline void vmware_write(uint32_t index, uint32_t value) {
+    outl(g_gpu_hw.io_base + SVGA_INDEX_PORT, index);
+    outl(g_gpu_hw.io_base + SVGA_VALUE_PORT, value);
+}
+
+static inline uint32_t vmware_read(uint32_t index) {
+    outl(g_gpu_hw.io_base + SVGA_INDEX_PORT, index);
+    return inl(g_gpu_hw.io_base + SVGA_VALUE_PORT);
+}
+
+// Let the device drain the FIFO
+static inline void vmware_sync(void) {
+    vmware_write(SVGA_REG_SYNC, 1);
+    for (uint32_t i = 0; i < SVGA_SYNC_TIMEOUT && vmware_read(SVGA_REG_BUSY); i++) cpu_relax();
+}
+
+// Negotiate the SVGA II interface and set up the FIFO. has_cursor is set
+// when the cursor can be defined through the FIFO and moved by registers.
+static inline int vmware_init(PCIDevice* dev) {
+    if (dev->bar_type[0] != 1) return -1;
+    g_gpu_hw.io_base = (uint16_t)pci_bar_get_addr(dev->bar[0]);
+    
+    vmware_write(SVGA_REG_ID, SVGA_ID_2);
+    if (vmware_read(SVGA_REG_ID) != SVGA_ID_2) return -1;
+    g_vmware.caps = vmware_read(SVGA_REG_CAPABILITIES);
+    g_gpu_hw.vram_size = vmware_read(SVGA_REG_VRAM_SIZE);
+    
+    // The FIFO is BAR2, mapped uncached as mmio by gpu_hw_init
+    g_vmware.fifo = 0;
+    uint32_t size = vmware_read(SVGA_REG_MEM_SIZE);
+    if (!g_gpu_hw.mmio_addr || size < SVGA_FIFO_HEADER * 2) return 0;
+    if (size > g_gpu_hw.mmio_size) size = g_gpu_hw.mmio_size;
+    
+    volatile uint32_t* fifo = (volatile uint32_t*)(uintptr_t)g_gpu_hw.mmio_addr;
+    fifo[SVGA_FIFO_MIN] = SVGA_FIFO_HEADER;
+    fifo[SVGA_FIFO_MAX] = size;
+    fifo[SVGA_FIFO_NEXT_CMD] = SVGA_FIFO_HEADER;
+    fifo[SVGA_FIFO_STOP] = SVGA_FIFO_HEADER;
+    vmware_write(SVGA_REG_CONFIG_DONE, 1);
+    g_vmware.fifo = fifo;
+    g_vmware.fifo_size = size;
+    
+    g_gpu_hw.has_cursor = (g_vmware.caps & SVGA_CAP_CURSOR) && (g_vmware.caps & SVGA_CAP_CURSOR_BYPASS_2);
+    return 0;
+}
+
+static inline int vmware_is_enabled(void) {
+    return g_gpu_hw.io_base && vmware_read(SVGA_REG_ENABLE);
+}
+
+// Program and enable an SVGA mode. The framebuffer is wherever the device
+// says, which need not be the address VBE used.
+static inline int vmware_set_mode(uint16_t width, uint16_t height, uint8_t bpp) {
+    if (width > vmware_read(SVGA_REG_MAX_WIDTH) || height > vmware_read(SVGA_REG_MAX_HEIGHT)) return -1;
+    
+    vmware_write(SVGA_REG_WIDTH, width);
+    vmware_write(SVGA_REG_HEIGHT, height);
+    vmware_write(SVGA_REG_BITS_PER_PIXEL, bpp);
+    vmware_write(SVGA_REG_ENABLE, 1);
+    
+    uint32_t pitch = vmware_read(SVGA_REG_BYTES_PER_LINE);
+    if (pitch > 0xFFFF || (uint64_t)pitch * height > g_gpu_hw.vram_size) return -1;
+    g_gpu_hw.fb_addr = vmware_read(SVGA_REG_FB_START) + vmware_read(SVGA_REG_FB_OFFSET);
+    g_gpu_hw.pitch = pitch;
+    return 0;
+}
+
+// Append one command; waits for room, returns -1 if it can never fit
+static inline int vmware_fifo_write(const uint32_t* words, uint32_t count) {
+    volatile uint32_t* fifo = g_vmware.fifo;
+    if (!fifo) return -1;
+    uint32_t min = fifo[SVGA_FIFO_MIN], max = fifo[SVGA_FIFO_MAX];
+    uint32_t bytes = count * 4;
+    if (bytes >= max - min) return -1;
+    
+    // Free bytes between NEXT_CMD and STOP, one word kept empty
+    for (uint32_t i = 0; i < SVGA_SYNC_TIMEOUT; i++) {
+        uint32_t next = fifo[SVGA_FIFO_NEXT_CMD], stop = fifo[SVGA_FIFO_STOP];
+        uint32_t used = next >= stop ? next - stop : (max - stop) + (next - min);
+        if (max - min - used - 4 >= bytes) break;
+        vmware_sync();
+    }
+    
+    uint32_t next = fifo[SVGA_FIFO_NEXT_CMD];
+    for (uint32_t i = 0; i < count; i++) {
+        fifo[next / 4] = words[i];
+        next += 4;
+        if (next == max) next = min;
+    }
+    __asm__ volatile ("" ::: "memory");
+    fifo[SVGA_FIFO_NEXT_CMD] = next;
+    return 0;
+}
+
+// ---------- VMware SVGA Cursor ----------
+#define VMWARE_CURSOR_MAX   32
+
+// Premultiplied ARGB image, hotspot at (hot_x, hot_y). Without alpha
+// cursors the image is thresholded into an AND mask and color pixels.
+static inline int vmware_define_cursor(const uint32_t* pixels, uint16_t w, uint16_t h,
+                                       int16_t hot_x, int16_t hot_y) {
+    if (!g_gpu_hw.has_cursor || w > VMWARE_CURSOR_MAX || h > VMWARE_CURSOR_MAX) return -1;
+    
+    static uint32_t cmd[8 + VMWARE_CURSOR_MAX + VMWARE_CURSOR_MAX * VMWARE_CURSOR_MAX];
+    uint32_t n = 0;
+    if (g_vmware.caps & SVGA_CAP_ALPHA_CURSOR) {
+        cmd[n++] = SVGA_CMD_DEFINE_ALPHA_CURSOR;
+        cmd[n++] = SVGA_CURSOR_ID;
+        cmd[n++] = hot_x;
+        cmd[n++] = hot_y;
+        cmd[n++] = w;
+        cmd[n++] = h;
+        for (uint32_t i = 0; i < (uint32_t)w * h; i++) cmd[n++] = pixels[i];
+    } else {
+        // Masks get padded to 32-pixel rows, so send the image that wide
+        cmd[n++] = SVGA_CMD_DEFINE_CURSOR;
+        cmd[n++] = SVGA_CURSOR_ID;
+        cmd[n++] = hot_x;
+        cmd[n++] = hot_y;
+        cmd[n++] = VMWARE_CURSOR_MAX;
+        cmd[n++] = h;
+        cmd[n++] = 1;                       // AND mask depth
+        cmd[n++] = 32;                      // Color depth
+        // One bit per pixel, leftmost in the top bit of the first byte; 1 keeps the screen
+        for (uint32_t y = 0; y < h; y++) {
+            uint32_t mask = 0;
+            for (uint32_t x = 0; x < VMWARE_CURSOR_MAX; x++) {
+                if (x >= w || (pixels[y * w + x] >> 24) < 0x80) mask |= 0x80000000u >> x;
+            }
+            cmd[n++] = __builtin_bswap32(mask);
+        }
+        for (uint32_t y = 0; y < h; y++) {
+            for (uint32_t x = 0; x < VMWARE_CURSOR_MAX; x++) {
+                uint32_t p = x < w ? pixels[y * w + x] : 0;
+                cmd[n++] = (p >> 24) < 0x80 ? 0 : p & 0xFFFFFF;
+            }
+        }
+    }
+    return vmware_fifo_write(cmd, n);
+}
+
+// Hotspot position; bypass 2 registers take effect without the FIFO
+static inline void vmware_move_cursor(int32_t x, int32_t y, uint8_t visible) {
+    vmware_write(SVGA_REG_CURSOR_ID, SVGA_CURSOR_ID);
+    vmware_write(SVGA_REG_CURSOR_X, (uint32_t)x);
+    vmware_write(SVGA_REG_CURSOR_Y, (uint32_t)y);
+    vmware_write(SVGA_REG_CURSOR_ON, visible);
+}
+
 // ---------- GPU Hardware Initialization ----------
 static inline int gpu_hw_init(void) {
     // Initialize state
@@ -150,6 +367,7 @@ static inline int gpu_hw_init(void) {
     g_gpu_hw.mmio_addr = 0;
     g_gpu_hw.has_accel = 0;
     g_gpu_hw.has_cursor = 0;
+    g_gpu_hw.io_base = 0;
     
     // Enumerate PCI bus
     pci_enumerate();
@@ -164,15 +382,17 @@ static inline int gpu_hw_init(void) {
         pci_enable_device(gpu);
         
         // Get framebuffer from BAR0 (typically)
-        if (gpu->bar_type[0] == 2 || gpu->bar_type[0] == 3) {
-            g_gpu_hw.fb_addr = pci_bar_get_addr(gpu->bar[0]);
+        if ((gpu->bar_type[0] == 2 || gpu->bar_type[0] == 3) && !pci_bar_above_4g(gpu, 0)) {
             g_gpu_hw.fb_size = gpu->bar_size[0];
+            g_gpu_hw.fb_addr = (uint32_t)(uintptr_t)paging_map(pci_bar_get_addr(gpu->bar[0]),
+                                                               g_gpu_hw.fb_size, PAGE_CACHE_WC);
         }
         
         // Get MMIO from BAR2 (for some GPUs)
         if (gpu->bar_type[2] == 2) {
-            g_gpu_hw.mmio_addr = pci_bar_get_addr(gpu->bar[2]);
             g_gpu_hw.mmio_size = gpu->bar_size[2];
+            g_gpu_hw.mmio_addr = (uint32_t)(uintptr_t)paging_map(pci_bar_get_addr(gpu->bar[2]),
+                                                                 g_gpu_hw.mmio_size, PAGE_CACHE_UC);
         }
         
         // Detect GPU type
@@ -181,11 +401,17 @@ static inline int gpu_hw_init(void) {
                 g_gpu_hw.type = GPU_HW_BOCHS;
                 g_gpu_hw.vram_size = bochs_get_vram_size();
                 g_gpu_hw.has_accel = 0;
-                g_gpu_hw.has_cursor = 1;
+                g_gpu_hw.has_cursor = 0;    // Dispi has no cursor registers
             }
         } else if (gpu->vendor_id == PCI_VENDOR_VMWARE) {
             g_gpu_hw.type = GPU_HW_VMWARE_SVGA;
-            // VMware SVGA has more complex initialization
+            vmware_init(gpu);
+        } else if (gpu->vendor_id == PCI_VENDOR_VIRTIO && gpu->device_id == VIRTIO_GPU_DEVICE_ID) {
+            // virtio-vga: VBE got us booted, the virtio side takes over scanout
+            if (virtio_gpu_init(gpu) == 0) {
+                g_gpu_hw.type = GPU_HW_VIRTIO_GPU;
+                g_gpu_hw.has_cursor = 1;
+            }
         } else if (gpu->vendor_id == PCI_VENDOR_INTEL) {
             g_gpu_hw.type = GPU_HW_INTEL;
         } else if (gpu->vendor_id == PCI_VENDOR_AMD) {
@@ -210,15 +436,93 @@ static inline int gpu_hw_init(void) {
     return -1;
 }
 
+// ---------- VBE Mode Table ----------
+// The loader lists the LFB modes the BIOS offers and sets the best one by
+// the same policy; on Bochs/QEMU the kernel can pick again with its own.
+
+// Loader default: 1024x768 at 60 Hz is ~190 MB/s of 32-bit fills
+#ifndef GPU_MODE_MAX_PIXELS
+#define GPU_MODE_MAX_PIXELS (1024 * 768)
+#endif
+
+typedef struct {
+    uint32_t max_pixels;    // Cap on width * height, from the fill-rate budget (0 = none)
+    uint8_t  bpp;           // Preferred depth
+} GPUModePolicy;
+
+static inline const struct VBEModeEntry* gpu_hw_get_modes(uint32_t* count) {
+    struct BootInfo* info = BOOTINFO;
+    *count = info->vbe_modes_addr ? info->vbe_mode_count : 0;
+    if (*count > VBE_MODES_MAX) *count = VBE_MODES_MAX;
+    return (const struct VBEModeEntry*)(uintptr_t)info->vbe_modes_addr;
+}
+
+// Preferred depth first, then a pitch of exactly width * 4, then the most
+// pixels. 0 = over the cap.
+static inline uint32_t gpu_hw_mode_score(const struct VBEModeEntry* m, const GPUModePolicy* policy) {
+    uint32_t pixels = (uint32_t)m->width * m->height;
+    if (pixels == 0 || (policy->max_pixels && pixels > policy->max_pixels)) return 0;
+    
+    uint32_t score = pixels & 0x3FFFFFFF;
+    if (m->bpp == policy->bpp) score |= 0x80000000u;
+    if (m->pitch == (uint32_t)m->width * 4) score |= 0x40000000u;
+    return score;
+}
+
+// Best listed mode for the policy, or 0 if none qualifies
+static inline const struct VBEModeEntry* gpu_hw_pick_mode(const GPUModePolicy* policy) {
+    uint32_t count;
+    const struct VBEModeEntry* modes = gpu_hw_get_modes(&count);
+    const struct VBEModeEntry* best = 0;
+    uint32_t best_score = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t score = gpu_hw_mode_score(&modes[i], policy);
+        if (score > best_score) {
+            best_score = score;
+            best = &modes[i];
+        }
+    }
+    return best;
+}
+
 // ---------- GPU Mode Setting ----------
+// Bochs/QEMU: the dispi registers take any size that fits in VRAM and the
+// LFB address stays the same. VMware SVGA: fb_addr is updated to where the
+// device puts the framebuffer. virtio-gpu: 32 bpp at any size.
 static inline int gpu_hw_set_mode(uint16_t width, uint16_t height, uint8_t bpp) {
     if (g_gpu_hw.type == GPU_HW_BOCHS) {
+        uint32_t pitch = (uint32_t)width * (bpp / 8);
+        if (width == 0 || height == 0 || pitch > 0xFFFF) return -1;
+        if (g_gpu_hw.vram_size && pitch * height > g_gpu_hw.vram_size) return -1;
+        
         bochs_set_mode(width, height, bpp);
         
         g_gpu_hw.width = width;
         g_gpu_hw.height = height;
         g_gpu_hw.bpp = bpp;
-        g_gpu_hw.pitch = width * (bpp / 8);
+        g_gpu_hw.pitch = pitch;
+        
+        return 0;
+    }
+    
+    if (g_gpu_hw.type == GPU_HW_VMWARE_SVGA && g_gpu_hw.io_base) {
+        if (width == 0 || height == 0 || vmware_set_mode(width, height, bpp) != 0) return -1;
+        
+        g_gpu_hw.width = width;
+        g_gpu_hw.height = height;
+        g_gpu_hw.bpp = bpp;
+        
+        return 0;
+    }
+    
+    // virtio-gpu: any size; the new resource is made at gpu_hw_attach_backbuffer
+    if (g_gpu_hw.type == GPU_HW_VIRTIO_GPU) {
+        if (width == 0 || height == 0 || bpp != 32 || (uint32_t)width * 4 > 0xFFFF) return -1;
+        
+        g_gpu_hw.width = width;
+        g_gpu_hw.height = height;
+        g_gpu_hw.bpp = 32;
+        g_gpu_hw.pitch = width * 4;
         
         return 0;
     }
@@ -227,6 +531,45 @@ static inline int gpu_hw_set_mode(uint16_t width, uint16_t height, uint8_t bpp)
     return -1;
 }
 
+// ---------- GPU Page Flip Setup ----------
+// Adopt the mode the bootloader set and reserve up to `pages` flip pages.
+// Returns the number of pages usable for flipping (< 2 means copy present).
+static inline int gpu_hw_setup_flip(uint16_t width, uint16_t height, uint8_t bpp,
+                                    uint16_t pitch, uint8_t pages) {
+    if (g_gpu_hw.type != GPU_HW_BOCHS || height == 0 || pitch == 0) return 0;
+    
+    g_gpu_hw.width = width;
+    g_gpu_hw.height = height;
+    g_gpu_hw.bpp = bpp;
+    g_gpu_hw.pitch = pitch;
+    
+    uint32_t fit = g_gpu_hw.vram_size / ((uint32_t)pitch * height);
+    if (pages > fit) pages = fit;
+    if (pages < 2) return 0;
+    
+    int avail = bochs_set_virtual_pages(width, height, pages);
+    if (avail < pages) pages = avail;
+    bochs_set_y_offset(0);
+    return pages < 2 ? 0 : pages;
+}
+
+// ---------- GPU Host Present ----------
+// virtio-gpu scans out a host resource backed by the back buffer in RAM;
+// presenting asks the host to copy rects out of it
+static inline int gpu_hw_attach_backbuffer(void* memory, uint16_t width, uint16_t height, uint32_t pitch) {
+    if (g_gpu_hw.type != GPU_HW_VIRTIO_GPU) return -1;
+    return virtio_gpu_set_buffer(memory, width, height, pitch);
+}
+
+// Queue one rect; gpu_hw_present_done sends whatever is still queued
+static inline void gpu_hw_present_rect(uint32_t x, uint32_t y, uint32_t w, uint32_t h) {
+    virtio_gpu_present_rect(x, y, w, h);
+}
+
+static inline void gpu_hw_present_done(void) {
+    virtio_gpu_present_done();
+}
+
 // ---------- GPU Page Flip (Hardware Double Buffering) ----------
 static inline void gpu_hw_flip(int page) {
     if (g_gpu_hw.type == GPU_HW_BOCHS) {
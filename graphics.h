@@ -2,6 +2,12 @@
 #define GRAPHICS_H
 
 #include "types.h"
+#include "span.h"
+#include "cpu.h"
+#include "blend.h"
+#include "raster.h"
+#include "draw.h"
+#include "trig.h"
 
 // ============================================================================
 // GRAPHICS LIBRARY FOR MINI-OS
@@ -15,9 +21,12 @@ typedef struct {
     uint16_t height;
     uint16_t pitch;
     uint8_t  bpp;
+    const PixelOps* ops;    // Writers for this pixel format (span.h)
 } GraphicsContext;
 
-static GraphicsContext g_ctx;
+// One drawing target per CPU so tile jobs can each point at their own tile
+static GraphicsContext g_cpu_ctx[CPU_MAX];
+#define g_ctx (g_cpu_ctx[cpu_index()])
 
 // ---------- Initialization ----------
 static inline void gfx_init(void) {
@@ -27,57 +36,40 @@ static inline void gfx_init(void) {
     g_ctx.height = info->fb_height;
     g_ctx.pitch = info->fb_pitch;
     g_ctx.bpp = info->fb_bpp;
+    g_ctx.ops = span_select(g_ctx.bpp);
+    blend_init();
 }
 
 // ---------- Basic pixel operations ----------
+// The whole context as a draw.h target
+static inline DrawTarget gfx_target(void) {
+    DrawTarget t = {g_ctx.framebuffer, g_ctx.pitch, g_ctx.ops, 0, 0, g_ctx.width, g_ctx.height};
+    return t;
+}
+
 static inline void gfx_put_pixel(int x, int y, Color color) {
-    if (x < 0 || x >= g_ctx.width || y < 0 || y >= g_ctx.height) return;
-    
-    uint8_t* row = g_ctx.framebuffer + y * g_ctx.pitch;
-    
-    if (g_ctx.bpp == 32) {
-        uint32_t* p = (uint32_t*)row;
-        p[x] = color;
-    } else if (g_ctx.bpp == 24) {
-        uint8_t* p = row + x * 3;
-        p[0] = GET_B(color);
-        p[1] = GET_G(color);
-        p[2] = GET_R(color);
-    } else if (g_ctx.bpp == 16) {
-        uint16_t* p = (uint16_t*)row;
-        uint16_t r5 = (GET_R(color) >> 3) & 0x1F;
-        uint16_t g6 = (GET_G(color) >> 2) & 0x3F;
-        uint16_t b5 = (GET_B(color) >> 3) & 0x1F;
-        p[x] = (r5 << 11) | (g6 << 5) | b5;
-    }
+    DrawTarget t = gfx_target();
+    draw_put_pixel(&t, x, y, color);
 }
 
 static inline Color gfx_get_pixel(int x, int y) {
     if (x < 0 || x >= g_ctx.width || y < 0 || y >= g_ctx.height) return 0;
-    
-    uint8_t* row = g_ctx.framebuffer + y * g_ctx.pitch;
-    
-    if (g_ctx.bpp == 32) {
-        return ((uint32_t*)row)[x];
-    } else if (g_ctx.bpp == 24) {
-        uint8_t* p = row + x * 3;
-        return RGB(p[2], p[1], p[0]);
-    } else if (g_ctx.bpp == 16) {
-        uint16_t v = ((uint16_t*)row)[x];
-        uint8_t r = ((v >> 11) & 0x1F) << 3;
-        uint8_t g = ((v >> 5) & 0x3F) << 2;
-        uint8_t b = (v & 0x1F) << 3;
-        return RGB(r, g, b);
-    }
-    return 0;
+    return g_ctx.ops->get(g_ctx.framebuffer + y * g_ctx.pitch, x);
+}
+
+// ---------- Span operations ----------
+// Fill pixels [x, x + len) of row y. Clipping happens once per span.
+static inline void gfx_fill_span(int x, int y, int len, Color color) {
+    DrawTarget t = gfx_target();
+    draw_fill_span(&t, x, y, len, color);
 }
 
 // ---------- Color utilities ----------
 static inline Color color_blend(Color fg, Color bg, uint8_t alpha) {
     uint8_t inv_alpha = 255 - alpha;
-    uint8_t r = (GET_R(fg) * alpha + GET_R(bg) * inv_alpha) / 255;
-    uint8_t g = (GET_G(fg) * alpha + GET_G(bg) * inv_alpha) / 255;
-    uint8_t b = (GET_B(fg) * alpha + GET_B(bg) * inv_alpha) / 255;
+    uint8_t r = blend_div255(GET_R(fg) * alpha + GET_R(bg) * inv_alpha);
+    uint8_t g = blend_div255(GET_G(fg) * alpha + GET_G(bg) * inv_alpha);
+    uint8_t b = blend_div255(GET_B(fg) * alpha + GET_B(bg) * inv_alpha);
     return RGB(r, g, b);
 }
 
@@ -127,10 +119,10 @@ static inline Color color_from_hsv(int h, uint8_t s, uint8_t v) {
 
 // ---------- Screen operations ----------
 static inline void gfx_clear(Color color) {
+    uint8_t* row = g_ctx.framebuffer;
     for (int y = 0; y < g_ctx.height; y++) {
-        for (int x = 0; x < g_ctx.width; x++) {
-            gfx_put_pixel(x, y, color);
-        }
+        g_ctx.ops->fill(row, 0, g_ctx.width, color);
+        row += g_ctx.pitch;
     }
 }
 
@@ -138,9 +130,7 @@ static inline void gfx_fill_gradient_v(Color top, Color bottom) {
     for (int y = 0; y < g_ctx.height; y++) {
         uint8_t t = (y * 255) / g_ctx.height;
         Color c = color_lerp(top, bottom, t);
-        for (int x = 0; x < g_ctx.width; x++) {
-            gfx_put_pixel(x, y, c);
-        }
+        g_ctx.ops->fill(g_ctx.framebuffer + y * g_ctx.pitch, 0, g_ctx.width, c);
     }
 }
 
@@ -156,57 +146,41 @@ static inline void gfx_fill_gradient_h(Color left, Color right) {
 // ---------- Line drawing (Bresenham's algorithm) ----------
 static inline int abs_int(int x) { return x < 0 ? -x : x; }
 
+// Pixels [y, y + len) of column x, clipped once
+static inline void gfx_fill_column(int x, int y, int len, Color color) {
+    DrawTarget t = gfx_target();
+    draw_fill_column(&t, x, y, len, color);
+}
+
+static inline void gfx_draw_hline(int x, int y, int len, Color color) {
+    gfx_fill_span(x, y, len, color);
+}
+
+static inline void gfx_draw_vline(int x, int y, int len, Color color) {
+    gfx_fill_column(x, y, len, color);
+}
+
+// Clipped once, then drawn as horizontal or vertical runs
 static inline void gfx_draw_line(int x0, int y0, int x1, int y1, Color color) {
-    int dx = abs_int(x1 - x0);
-    int dy = abs_int(y1 - y0);
-    int sx = x0 < x1 ? 1 : -1;
-    int sy = y0 < y1 ? 1 : -1;
-    int err = dx - dy;
-    
-    while (1) {
-        gfx_put_pixel(x0, y0, color);
-        if (x0 == x1 && y0 == y1) break;
-        int e2 = 2 * err;
-        if (e2 > -dy) { err -= dy; x0 += sx; }
-        if (e2 < dx)  { err += dx; y0 += sy; }
-    }
+    DrawTarget t = gfx_target();
+    draw_line(&t, x0, y0, x1, y1, color);
 }
 
+// One filled quad with square caps
 static inline void gfx_draw_line_thick(int x0, int y0, int x1, int y1, int thickness, Color color) {
-    int dx = abs_int(x1 - x0);
-    int dy = abs_int(y1 - y0);
-    int sx = x0 < x1 ? 1 : -1;
-    int sy = y0 < y1 ? 1 : -1;
-    int err = dx - dy;
-    int half = thickness / 2;
-    
-    while (1) {
-        for (int ty = -half; ty <= half; ty++) {
-            for (int tx = -half; tx <= half; tx++) {
-                gfx_put_pixel(x0 + tx, y0 + ty, color);
-            }
-        }
-        if (x0 == x1 && y0 == y1) break;
-        int e2 = 2 * err;
-        if (e2 > -dy) { err -= dy; x0 += sx; }
-        if (e2 < dx)  { err += dx; y0 += sy; }
-    }
+    DrawTarget t = gfx_target();
+    draw_line_thick(&t, x0, y0, x1, y1, thickness, color);
 }
 
 // ---------- Rectangle drawing ----------
 static inline void gfx_draw_rect(int x, int y, int w, int h, Color color) {
-    gfx_draw_line(x, y, x + w - 1, y, color);
-    gfx_draw_line(x, y + h - 1, x + w - 1, y + h - 1, color);
-    gfx_draw_line(x, y, x, y + h - 1, color);
-    gfx_draw_line(x + w - 1, y, x + w - 1, y + h - 1, color);
+    DrawTarget t = gfx_target();
+    draw_rect(&t, x, y, w, h, color);
 }
 
 static inline void gfx_fill_rect(int x, int y, int w, int h, Color color) {
-    for (int dy = 0; dy < h; dy++) {
-        for (int dx = 0; dx < w; dx++) {
-            gfx_put_pixel(x + dx, y + dy, color);
-        }
-    }
+    DrawTarget t = gfx_target();
+    draw_fill_rect(&t, x, y, w, h, color);
 }
 
 static inline void gfx_draw_rect_rounded(int x, int y, int w, int h, int r, Color color) {
@@ -257,62 +231,19 @@ static inline void gfx_draw_rect_rounded(int x, int y, int w, int h, int r, Colo
 
 // ---------- Circle drawing (Midpoint circle algorithm) ----------
 static inline void gfx_draw_circle(int cx, int cy, int r, Color color) {
-    int x = 0, y = r;
-    int d = 1 - r;
-    
-    while (x <= y) {
-        gfx_put_pixel(cx + x, cy + y, color);
-        gfx_put_pixel(cx - x, cy + y, color);
-        gfx_put_pixel(cx + x, cy - y, color);
-        gfx_put_pixel(cx - x, cy - y, color);
-        gfx_put_pixel(cx + y, cy + x, color);
-        gfx_put_pixel(cx - y, cy + x, color);
-        gfx_put_pixel(cx + y, cy - x, color);
-        gfx_put_pixel(cx - y, cy - x, color);
-        
-        if (d < 0) {
-            d += 2 * x + 3;
-        } else {
-            d += 2 * (x - y) + 5;
-            y--;
-        }
-        x++;
-    }
+    DrawTarget t = gfx_target();
+    draw_circle(&t, cx, cy, r, color);
 }
 
+// Row spans with half-widths walked from one row to the next (raster.h)
 static inline void gfx_fill_circle(int cx, int cy, int r, Color color) {
-    int x = 0, y = r;
-    int d = 1 - r;
-    
-    while (x <= y) {
-        for (int i = cx - x; i <= cx + x; i++) {
-            gfx_put_pixel(i, cy + y, color);
-            gfx_put_pixel(i, cy - y, color);
-        }
-        for (int i = cx - y; i <= cx + y; i++) {
-            gfx_put_pixel(i, cy + x, color);
-            gfx_put_pixel(i, cy - x, color);
-        }
-        
-        if (d < 0) {
-            d += 2 * x + 3;
-        } else {
-            d += 2 * (x - y) + 5;
-            y--;
-        }
-        x++;
-    }
+    DrawTarget t = gfx_target();
+    draw_fill_ellipse(&t, cx, cy, r, r, color);
 }
 
 static inline void gfx_draw_ring(int cx, int cy, int r_outer, int r_inner, Color color) {
-    for (int y = -r_outer; y <= r_outer; y++) {
-        for (int x = -r_outer; x <= r_outer; x++) {
-            int dist_sq = x * x + y * y;
-            if (dist_sq <= r_outer * r_outer && dist_sq >= r_inner * r_inner) {
-                gfx_put_pixel(cx + x, cy + y, color);
-            }
-        }
-    }
+    DrawTarget t = gfx_target();
+    draw_fill_ring(&t, cx, cy, r_outer, r_inner, color);
 }
 
 // ---------- Ellipse drawing ----------
@@ -360,13 +291,8 @@ static inline void gfx_draw_ellipse(int cx, int cy, int rx, int ry, Color color)
 }
 
 static inline void gfx_fill_ellipse(int cx, int cy, int rx, int ry, Color color) {
-    for (int y = -ry; y <= ry; y++) {
-        for (int x = -rx; x <= rx; x++) {
-            if ((x * x * ry * ry + y * y * rx * rx) <= rx * rx * ry * ry) {
-                gfx_put_pixel(cx + x, cy + y, color);
-            }
-        }
-    }
+    DrawTarget t = gfx_target();
+    draw_fill_ellipse(&t, cx, cy, rx, ry, color);
 }
 
 // ---------- Triangle drawing ----------
@@ -378,37 +304,18 @@ static inline void gfx_draw_triangle(int x0, int y0, int x1, int y1, int x2, int
 
 static inline void swap_int(int* a, int* b) { int t = *a; *a = *b; *b = t; }
 
+// ---------- Polygon fill ----------
+// Convex or concave outline of num_points (x, y) pairs, nonzero winding
+static inline void gfx_fill_polygon(int* points, int num_points, Color color) {
+    DrawTarget t = gfx_target();
+    draw_fill_polygon(&t, points, num_points, color);
+}
+
 static inline void gfx_fill_triangle(int x0, int y0, int x1, int y1, int x2, int y2, Color color) {
-    if (y0 > y1) { swap_int(&x0, &x1); swap_int(&y0, &y1); }
-    if (y1 > y2) { swap_int(&x1, &x2); swap_int(&y1, &y2); }
-    if (y0 > y1) { swap_int(&x0, &x1); swap_int(&y0, &y1); }
-    
-    if (y0 == y2) return;
-    
-    for (int y = y0; y <= y2; y++) {
-        int xa, xb;
-        
-        if (y < y1) {
-            if (y1 == y0) continue;
-            xa = x0 + (x1 - x0) * (y - y0) / (y1 - y0);
-            xb = x0 + (x2 - x0) * (y - y0) / (y2 - y0);
-        } else {
-            if (y2 == y1) {
-                xa = x1;
-            } else {
-                xa = x1 + (x2 - x1) * (y - y1) / (y2 - y1);
-            }
-            xb = x0 + (x2 - x0) * (y - y0) / (y2 - y0);
-        }
-        
-        if (xa > xb) swap_int(&xa, &xb);
-        for (int x = xa; x <= xb; x++) {
-            gfx_put_pixel(x, y, color);
-        }
-    }
+    int points[6] = { x0, y0, x1, y1, x2, y2 };
+    gfx_fill_polygon(points, 3, color);
 }
 
-// ---------- Polygon drawing ----------
 static inline void gfx_draw_polygon(int* points, int num_points, Color color) {
     for (int i = 0; i < num_points; i++) {
         int next = (i + 1) % num_points;
@@ -417,69 +324,69 @@ static inline void gfx_draw_polygon(int* points, int num_points, Color color) {
 }
 
 // ---------- Arc and trigonometry ----------
+// Degrees in, 256 = 1.0 out (trig.h table, rounded)
 static inline int sin_approx(int angle) {
-    angle = angle % 360;
-    if (angle < 0) angle += 360;
-    
-    int quadrant = angle / 90;
-    int a = angle % 90;
-    int x = a * 256 / 90;
-    int y = (x * (512 - x)) / 256;
-    
-    switch (quadrant) {
-        case 0: return y;
-        case 1: return 256 - (y - 256);
-        case 2: return -y;
-        case 3: return -(256 - (y - 256));
-    }
-    return 0;
+    return (trig_sin(trig_from_degrees(angle)) + 128) >> 8;
 }
 
 static inline int cos_approx(int angle) {
     return sin_approx(angle + 90);
 }
 
+// Most points a tessellated arc or curve is drawn with
+#define GFX_CURVE_POINTS 128
+
+// Open outline of num_points (x, y) pairs
+static inline void gfx_draw_polyline(const int* points, int num_points, Color color) {
+    for (int i = 1; i < num_points; i++) {
+        gfx_draw_line(points[i*2-2], points[i*2-1], points[i*2], points[i*2+1], color);
+    }
+}
+
+// Counterclockwise from start_angle to end_angle (degrees), as a line strip
 static inline void gfx_draw_arc(int cx, int cy, int r, int start_angle, int end_angle, Color color) {
-    for (int a = start_angle; a <= end_angle; a++) {
-        int x = cx + (r * cos_approx(a)) / 256;
-        int y = cy - (r * sin_approx(a)) / 256;
-        gfx_put_pixel(x, y, color);
+    int points[GFX_CURVE_POINTS * 2];
+    int n = raster_arc_points(cx, cy, r, trig_from_degrees(start_angle), trig_from_degrees(end_angle),
+                              points, 0, GFX_CURVE_POINTS);
+    if (n == 1) gfx_put_pixel(points[0], points[1], color);
+    gfx_draw_polyline(points, n, color);
+}
+
+// Band between r_inner and r_outer over the same angles (a pie if
+// r_inner is 0), filled as one outline
+static inline void gfx_fill_arc(int cx, int cy, int r_outer, int r_inner, int start_angle, int end_angle, Color color) {
+    int points[RASTER_MAX_EDGES * 2];
+    int32_t a0 = trig_from_degrees(start_angle), a1 = trig_from_degrees(end_angle);
+    int n = raster_arc_points(cx, cy, r_outer, a0, a1, points, 0, RASTER_MAX_EDGES / 2);
+    if (r_inner > 0) {
+        // Inner edge runs back from a1 to a0: generate it, then reverse it
+        int first = n;
+        n = raster_arc_points(cx, cy, r_inner, a0, a1, points, n, RASTER_MAX_EDGES);
+        for (int i = first, j = n - 1; i < j; i++, j--) {
+            int tx = points[i * 2], ty = points[i * 2 + 1];
+            points[i * 2] = points[j * 2];
+            points[i * 2 + 1] = points[j * 2 + 1];
+            points[j * 2] = tx;
+            points[j * 2 + 1] = ty;
+        }
+    } else {
+        n = raster_push_point(points, n, RASTER_MAX_EDGES, cx, cy);
     }
+    gfx_fill_polygon(points, n, color);
 }
 
 // ---------- Bezier curve ----------
+// Subdivided until flat (raster.h), so short curves take few segments
 static inline void gfx_draw_bezier_quadratic(int x0, int y0, int x1, int y1, int x2, int y2, Color color) {
-    int prev_x = x0, prev_y = y0;
-    for (int t = 0; t <= 100; t += 2) {
-        int t2 = t * t;
-        int mt = 100 - t;
-        int mt2 = mt * mt;
-        
-        int x = (mt2 * x0 + 2 * mt * t * x1 + t2 * x2) / 10000;
-        int y = (mt2 * y0 + 2 * mt * t * y1 + t2 * y2) / 10000;
-        
-        gfx_draw_line(prev_x, prev_y, x, y, color);
-        prev_x = x;
-        prev_y = y;
-    }
+    int points[GFX_CURVE_POINTS * 2];
+    int n = raster_quadratic_points(x0, y0, x1, y1, x2, y2, points, GFX_CURVE_POINTS);
+    gfx_draw_polyline(points, n, color);
 }
 
 static inline void gfx_draw_bezier_cubic(int x0, int y0, int x1, int y1, int x2, int y2, int x3, int y3, Color color) {
-    int prev_x = x0, prev_y = y0;
-    for (int t = 0; t <= 100; t += 2) {
-        int t2 = t * t;
-        int t3 = t2 * t;
-        int mt = 100 - t;
-        int mt2 = mt * mt;
-        int mt3 = mt2 * mt;
-        
-        int x = (mt3 * x0 + 3 * mt2 * t * x1 + 3 * mt * t2 * x2 + t3 * x3) / 1000000;
-        int y = (mt3 * y0 + 3 * mt2 * t * y1 + 3 * mt * t2 * y2 + t3 * y3) / 1000000;
-        
-        gfx_draw_line(prev_x, prev_y, x, y, color);
-        prev_x = x;
-        prev_y = y;
-    }
+    int points[GFX_CURVE_POINTS * 2];
+    int n = raster_cubic_points(x0, y0, x1, y1, x2, y2, x3, y3, points, GFX_CURVE_POINTS);
+    gfx_draw_polyline(points, n, color);
 }
 
 // ---------- Star shape ----------
@@ -499,48 +406,124 @@ static inline void gfx_draw_star(int cx, int cy, int r_outer, int r_inner, int p
     }
 }
 
+// One outline of alternating outer and inner points; the concave notches
+// are handled by the rasterizer instead of a fan of triangles
 static inline void gfx_fill_star(int cx, int cy, int r_outer, int r_inner, int points, Color color) {
+    int outline[RASTER_MAX_EDGES * 2];
+    if (points < 2) return;
+    if (points * 2 > RASTER_MAX_EDGES) points = RASTER_MAX_EDGES / 2;
     int angle_step = 360 / (points * 2);
     
     for (int i = 0; i < points * 2; i++) {
-        int angle1 = i * angle_step;
-        int angle2 = (i + 1) * angle_step;
-        int r1 = (i % 2 == 0) ? r_outer : r_inner;
-        int r2 = ((i + 1) % 2 == 0) ? r_outer : r_inner;
-        
-        int x1 = cx + (r1 * cos_approx(angle1)) / 256;
-        int y1 = cy - (r1 * sin_approx(angle1)) / 256;
-        int x2 = cx + (r2 * cos_approx(angle2)) / 256;
-        int y2 = cy - (r2 * sin_approx(angle2)) / 256;
-        
-        gfx_fill_triangle(cx, cy, x1, y1, x2, y2, color);
+        int angle = i * angle_step;
+        int r = (i % 2 == 0) ? r_outer : r_inner;
+        outline[i * 2] = cx + (r * cos_approx(angle)) / 256;
+        outline[i * 2 + 1] = cy - (r * sin_approx(angle)) / 256;
+    }
+    gfx_fill_polygon(outline, points * 2, color);
+}
+
+// ---------- Rounded rectangle fill ----------
+// Each corner is a quarter arc of GFX_CORNER_STEPS segments
+#define GFX_CORNER_STEPS 8
+
+static inline void gfx_fill_rect_rounded(int x, int y, int w, int h, int r, Color color) {
+    if (w <= 0 || h <= 0) return;
+    if (r > w / 2) r = w / 2;
+    if (r > h / 2) r = h / 2;
+    if (r <= 0) { gfx_fill_rect(x, y, w, h, color); return; }
+    
+    // Corner centers clockwise from top-right, each sweeping 90 degrees
+    int cxs[4] = { x + w - r, x + r, x + r, x + w - r };
+    int cys[4] = { y + r, y + r, y + h - r, y + h - r };
+    int outline[4 * (GFX_CORNER_STEPS + 1) * 2];
+    int n = 0;
+    for (int c = 0; c < 4; c++) {
+        for (int i = 0; i <= GFX_CORNER_STEPS; i++) {
+            int angle = c * 90 + i * 90 / GFX_CORNER_STEPS;
+            outline[n * 2] = cxs[c] + (r * cos_approx(angle)) / 256;
+            outline[n * 2 + 1] = cys[c] - (r * sin_approx(angle)) / 256;
+            n++;
+        }
     }
+    gfx_fill_polygon(outline, n, color);
 }
 
 // ---------- Effects ----------
-static inline void gfx_draw_glow(int cx, int cy, int r, Color color, int intensity) {
-    for (int y = -r - intensity; y <= r + intensity; y++) {
-        for (int x = -r - intensity; x <= r + intensity; x++) {
-            int dist_sq = x * x + y * y;
-            int dist = 0;
-            for (int i = 1; i * i <= dist_sq; i++) dist = i;
+// Solid disc of radius r with a rim fading out over `intensity` pixels.
+// Each row is one solid span plus a rim on either side. Rim pixels look
+// their color up by integer distance from the center in a table built once
+// per call; the distance is tracked pixel to pixel, never re-derived. The
+// rims are blended premultiplied in 64-pixel chunks.
+#define GFX_GLOW_CHUNK 64
+#define GFX_GLOW_MAX   256     // Widest rim; larger intensities are clamped
+
+// Rim pixels [x0, x1] of row py, dy rows below or above the center.
+// lut[d - r] is the premultiplied color at distance d (r < d <= outer).
+static inline void gfx_glow_rim(int cx, int py, int dy, int x0, int x1, int r, const uint32_t* lut) {
+    if (cx + x0 < 0) x0 = -cx;
+    if (cx + x1 >= g_ctx.width) x1 = g_ctx.width - 1 - cx;
+    if (x0 > x1) return;
+    uint8_t* row = g_ctx.framebuffer + py * g_ctx.pitch;
+    uint32_t chunk[GFX_GLOW_CHUNK];
+    int dist_sq = x0 * x0 + dy * dy;
+    int d = (int)trig_isqrt(dist_sq);
+    
+    for (int xs = x0; xs <= x1; xs += GFX_GLOW_CHUNK) {
+        int n = x1 - xs + 1 < GFX_GLOW_CHUNK ? x1 - xs + 1 : GFX_GLOW_CHUNK;
+        for (int i = 0; i < n; i++) {
+            int x = xs + i;
+            // One pixel over moves the distance by at most one
+            while ((d + 1) * (d + 1) <= dist_sq) d++;
+            while (d * d > dist_sq) d--;
             
-            if (dist <= r) {
-                gfx_put_pixel(cx + x, cy + y, color);
-            } else if (dist <= r + intensity) {
-                int fade = 255 - ((dist - r) * 255 / intensity);
-                Color bg = gfx_get_pixel(cx + x, cy + y);
-                gfx_put_pixel(cx + x, cy + y, color_blend(color, bg, fade));
-            }
+            chunk[i] = lut[d - r];
+            dist_sq += 2 * x + 1;
+        }
+        g_ctx.ops->blend(row, cx + xs, chunk, n);
+    }
+}
+
+static inline void gfx_draw_glow(int cx, int cy, int r, Color color, int intensity) {
+    if (r < 0) return;
+    if (intensity < 0) intensity = 0;
+    if (intensity > GFX_GLOW_MAX) intensity = GFX_GLOW_MAX;
+    int outer = r + intensity;
+    
+    uint32_t lut[GFX_GLOW_MAX + 1];
+    for (int i = 1; i <= intensity; i++) {
+        uint32_t fade = 255 - i * 255 / intensity;
+        lut[i] = blend_premultiply((fade << 24) | (color & 0x00FFFFFF));
+    }
+    
+    // Half-widths of the solid disc (distance <= r) and of the whole glow
+    int64_t solid_sq = (int64_t)(r + 1) * (r + 1) - 1;
+    int64_t outer_sq = (int64_t)(outer + 1) * (outer + 1) - 1;
+    int32_t solid = r, edge = outer;
+    for (int dy = 0; dy <= outer; dy++) {
+        int64_t dy2 = (int64_t)dy * dy;
+        solid = raster_shrink(solid, 1, solid_sq - dy2);
+        edge = raster_shrink(edge, 1, outer_sq - dy2);
+        
+        for (int side = 0; side < (dy ? 2 : 1); side++) {
+            int py = side ? cy + dy : cy - dy;
+            if (py < 0 || py >= g_ctx.height) continue;
+            if (solid >= 0) gfx_fill_span(cx - solid, py, 2 * solid + 1, color);
+            if (intensity == 0) continue;
+            // Past the disc (solid == -1) the left rim owns the center column
+            gfx_glow_rim(cx, py, dy, -edge, -solid - 1, r, lut);
+            gfx_glow_rim(cx, py, dy, solid < 0 ? 1 : solid + 1, edge, r, lut);
         }
     }
 }
 
 static inline void gfx_fill_checkerboard(int x, int y, int w, int h, int size, Color c1, Color c2) {
     for (int dy = 0; dy < h; dy++) {
-        for (int dx = 0; dx < w; dx++) {
-            int check = ((dx / size) + (dy / size)) % 2;
-            gfx_put_pixel(x + dx, y + dy, check ? c1 : c2);
+        int check = (dy / size) % 2;
+        for (int dx = 0; dx < w; dx += size) {
+            int len = (w - dx < size) ? w - dx : size;
+            gfx_fill_span(x + dx, y + dy, len, check ? c1 : c2);
+            check ^= 1;
         }
     }
 }
@@ -0,0 +1,297 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include "types.h"
+#include "pci.h"
+#include "irq.h"
+
+// ============================================================================
+// PS/2 INPUT FOR MINI-OS
+// Keyboard (IRQ 1) and mouse (IRQ 12) on the 8042 controller. The handlers
+// decode scancodes and mouse packets and push InputEvents into a lock-free
+// single-producer / single-consumer ring; the render loop on the boot CPU
+// pops them. input_wait sleeps in hlt until an interrupt arrives, so a
+// screen with nothing happening costs no CPU time.
+// ============================================================================
+
+// 8042 controller ports, status bits and commands
+#define PS2_DATA            0x60
+#define PS2_STATUS          0x64        // Read
+#define PS2_COMMAND         0x64        // Write
+#define PS2_STATUS_OUTPUT   0x01        // Byte waiting at PS2_DATA
+#define PS2_STATUS_INPUT    0x02        // Controller still busy with our last byte
+#define PS2_STATUS_AUX      0x20        // Waiting byte came from the mouse
+#define PS2_CMD_READ_CONFIG   0x20
+#define PS2_CMD_WRITE_CONFIG  0x60
+#define PS2_CMD_DISABLE_AUX   0xA7
+#define PS2_CMD_ENABLE_AUX    0xA8
+#define PS2_CMD_DISABLE_KBD   0xAD
+#define PS2_CMD_ENABLE_KBD    0xAE
+#define PS2_CMD_WRITE_AUX     0xD4      // Next data byte goes to the mouse
+#define PS2_CONFIG_KBD_IRQ    0x01
+#define PS2_CONFIG_AUX_IRQ    0x02
+#define PS2_CONFIG_KBD_CLOCK  0x10      // 1 = clock disabled
+#define PS2_CONFIG_AUX_CLOCK  0x20
+#define PS2_CONFIG_TRANSLATE  0x40      // Keyboard arrives as scancode set 1
+#define PS2_TIMEOUT           100000
+
+// Mouse commands and replies
+#define MOUSE_SET_DEFAULTS  0xF6
+#define MOUSE_ENABLE_DATA   0xF4
+#define MOUSE_ACK           0xFA
+#define MOUSE_SYNC          0x08        // Always set in the first packet byte
+#define MOUSE_X_SIGN        0x10
+#define MOUSE_Y_SIGN        0x20
+#define MOUSE_OVERFLOW      0xC0
+
+// Scancode set 1
+#define KEY_RELEASE         0x80
+#define KEY_EXTENDED        0xE0
+#define KEY_LSHIFT          0x2A
+#define KEY_RSHIFT          0x36
+#define KEY_CAPSLOCK        0x3A
+
+// Ring entries (power of two); events past a full ring are dropped
+#define INPUT_QUEUE_SIZE    256
+
+typedef enum {
+    INPUT_KEY_DOWN = 1,
+    INPUT_KEY_UP,
+    INPUT_MOUSE,
+} InputType;
+
+#define INPUT_BUTTON_LEFT   0x01
+#define INPUT_BUTTON_RIGHT  0x02
+#define INPUT_BUTTON_MIDDLE 0x04
+
+typedef struct {
+    uint8_t  type;              // InputType
+    uint8_t  buttons;           // Mouse: INPUT_BUTTON_* held after this packet
+    char     ascii;             // Key: character with shift applied, or 0
+    uint8_t  _pad;
+    uint16_t key;               // Key: set 1 make code, 0xE0xx when extended
+    int16_t  dx, dy;            // Mouse: motion, y growing down the screen
+} InputEvent;
+
+// head and tail are free-running counters; only the IRQ side writes head
+typedef struct {
+    InputEvent events[INPUT_QUEUE_SIZE];
+    volatile uint32_t head;     // Next slot to fill (producer)
+    volatile uint32_t tail;     // Next slot to read (consumer)
+    volatile uint32_t dropped;
+} InputQueue;
+
+typedef struct {
+    InputQueue queue;
+    uint8_t  extended;          // Last byte was KEY_EXTENDED
+    uint8_t  shift;             // Bit 0 left, bit 1 right
+    uint8_t  caps;
+    uint8_t  packet[3];
+    uint8_t  packet_len;
+    uint8_t  mouse;             // Mouse answered its setup
+    uint8_t  ready;
+} InputState;
+
+static InputState g_input;
+
+// ---------- Event queue ----------
+// Producer: the keyboard and mouse handlers, with interrupts off
+static inline void input_push(const InputEvent* ev) {
+    InputQueue* q = &g_input.queue;
+    uint32_t head = q->head;
+    uint32_t tail = __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+    if (head - tail >= INPUT_QUEUE_SIZE) {
+        q->dropped++;
+        return;
+    }
+    q->events[head & (INPUT_QUEUE_SIZE - 1)] = *ev;
+    __atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+}
+
+static inline int input_pending(void) {
+    InputQueue* q = &g_input.queue;
+    return __atomic_load_n(&q->head, __ATOMIC_ACQUIRE) != q->tail;
+}
+
+// Consumer: returns 0 when the ring is empty
+static inline int input_poll(InputEvent* ev) {
+    InputQueue* q = &g_input.queue;
+    uint32_t tail = q->tail;
+    if (__atomic_load_n(&q->head, __ATOMIC_ACQUIRE) == tail) return 0;
+    *ev = q->events[tail & (INPUT_QUEUE_SIZE - 1)];
+    __atomic_store_n(&q->tail, tail + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+// Sleep until the next interrupt unless events are already waiting. sti
+// takes effect after the following instruction, so an IRQ cannot slip in
+// between the check and the hlt.
+static inline void input_wait(void) {
+    irq_disable();
+    if (input_pending()) {
+        irq_enable();
+        return;
+    }
+    __asm__ volatile ("sti\n\thlt" ::: "memory");
+}
+
+// ---------- Keyboard ----------
+static const char g_keymap[2][0x3A] = {
+    {
+        0, 27, '1', '2', '3', '4', '5', '6', '7', '8', '9', '0', '-', '=', '\b',
+        '\t', 'q', 'w', 'e', 'r', 't', 'y', 'u', 'i', 'o', 'p', '[', ']', '\n',
+        0, 'a', 's', 'd', 'f', 'g', 'h', 'j', 'k', 'l', ';', '\'', '`',
+        0, '\\', 'z', 'x', 'c', 'v', 'b', 'n', 'm', ',', '.', '/', 0,
+        '*', 0, ' ',
+    },
+    {
+        0, 27, '!', '@', '#', '$', '%', '^', '&', '*', '(', ')', '_', '+', '\b',
+        '\t', 'Q', 'W', 'E', 'R', 'T', 'Y', 'U', 'I', 'O', 'P', '{', '}', '\n',
+        0, 'A', 'S', 'D', 'F', 'G', 'H', 'J', 'K', 'L', ':', '"', '~',
+        0, '|', 'Z', 'X', 'C', 'V', 'B', 'N', 'M', '<', '>', '?', 0,
+        '*', 0, ' ',
+    },
+};
+
+static inline char input_key_ascii(uint8_t code) {
+    if (code >= sizeof(g_keymap[0])) return 0;
+    int shift = g_input.shift != 0;
+    char c = g_keymap[0][code];
+    if (g_input.caps && c >= 'a' && c <= 'z') shift = !shift;
+    return g_keymap[shift][code];
+}
+
+static inline void input_key_byte(uint8_t byte) {
+    if (byte == KEY_EXTENDED) {
+        g_input.extended = 1;
+        return;
+    }
+    uint8_t code = byte & ~KEY_RELEASE;
+    int down = !(byte & KEY_RELEASE);
+    int extended = g_input.extended;
+    g_input.extended = 0;
+
+    if (!extended && (code == KEY_LSHIFT || code == KEY_RSHIFT)) {
+        uint8_t bit = code == KEY_LSHIFT ? 1 : 2;
+        if (down) g_input.shift |= bit;
+        else g_input.shift &= ~bit;
+    }
+    if (!extended && code == KEY_CAPSLOCK && down) g_input.caps = !g_input.caps;
+
+    InputEvent ev = {0};
+    ev.type = down ? INPUT_KEY_DOWN : INPUT_KEY_UP;
+    ev.key = extended ? (KEY_EXTENDED << 8) | code : code;
+    ev.ascii = extended ? 0 : input_key_ascii(code);
+    input_push(&ev);
+}
+
+static void input_keyboard_irq(void) {
+    uint8_t status = inb(PS2_STATUS);
+    if (!(status & PS2_STATUS_OUTPUT) || (status & PS2_STATUS_AUX)) return;
+    input_key_byte(inb(PS2_DATA));
+}
+
+// ---------- Mouse ----------
+// Standard 3-byte packets: buttons and sign bits, then X and Y motion
+static inline void input_mouse_byte(uint8_t byte) {
+    // Resync on a first byte without its always-set bit
+    if (g_input.packet_len == 0 && !(byte & MOUSE_SYNC)) return;
+    g_input.packet[g_input.packet_len++] = byte;
+    if (g_input.packet_len < 3) return;
+    g_input.packet_len = 0;
+
+    uint8_t flags = g_input.packet[0];
+    if (flags & MOUSE_OVERFLOW) return;
+    int32_t dx = g_input.packet[1] - ((flags & MOUSE_X_SIGN) ? 256 : 0);
+    int32_t dy = g_input.packet[2] - ((flags & MOUSE_Y_SIGN) ? 256 : 0);
+
+    InputEvent ev = {0};
+    ev.type = INPUT_MOUSE;
+    ev.buttons = flags & (INPUT_BUTTON_LEFT | INPUT_BUTTON_RIGHT | INPUT_BUTTON_MIDDLE);
+    ev.dx = (int16_t)dx;
+    ev.dy = (int16_t)-dy;
+    input_push(&ev);
+}
+
+static void input_mouse_irq(void) {
+    uint8_t status = inb(PS2_STATUS);
+    if (!(status & PS2_STATUS_OUTPUT) || !(status & PS2_STATUS_AUX)) return;
+    input_mouse_byte(inb(PS2_DATA));
+}
+
+// ---------- Controller ----------
+static inline int ps2_wait_write(void) {
+    for (uint32_t i = 0; i < PS2_TIMEOUT; i++) {
+        if (!(inb(PS2_STATUS) & PS2_STATUS_INPUT)) return 0;
+        cpu_relax();
+    }
+    return -1;
+}
+
+static inline int ps2_wait_read(void) {
+    for (uint32_t i = 0; i < PS2_TIMEOUT; i++) {
+        if (inb(PS2_STATUS) & PS2_STATUS_OUTPUT) return 0;
+        cpu_relax();
+    }
+    return -1;
+}
+
+static inline void ps2_command(uint8_t cmd) {
+    ps2_wait_write();
+    outb(PS2_COMMAND, cmd);
+}
+
+static inline void ps2_write(uint8_t value) {
+    ps2_wait_write();
+    outb(PS2_DATA, value);
+}
+
+static inline int ps2_read(void) {
+    if (ps2_wait_read() != 0) return -1;
+    return inb(PS2_DATA);
+}
+
+static inline void ps2_flush(void) {
+    for (uint32_t i = 0; i < 16 && (inb(PS2_STATUS) & PS2_STATUS_OUTPUT); i++) inb(PS2_DATA);
+}
+
+static inline int ps2_mouse_command(uint8_t cmd) {
+    ps2_command(PS2_CMD_WRITE_AUX);
+    ps2_write(cmd);
+    return ps2_read() == MOUSE_ACK ? 0 : -1;
+}
+
+// ---------- Initialization ----------
+// Call after irq_init, with interrupts still off: the setup replies are
+// read by polling and must not reach the handlers
+static inline void input_init(void) {
+    if (g_input.ready) return;
+
+    ps2_command(PS2_CMD_DISABLE_KBD);
+    ps2_command(PS2_CMD_DISABLE_AUX);
+    ps2_flush();
+
+    ps2_command(PS2_CMD_READ_CONFIG);
+    int config = ps2_read();
+    if (config < 0) config = PS2_CONFIG_TRANSLATE;
+    config |= PS2_CONFIG_KBD_IRQ | PS2_CONFIG_AUX_IRQ | PS2_CONFIG_TRANSLATE;
+    config &= ~(PS2_CONFIG_KBD_CLOCK | PS2_CONFIG_AUX_CLOCK);
+    ps2_command(PS2_CMD_WRITE_CONFIG);
+    ps2_write((uint8_t)config);
+
+    ps2_command(PS2_CMD_ENABLE_KBD);
+    ps2_command(PS2_CMD_ENABLE_AUX);
+    g_input.mouse = ps2_mouse_command(MOUSE_SET_DEFAULTS) == 0 &&
+                    ps2_mouse_command(MOUSE_ENABLE_DATA) == 0;
+    ps2_flush();
+
+    irq_set_handler(IRQ_KEYBOARD, input_keyboard_irq);
+    if (g_input.mouse) irq_set_handler(IRQ_MOUSE, input_mouse_irq);
+    g_input.ready = 1;
+}
+
+static inline uint32_t input_get_dropped(void) {
+    return g_input.queue.dropped;
+}
+
+#endif // INPUT_H
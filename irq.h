@@ -0,0 +1,214 @@
+#ifndef IRQ_H
+#define IRQ_H
+
+#include "types.h"
+#include "cpu.h"
+#include "pci.h"
+#include "timer.h"
+#include "serial.h"
+
+// ============================================================================
+// INTERRUPTS FOR MINI-OS
+// IDT for the boot CPU, the two 8259 PICs remapped above the exceptions,
+// and a periodic PIT tick so idle loops can hlt. The entry stubs live in
+// kernel_entry.asm and call irq_dispatch through isr_dispatch. Handlers
+// run with interrupts off and must not nest. The APs load the same IDT
+// but only take the local APIC wake IPI (smp.h).
+// ============================================================================
+
+#define IDT_ENTRIES         256
+#define IDT_STUBS           64          // Exceptions 0-31, IRQs 0-15, local APIC 48-63
+#define IDT_GATE_INT32      0x8E        // Present, ring 0, 32-bit interrupt gate
+
+// 8259 PIC ports and commands
+#define PIC1_COMMAND        0x20
+#define PIC1_DATA           0x21
+#define PIC2_COMMAND        0xA0
+#define PIC2_DATA           0xA1
+#define PIC_EOI             0x20
+#define PIC_READ_ISR        0x0B
+#define PIC_ICW1_INIT       0x11        // Edge triggered, cascade, ICW4 follows
+#define PIC_ICW4_8086       0x01
+
+#define IRQ_BASE            0x20        // Vector of IRQ 0
+#define IRQ_COUNT           16
+#define IRQ_TIMER           0
+#define IRQ_KEYBOARD        1
+#define IRQ_CASCADE         2
+#define IRQ_MOUSE           12
+
+// Local APIC vectors (above the PIC's)
+#define IRQ_WAKE            0x30        // IPI that wakes a halted AP
+#define IRQ_APIC_SPURIOUS   0x3F        // Low four bits must be set on P6
+
+// PIT channel 0 drives IRQ 0 (channel 2 is timer.h's calibration gate)
+#define PIT_CHANNEL0        0x40
+#define PIT_MODE_RATE       0x34        // Channel 0, lo/hi byte, mode 2
+#define IRQ_TICK_HZ         1000        // Wakeups per second from hlt
+
+typedef void (*IrqFn)(void);
+
+typedef struct __attribute__((packed)) {
+    uint16_t offset_low;
+    uint16_t selector;
+    uint8_t  zero;
+    uint8_t  type;
+    uint16_t offset_high;
+} IDTGate;
+
+typedef struct {
+    IrqFn    handlers[IRQ_COUNT];
+    IrqFn    wake;                      // IRQ_WAKE; sends the local APIC EOI
+    volatile uint32_t ticks;            // IRQ 0 count
+    volatile uint32_t spurious;
+    uint16_t mask;                      // 1 = masked, both PICs
+    uint8_t  ready;
+} IRQState;
+
+static IDTGate g_idt[IDT_ENTRIES] __attribute__((aligned(8)));
+static IRQState g_irq;
+
+// Entry stubs and the dispatch pointer they call (kernel_entry.asm)
+extern const uint32_t isr_stub_table[IDT_STUBS];
+extern void (*isr_dispatch)(uint32_t vector, uint32_t error);
+
+// ---------- CPU flag ----------
+static inline void irq_enable(void) {
+    __asm__ volatile ("sti" ::: "memory");
+}
+
+static inline void irq_disable(void) {
+    __asm__ volatile ("cli" ::: "memory");
+}
+
+// ---------- PIC ----------
+static inline void pic_write_mask(uint16_t mask) {
+    outb(PIC1_DATA, mask & 0xFF);
+    outb(PIC2_DATA, mask >> 8);
+}
+
+// ICW1-4: master at IRQ_BASE, slave at IRQ_BASE + 8 on IRQ 2; all masked
+static inline void pic_remap(void) {
+    outb(PIC1_COMMAND, PIC_ICW1_INIT);
+    outb(PIC2_COMMAND, PIC_ICW1_INIT);
+    outb(PIC1_DATA, IRQ_BASE);
+    outb(PIC2_DATA, IRQ_BASE + 8);
+    outb(PIC1_DATA, 1 << IRQ_CASCADE);
+    outb(PIC2_DATA, 2);
+    outb(PIC1_DATA, PIC_ICW4_8086);
+    outb(PIC2_DATA, PIC_ICW4_8086);
+    g_irq.mask = 0xFFFF & ~(1u << IRQ_CASCADE);
+    pic_write_mask(g_irq.mask);
+}
+
+static inline void pic_eoi(uint32_t irq) {
+    if (irq >= 8) outb(PIC2_COMMAND, PIC_EOI);
+    outb(PIC1_COMMAND, PIC_EOI);
+}
+
+// IRQ 7 / 15 with no in-service bit is a glitch the PIC reports anyway
+static inline int pic_is_spurious(uint32_t irq) {
+    if (irq != 7 && irq != 15) return 0;
+    uint16_t port = irq == 7 ? PIC1_COMMAND : PIC2_COMMAND;
+    outb(port, PIC_READ_ISR);
+    if (inb(port) & 0x80) return 0;
+    if (irq == 15) outb(PIC1_COMMAND, PIC_EOI);     // The master did see the cascade
+    return 1;
+}
+
+// ---------- Dispatch ----------
+// Exceptions are fatal: report on COM1 and stop this CPU
+static inline void irq_exception(uint32_t vector, uint32_t error) {
+    serial_write("EXCEPTION ");
+    serial_write_uint(vector);
+    serial_write(" error ");
+    serial_write_uint(error);
+    serial_write("\n");
+    for (;;) __asm__ volatile ("cli; hlt");
+}
+
+static void irq_dispatch(uint32_t vector, uint32_t error) {
+    if (vector < IRQ_BASE) irq_exception(vector, error);
+    if (vector == IRQ_WAKE) {
+        if (g_irq.wake) g_irq.wake();
+        return;
+    }
+    if (vector == IRQ_APIC_SPURIOUS) return;    // No EOI for these
+
+    uint32_t irq = vector - IRQ_BASE;
+    if (irq >= IRQ_COUNT) return;
+    if (pic_is_spurious(irq)) {
+        g_irq.spurious++;
+        return;
+    }
+    if (g_irq.handlers[irq]) g_irq.handlers[irq]();
+    pic_eoi(irq);
+}
+
+// ---------- Handlers ----------
+// Install `fn` and unmask the line (0 masks it again)
+static inline void irq_set_handler(uint32_t irq, IrqFn fn) {
+    if (irq >= IRQ_COUNT) return;
+    int on = cpu_interrupts_enabled();
+    irq_disable();
+    g_irq.handlers[irq] = fn;
+    if (fn) g_irq.mask &= ~(1u << irq);
+    else g_irq.mask |= 1u << irq;
+    if (irq >= 8 && fn) g_irq.mask &= ~(1u << IRQ_CASCADE);
+    pic_write_mask(g_irq.mask);
+    if (on) irq_enable();
+}
+
+static void irq_tick(void) {
+    g_irq.ticks++;
+}
+
+static inline void irq_start_tick(uint32_t hz) {
+    uint32_t divisor = PIT_FREQUENCY / hz;
+    if (divisor > 0xFFFF) divisor = 0xFFFF;
+    if (divisor < 1) divisor = 1;
+    outb(PIT_COMMAND, PIT_MODE_RATE);
+    outb(PIT_CHANNEL0, divisor & 0xFF);
+    outb(PIT_CHANNEL0, divisor >> 8);
+    irq_set_handler(IRQ_TIMER, irq_tick);
+}
+
+static inline uint32_t irq_get_ticks(void) {
+    return g_irq.ticks;
+}
+
+static inline void irq_set_wake_handler(IrqFn fn) {
+    g_irq.wake = fn;
+}
+
+// ---------- Initialization ----------
+// Point this CPU at g_idt. The APs load it before irq_init has filled the
+// gates, so they keep interrupts off until then.
+static inline void irq_load_idt(void) {
+    struct __attribute__((packed)) { uint16_t limit; uint32_t base; } desc = {
+        sizeof(g_idt) - 1, (uint32_t)(uintptr_t)g_idt
+    };
+    __asm__ volatile ("lidt %0" : : "m"(desc));
+}
+
+// Boot CPU only. Interrupts stay off until irq_enable().
+static inline void irq_init(void) {
+    if (g_irq.ready) return;
+
+    for (uint32_t i = 0; i < IDT_STUBS; i++) {
+        uint32_t addr = isr_stub_table[i];
+        g_idt[i].offset_low = addr & 0xFFFF;
+        g_idt[i].selector = GDT_CODE;
+        g_idt[i].zero = 0;
+        g_idt[i].type = IDT_GATE_INT32;
+        g_idt[i].offset_high = addr >> 16;
+    }
+    irq_load_idt();
+
+    isr_dispatch = irq_dispatch;
+    pic_remap();
+    irq_start_tick(IRQ_TICK_HZ);
+    g_irq.ready = 1;
+}
+
+#endif // IRQ_H
@@ -0,0 +1,223 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include "types.h"
+#include "cpu.h"
+#include "pmm.h"
+
+// ============================================================================
+// JOB SYSTEM FOR MINI-OS
+// Work stealing over one Chase-Lev deque per CPU: the owner pushes and pops
+// at the bottom, idle CPUs steal from the top. jobs_parallel_for splits a
+// loop into one job per index; the caller works on it too and returns once
+// every index has run. With no worker CPUs it is a plain loop. Workers
+// that find nothing to do for a while halt and are woken through the
+// hook smp.h installs with jobs_set_wake.
+// ============================================================================
+
+// Jobs per deque (power of two); a full deque runs the rest inline
+#define JOB_DEQUE_SIZE      1024
+
+// Empty polls before an idle worker halts
+#define JOB_IDLE_SPINS      4096
+
+typedef void (*JobFn)(void* arg, uint32_t index);
+typedef void (*JobWakeFn)(void);
+
+typedef struct {
+    volatile uint32_t remaining;
+} JobBatch;
+
+typedef struct {
+    JobFn fn;
+    void* arg;
+    uint32_t index;
+    JobBatch* batch;
+} Job;
+
+// top and bottom are free-running counters; compare by signed difference
+typedef struct __attribute__((aligned(64))) {
+    volatile uint32_t top;      // Next job to steal (thieves CAS it forward)
+    volatile uint32_t bottom;   // Next free slot (owner only)
+    Job* jobs;
+} JobDeque;
+
+typedef struct {
+    JobDeque deques[CPU_MAX];
+    volatile uint32_t workers;  // CPUs other than the BSP in jobs_worker
+    volatile uint32_t sleeping; // Bit per CPU index halted in jobs_sleep
+    JobWakeFn wake;             // Interrupts every halted worker; 0 = workers spin
+    uint32_t cpu_count;         // Deques in use
+    uint8_t  ready;
+} JobSystem;
+
+static JobSystem g_jobs;
+
+// ---------- Deque ----------
+static inline int job_push(JobDeque* q, const Job* job) {
+    uint32_t b = q->bottom;
+    uint32_t t = __atomic_load_n(&q->top, __ATOMIC_ACQUIRE);
+    if ((int32_t)(b - t) >= JOB_DEQUE_SIZE) return 0;
+    q->jobs[b & (JOB_DEQUE_SIZE - 1)] = *job;
+    __atomic_store_n(&q->bottom, b + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+static inline int job_pop(JobDeque* q, Job* out) {
+    uint32_t b = q->bottom - 1;
+    __atomic_store_n(&q->bottom, b, __ATOMIC_RELAXED);
+    // The bottom store must be visible before top is read (store-load order)
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    uint32_t t = __atomic_load_n(&q->top, __ATOMIC_RELAXED);
+
+    if ((int32_t)(b - t) < 0) {
+        __atomic_store_n(&q->bottom, b + 1, __ATOMIC_RELAXED);
+        return 0;
+    }
+    *out = q->jobs[b & (JOB_DEQUE_SIZE - 1)];
+    if (b != t) return 1;
+
+    // Last job: race the thieves for it
+    int won = __atomic_compare_exchange_n(&q->top, &t, t + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+    __atomic_store_n(&q->bottom, b + 1, __ATOMIC_RELAXED);
+    return won;
+}
+
+static inline int job_steal(JobDeque* q, Job* out) {
+    uint32_t t = __atomic_load_n(&q->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    uint32_t b = __atomic_load_n(&q->bottom, __ATOMIC_ACQUIRE);
+    if ((int32_t)(b - t) <= 0) return 0;
+
+    Job job = q->jobs[t & (JOB_DEQUE_SIZE - 1)];
+    if (!__atomic_compare_exchange_n(&q->top, &t, t + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) return 0;
+    *out = job;
+    return 1;
+}
+
+// ---------- Running jobs ----------
+static inline void job_run(const Job* job) {
+    job->fn(job->arg, job->index);
+    __atomic_sub_fetch(&job->batch->remaining, 1, __ATOMIC_RELEASE);
+}
+
+// Run one job from this CPU's deque, or else one stolen from another CPU
+static inline int jobs_run_one(void) {
+    uint32_t self = cpu_index();
+    Job job;
+    if (job_pop(&g_jobs.deques[self], &job)) {
+        job_run(&job);
+        return 1;
+    }
+    for (uint32_t i = 1; i < g_jobs.cpu_count; i++) {
+        uint32_t victim = self + i;
+        if (victim >= g_jobs.cpu_count) victim -= g_jobs.cpu_count;
+        if (job_steal(&g_jobs.deques[victim], &job)) {
+            job_run(&job);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// ---------- Idle workers ----------
+static inline int jobs_pending(void) {
+    for (uint32_t i = 0; i < g_jobs.cpu_count; i++) {
+        JobDeque* q = &g_jobs.deques[i];
+        uint32_t t = __atomic_load_n(&q->top, __ATOMIC_ACQUIRE);
+        uint32_t b = __atomic_load_n(&q->bottom, __ATOMIC_ACQUIRE);
+        if ((int32_t)(b - t) > 0) return 1;
+    }
+    return 0;
+}
+
+// Halt until the wake interrupt. The sleeping bit is set before the deques
+// are checked and jobs_wake reads it after pushing, so one of the two sees
+// the other. A wake sent in between stays pending and ends the hlt at once
+// (sti takes effect only after the hlt has started).
+static inline void jobs_sleep(void) {
+    uint32_t bit = 1u << cpu_index();
+    __asm__ volatile ("cli" ::: "memory");
+    __atomic_or_fetch(&g_jobs.sleeping, bit, __ATOMIC_SEQ_CST);
+    if (!jobs_pending()) __asm__ volatile ("sti; hlt; cli" ::: "memory");
+    __atomic_and_fetch(&g_jobs.sleeping, ~bit, __ATOMIC_RELAXED);
+}
+
+// After pushing jobs: interrupt the workers that are halted
+static inline void jobs_wake(void) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (!__atomic_load_n(&g_jobs.sleeping, __ATOMIC_RELAXED)) return;
+    JobWakeFn wake = __atomic_load_n(&g_jobs.wake, __ATOMIC_ACQUIRE);
+    if (wake) wake();
+}
+
+// Workers halt when idle once `fn` is set. It must reach every halted
+// worker, and their IDT must take the interrupt it sends.
+static inline void jobs_set_wake(JobWakeFn fn) {
+    __atomic_store_n(&g_jobs.wake, fn, __ATOMIC_RELEASE);
+}
+
+// Loop of a worker CPU, interrupts off; never returns. Spins for a while
+// after the last job, so back-to-back batches find it awake, then halts.
+static inline void jobs_worker(void) {
+    __atomic_add_fetch(&g_jobs.workers, 1, __ATOMIC_RELEASE);
+    uint32_t idle = 0;
+    for (;;) {
+        if (jobs_run_one()) {
+            idle = 0;
+        } else if (++idle < JOB_IDLE_SPINS || !__atomic_load_n(&g_jobs.wake, __ATOMIC_ACQUIRE)) {
+            cpu_relax();
+        } else {
+            jobs_sleep();
+            idle = 0;
+        }
+    }
+}
+
+// Call fn(arg, i) for every i in [0, count), spread over all CPUs
+static inline void jobs_parallel_for(JobFn fn, void* arg, uint32_t count) {
+    if (!g_jobs.ready || g_jobs.workers == 0 || count < 2) {
+        for (uint32_t i = 0; i < count; i++) fn(arg, i);
+        return;
+    }
+
+    JobBatch batch = { count };
+    JobDeque* q = &g_jobs.deques[cpu_index()];
+
+    // Low indices end up at the bottom (run here first), high ones are stolen
+    for (uint32_t i = count; i-- > 0;) {
+        Job job = { fn, arg, i, &batch };
+        if (!job_push(q, &job)) job_run(&job);
+    }
+    jobs_wake();
+
+    while (__atomic_load_n(&batch.remaining, __ATOMIC_ACQUIRE)) {
+        if (!jobs_run_one()) cpu_relax();
+    }
+}
+
+static inline uint32_t jobs_get_worker_count(void) {
+    return g_jobs.workers;
+}
+
+// ---------- Initialization ----------
+// Deques for `cpu_count` CPUs; call before any worker starts
+static inline int jobs_init(uint32_t cpu_count) {
+    if (g_jobs.ready) return 0;
+    if (cpu_count > CPU_MAX) cpu_count = CPU_MAX;
+
+    for (uint32_t i = 0; i < cpu_count; i++) {
+        JobDeque* q = &g_jobs.deques[i];
+        q->jobs = (Job*)pmm_alloc(JOB_DEQUE_SIZE * sizeof(Job), PMM_PAGE_SIZE);
+        if (!q->jobs) return -1;
+        q->top = 0;
+        q->bottom = 0;
+    }
+    g_jobs.cpu_count = cpu_count;
+    g_jobs.workers = 0;
+    g_jobs.sleeping = 0;
+    g_jobs.ready = 1;
+    return 0;
+}
+
+#endif // JOBS_H
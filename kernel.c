@@ -2,17 +2,28 @@
 #include "types.h"
 #include "graphics.h"
 #include "font.h"
+#include "paging.h"
+#include "smp.h"
+#include "display.h"
+#include "irq.h"
+#include "input.h"
+#include "asset.h"
 
-void kmain(void) {
-    struct BootInfo* info = BOOTINFO;
-    
-    // Safety check
-    if (info->fb_addr == 0 || info->fb_width == 0) {
-        for (;;) __asm__ volatile ("hlt");
-    }
-    
-    // Initialize graphics
-    gfx_init();
+#ifdef BENCHMARK
+#include "bench.h"
+#endif
+
+// Point graphics.h at a 32 bpp layer so drawing goes through the compositor
+static void kmain_target_layer(const Layer* layer) {
+    g_ctx.framebuffer = (uint8_t*)layer->buffer;
+    g_ctx.width = layer->width;
+    g_ctx.height = layer->height;
+    g_ctx.pitch = layer->width * 4;
+    g_ctx.bpp = 32;
+    g_ctx.ops = span_select(32);
+}
+
+static void kmain_draw_screen(struct BootInfo* info) {
     gfx_clear(COLOR_DARK_BG);
     
     // Draw title
@@ -45,11 +56,99 @@ void kmain(void) {
     font_draw_int(110, 300, info->fb_bpp, COLOR_WHITE, 1);
     
     // Success message
-    font_draw_string_centered(info->fb_width / 2, info->fb_height - 50,
+    font_draw_string_centered(g_ctx.width / 2, g_ctx.height - 50,
                               "Graphics Working! Press any key to continue...", COLOR_NEON_GREEN, 2);
+}
+
+// Last key and mouse state along the bottom of the background layer
+#define STATUS_HEIGHT (FONT_HEIGHT + 8)
+
+static void kmain_draw_status(char key, uint8_t buttons) {
+    int y = g_ctx.height - STATUS_HEIGHT;
+    gfx_fill_rect(0, y, g_ctx.width, STATUS_HEIGHT, COLOR_DARK_BG);
+    y += 4;
+    
+    font_draw_string(20, y, "Key:", COLOR_GRAY, 1);
+    font_draw_char(60, y, key, COLOR_WHITE, 1);
+    font_draw_string(100, y, "Mouse:", COLOR_GRAY, 1);
+    font_draw_int(156, y, g_display.cursor_x, COLOR_WHITE, 1);
+    font_draw_int(204, y, g_display.cursor_y, COLOR_WHITE, 1);
+    font_draw_string(260, y, "Buttons:", COLOR_GRAY, 1);
+    font_draw_char(332, y, (buttons & INPUT_BUTTON_LEFT) ? 'L' : '-', COLOR_NEON_GREEN, 1);
+    font_draw_char(340, y, (buttons & INPUT_BUTTON_MIDDLE) ? 'M' : '-', COLOR_NEON_GREEN, 1);
+    font_draw_char(348, y, (buttons & INPUT_BUTTON_RIGHT) ? 'R' : '-', COLOR_NEON_GREEN, 1);
+    display_layer_make_opaque(LAYER_BACKGROUND, 0, g_ctx.height - STATUS_HEIGHT, g_ctx.width, STATUS_HEIGHT);
+}
+
+void kmain(void) {
+#ifdef BENCHMARK
+    bench_main();
+#endif
+    
+    struct BootInfo* info = BOOTINFO;
+    
+    // Safety check
+    if (info->fb_addr == 0 || info->fb_width == 0) {
+        for (;;) __asm__ volatile ("hlt");
+    }
+    
+    // Identity paging: RAM write-back, framebuffer write-combining
+    paging_init();
+    
+    // Start the other CPUs; they wait for tile jobs
+    smp_init();
+    
+    // Initialize graphics
+    gfx_init();
+    if (display_init() != 0) {
+        // No compositor: draw straight to the framebuffer and stop
+        kmain_draw_screen(info);
+        for (;;) __asm__ volatile ("hlt");
+    }
+    
+    // Test screen in the background layer, cursor on top
+    kmain_target_layer(display_get_layer(LAYER_BACKGROUND));
+    kmain_draw_screen(info);
+    display_layer_make_opaque(LAYER_BACKGROUND, 0, 0, g_ctx.width, g_ctx.height);
+    display_create_default_cursor();
+    display_set_cursor_position(g_display.cursor_x, g_display.cursor_y);
+    display_set_cursor_visible(1);
+    
+    char key = ' ';
+    uint8_t buttons = 0;
+    kmain_draw_status(key, buttons);
+    display_end_frame();
+    
+    // Keyboard and mouse interrupts; the timer tick wakes frame pacing and
+    // the other CPUs halt until tile jobs arrive
+    irq_init();
+    input_init();
+    smp_enable_wake();
+    irq_enable();
     
-    // Halt
+    // Sleep until input arrives, then draw one frame for everything queued
     for (;;) {
-        __asm__ volatile ("hlt");
+        input_wait();
+        
+        InputEvent ev;
+        int32_t dx = 0, dy = 0;
+        int changed = 0;
+        while (input_poll(&ev)) {
+            if (ev.type == INPUT_MOUSE) {
+                dx += ev.dx;
+                dy += ev.dy;
+                buttons = ev.buttons;
+                changed = 1;
+            } else if (ev.type == INPUT_KEY_DOWN && ev.ascii >= ' ') {
+                key = ev.ascii;
+                changed = 1;
+            }
+        }
+        if (!changed) continue;
+        
+        display_begin_frame();
+        display_move_cursor(dx, dy);
+        kmain_draw_status(key, buttons);
+        display_end_frame();
     }
 }
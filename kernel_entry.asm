@@ -3,9 +3,45 @@ BITS 32
 
 global kernel_entry
 extern kmain
+extern __image_size
+extern __bss_start
+extern __bss_end
 
+; Image header, first in the flat binary (kernel.ld). stage2.asm checks the
+; magic and loads __image_size bytes; the jump keeps 0x10000 the entry point.
+section .text.header progbits alloc exec nowrite align=8
+kernel_header:
+    jmp kernel_entry
+    align 8, db 0
+    dd 'KRNL'                   ; +8 magic (KHDR_MAGIC in stage2.asm)
+    dd __image_size             ; +12 bytes to load
+
+section .text
 kernel_entry:
     ; Bootloader already set up segments and stack
+
+    ; Only the image is loaded: clear .bss before any C code reads it
+    cld
+    xor eax, eax
+    mov edi, __bss_start
+    mov ecx, __bss_end
+    sub ecx, edi
+    shr ecx, 2
+    rep stosd
+
+    ; Enable SSE before any C code runs (the compiler and memops.h emit it)
+    mov eax, 1
+    cpuid
+    test edx, 1 << 25           ; CPUID.1:EDX.SSE
+    jz .no_sse
+    mov eax, cr0
+    and eax, ~(1 << 2)          ; clear CR0.EM
+    or eax, 1 << 1              ; set CR0.MP
+    mov cr0, eax
+    mov eax, cr4
+    or eax, (1 << 9) | (1 << 10) ; CR4.OSFXSR | CR4.OSXMMEXCPT
+    mov cr4, eax
+.no_sse:
     call kmain
 
 .hang:
@@ -13,3 +49,124 @@ kernel_entry:
     hlt
     jmp .hang
 
+; ---------------------------------------------------------------------------
+; AP startup trampoline. smp.h copies [ap_trampoline, ap_trampoline_end) to
+; TRAMP_BASE and fills in the parameter block at its end before each SIPI.
+; An AP starts here in real mode at TRAMP_BASE >> 4 : 0.
+; ---------------------------------------------------------------------------
+TRAMP_BASE equ 0x7000           ; SMP_TRAMPOLINE in smp.h
+%define TRAMP(x) (TRAMP_BASE + ((x) - ap_trampoline))
+
+global ap_trampoline
+global ap_trampoline_end
+
+BITS 16
+ap_trampoline:
+    cli
+    cld
+    xor ax, ax
+    mov ds, ax
+    o32 lgdt [TRAMP(ap_gdt_limit)]
+    mov eax, cr0
+    or al, 1
+    mov cr0, eax
+    jmp dword 0x08:TRAMP(ap_pm)
+
+BITS 32
+ap_pm:
+    mov ax, 0x10
+    mov ds, ax
+    mov es, ax
+    mov ss, ax
+    mov gs, ax
+    mov ax, [TRAMP(ap_fs)]
+    mov fs, ax                  ; Per-CPU selector (cpu_index)
+    mov esp, [TRAMP(ap_stack)]
+
+    ; Same SSE setup as the BSP
+    fninit
+    mov eax, 1
+    cpuid
+    test edx, 1 << 25
+    jz .no_sse
+    mov eax, cr0
+    and eax, ~(1 << 2)
+    or eax, 1 << 1
+    mov cr0, eax
+    mov eax, cr4
+    or eax, (1 << 9) | (1 << 10)
+    mov cr4, eax
+.no_sse:
+    call [TRAMP(ap_entry)]
+
+.hang:
+    cli
+    hlt
+    jmp .hang
+
+; Parameter block: SMPTrampolineParams, must stay last
+ap_gdt_limit: dw 0
+ap_gdt_base:  dd 0
+ap_fs:        dw 0
+ap_stack:     dd 0
+ap_entry:     dd 0
+ap_trampoline_end:
+
+; ---------------------------------------------------------------------------
+; Interrupt entry stubs. irq.h points IDT vectors 0-63 at isr_stub_table and
+; sets isr_dispatch; each stub pushes an error code (0 when the CPU pushes
+; none) and its vector, then isr_common calls isr_dispatch(vector, error).
+; ---------------------------------------------------------------------------
+global isr_stub_table
+global isr_dispatch
+
+section .data
+align 4
+isr_dispatch: dd 0              ; void (*)(uint32_t vector, uint32_t error)
+
+section .text
+; Exceptions 8, 10-14, 17, 21, 29 and 30 push an error code themselves
+%assign v 0
+%rep 64
+isr_ %+ v:
+%if !(v == 8 || (v >= 10 && v <= 14) || v == 17 || v == 21 || v == 29 || v == 30)
+    push dword 0
+%endif
+    push dword v
+    jmp isr_common
+%assign v v + 1
+%endrep
+
+; Handlers are plain C and may touch SSE registers: keep the interrupted
+; code's state in an FXSAVE area on the stack
+isr_common:
+    pushad
+    cld
+    mov eax, [isr_dispatch]
+    test eax, eax
+    jz .done
+    mov ebx, [esp + 32]         ; Vector (above the 32 bytes of pushad)
+    mov ecx, [esp + 36]         ; Error code
+    mov ebp, esp
+    sub esp, 512
+    and esp, -16
+    fxsave [esp]
+    push ecx
+    push ebx
+    call eax
+    add esp, 8
+    fxrstor [esp]
+    mov esp, ebp
+.done:
+    popad
+    add esp, 8                  ; Vector and error code
+    iretd
+
+section .rodata
+align 4
+isr_stub_table:
+%assign v 0
+%rep 64
+    dd isr_ %+ v
+%assign v v + 1
+%endrep
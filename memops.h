@@ -0,0 +1,298 @@
+#ifndef MEMOPS_H
+#define MEMOPS_H
+
+#include <stdint.h>
+#include "cpu.h"
+
+// ============================================================================
+// MEMORY KERNELS FOR MINI-OS
+// Wide 32-bit fills and copies, picked once from CPUID:
+//   AVX (32-byte stores) > SSE2 (16-byte stores) > rep stosd/movsd
+// The stream_* variants use non-temporal stores and are meant for writes
+// into the write-combining framebuffer, which is never read back.
+// ============================================================================
+
+typedef void (*MemSet32Fn)(uint32_t* dst, uint32_t val, uint32_t count);
+typedef void (*MemCopy32Fn)(uint32_t* dst, const uint32_t* src, uint32_t count);
+
+typedef struct {
+    MemSet32Fn  set32;          // Cached stores (back buffer, layers)
+    MemCopy32Fn copy32;
+    MemSet32Fn  stream_set32;   // Non-temporal stores (VRAM)
+    MemCopy32Fn stream_copy32;
+    const char* name;
+} MemOps;
+
+// ---------- rep stosd / movsd (baseline) ----------
+static inline void mem_set32_rep(uint32_t* dst, uint32_t val, uint32_t count) {
+    __asm__ volatile ("rep stosl" : "+D"(dst), "+c"(count) : "a"(val) : "memory");
+}
+
+static inline void mem_copy32_rep(uint32_t* dst, const uint32_t* src, uint32_t count) {
+    __asm__ volatile ("rep movsl" : "+D"(dst), "+S"(src), "+c"(count) : : "memory");
+}
+
+// ---------- SSE2 (64 bytes per iteration) ----------
+__attribute__((target("sse2")))
+static void mem_set32_sse2(uint32_t* dst, uint32_t val, uint32_t count) {
+    while (count && ((uintptr_t)dst & 15)) { *dst++ = val; count--; }
+    uint32_t blocks = count / 16;
+    if (blocks) {
+        __asm__ volatile (
+            "movd %[v], %%xmm0\n\t"
+            "pshufd $0, %%xmm0, %%xmm0\n\t"
+            "1:\n\t"
+            "movdqa %%xmm0, (%[d])\n\t"
+            "movdqa %%xmm0, 16(%[d])\n\t"
+            "movdqa %%xmm0, 32(%[d])\n\t"
+            "movdqa %%xmm0, 48(%[d])\n\t"
+            "add $64, %[d]\n\t"
+            "dec %[n]\n\t"
+            "jnz 1b\n\t"
+            : [d]"+r"(dst), [n]"+r"(blocks) : [v]"r"(val) : "xmm0", "memory");
+    }
+    count &= 15;
+    while (count--) *dst++ = val;
+}
+
+__attribute__((target("sse2")))
+static void mem_stream_set32_sse2(uint32_t* dst, uint32_t val, uint32_t count) {
+    while (count && ((uintptr_t)dst & 15)) { *dst++ = val; count--; }
+    uint32_t blocks = count / 16;
+    if (blocks) {
+        __asm__ volatile (
+            "movd %[v], %%xmm0\n\t"
+            "pshufd $0, %%xmm0, %%xmm0\n\t"
+            "1:\n\t"
+            "movntdq %%xmm0, (%[d])\n\t"
+            "movntdq %%xmm0, 16(%[d])\n\t"
+            "movntdq %%xmm0, 32(%[d])\n\t"
+            "movntdq %%xmm0, 48(%[d])\n\t"
+            "add $64, %[d]\n\t"
+            "dec %[n]\n\t"
+            "jnz 1b\n\t"
+            "sfence\n\t"
+            : [d]"+r"(dst), [n]"+r"(blocks) : [v]"r"(val) : "xmm0", "memory");
+    }
+    count &= 15;
+    while (count--) *dst++ = val;
+}
+
+__attribute__((target("sse2")))
+static void mem_copy32_sse2(uint32_t* dst, const uint32_t* src, uint32_t count) {
+    while (count && ((uintptr_t)dst & 15)) { *dst++ = *src++; count--; }
+    uint32_t blocks = count / 16;
+    if (blocks) {
+        __asm__ volatile (
+            "1:\n\t"
+            "movdqu (%[s]), %%xmm0\n\t"
+            "movdqu 16(%[s]), %%xmm1\n\t"
+            "movdqu 32(%[s]), %%xmm2\n\t"
+            "movdqu 48(%[s]), %%xmm3\n\t"
+            "movdqa %%xmm0, (%[d])\n\t"
+            "movdqa %%xmm1, 16(%[d])\n\t"
+            "movdqa %%xmm2, 32(%[d])\n\t"
+            "movdqa %%xmm3, 48(%[d])\n\t"
+            "add $64, %[s]\n\t"
+            "add $64, %[d]\n\t"
+            "dec %[n]\n\t"
+            "jnz 1b\n\t"
+            : [d]"+r"(dst), [s]"+r"(src), [n]"+r"(blocks)
+            : : "xmm0", "xmm1", "xmm2", "xmm3", "memory");
+    }
+    count &= 15;
+    while (count--) *dst++ = *src++;
+}
+
+__attribute__((target("sse2")))
+static void mem_stream_copy32_sse2(uint32_t* dst, const uint32_t* src, uint32_t count) {
+    while (count && ((uintptr_t)dst & 15)) { *dst++ = *src++; count--; }
+    uint32_t blocks = count / 16;
+    if (blocks) {
+        __asm__ volatile (
+            "1:\n\t"
+            "movdqu (%[s]), %%xmm0\n\t"
+            "movdqu 16(%[s]), %%xmm1\n\t"
+            "movdqu 32(%[s]), %%xmm2\n\t"
+            "movdqu 48(%[s]), %%xmm3\n\t"
+            "movntdq %%xmm0, (%[d])\n\t"
+            "movntdq %%xmm1, 16(%[d])\n\t"
+            "movntdq %%xmm2, 32(%[d])\n\t"
+            "movntdq %%xmm3, 48(%[d])\n\t"
+            "add $64, %[s]\n\t"
+            "add $64, %[d]\n\t"
+            "dec %[n]\n\t"
+            "jnz 1b\n\t"
+            "sfence\n\t"
+            : [d]"+r"(dst), [s]"+r"(src), [n]"+r"(blocks)
+            : : "xmm0", "xmm1", "xmm2", "xmm3", "memory");
+    }
+    count &= 15;
+    while (count--) *dst++ = *src++;
+}
+
+// ---------- AVX (128 bytes per iteration) ----------
+__attribute__((target("avx")))
+static void mem_set32_avx(uint32_t* dst, uint32_t val, uint32_t count) {
+    while (count && ((uintptr_t)dst & 31)) { *dst++ = val; count--; }
+    uint32_t blocks = count / 32;
+    if (blocks) {
+        __asm__ volatile (
+            "vmovd %[v], %%xmm0\n\t"
+            "vpshufd $0, %%xmm0, %%xmm0\n\t"
+            "vinsertf128 $1, %%xmm0, %%ymm0, %%ymm0\n\t"
+            "1:\n\t"
+            "vmovdqa %%ymm0, (%[d])\n\t"
+            "vmovdqa %%ymm0, 32(%[d])\n\t"
+            "vmovdqa %%ymm0, 64(%[d])\n\t"
+            "vmovdqa %%ymm0, 96(%[d])\n\t"
+            "add $128, %[d]\n\t"
+            "dec %[n]\n\t"
+            "jnz 1b\n\t"
+            "vzeroupper\n\t"
+            : [d]"+r"(dst), [n]"+r"(blocks) : [v]"r"(val) : "xmm0", "memory");
+    }
+    count &= 31;
+    while (count--) *dst++ = val;
+}
+
+__attribute__((target("avx")))
+static void mem_stream_set32_avx(uint32_t* dst, uint32_t val, uint32_t count) {
+    while (count && ((uintptr_t)dst & 31)) { *dst++ = val; count--; }
+    uint32_t blocks = count / 32;
+    if (blocks) {
+        __asm__ volatile (
+            "vmovd %[v], %%xmm0\n\t"
+            "vpshufd $0, %%xmm0, %%xmm0\n\t"
+            "vinsertf128 $1, %%xmm0, %%ymm0, %%ymm0\n\t"
+            "1:\n\t"
+            "vmovntdq %%ymm0, (%[d])\n\t"
+            "vmovntdq %%ymm0, 32(%[d])\n\t"
+            "vmovntdq %%ymm0, 64(%[d])\n\t"
+            "vmovntdq %%ymm0, 96(%[d])\n\t"
+            "add $128, %[d]\n\t"
+            "dec %[n]\n\t"
+            "jnz 1b\n\t"
+            "sfence\n\t"
+            "vzeroupper\n\t"
+            : [d]"+r"(dst), [n]"+r"(blocks) : [v]"r"(val) : "xmm0", "memory");
+    }
+    count &= 31;
+    while (count--) *dst++ = val;
+}
+
+__attribute__((target("avx")))
+static void mem_copy32_avx(uint32_t* dst, const uint32_t* src, uint32_t count) {
+    while (count && ((uintptr_t)dst & 31)) { *dst++ = *src++; count--; }
+    uint32_t blocks = count / 32;
+    if (blocks) {
+        __asm__ volatile (
+            "1:\n\t"
+            "vmovdqu (%[s]), %%ymm0\n\t"
+            "vmovdqu 32(%[s]), %%ymm1\n\t"
+            "vmovdqu 64(%[s]), %%ymm2\n\t"
+            "vmovdqu 96(%[s]), %%ymm3\n\t"
+            "vmovdqa %%ymm0, (%[d])\n\t"
+            "vmovdqa %%ymm1, 32(%[d])\n\t"
+            "vmovdqa %%ymm2, 64(%[d])\n\t"
+            "vmovdqa %%ymm3, 96(%[d])\n\t"
+            "add $128, %[s]\n\t"
+            "add $128, %[d]\n\t"
+            "dec %[n]\n\t"
+            "jnz 1b\n\t"
+            "vzeroupper\n\t"
+            : [d]"+r"(dst), [s]"+r"(src), [n]"+r"(blocks)
+            : : "xmm0", "xmm1", "xmm2", "xmm3", "memory");
+    }
+    count &= 31;
+    while (count--) *dst++ = *src++;
+}
+
+__attribute__((target("avx")))
+static void mem_stream_copy32_avx(uint32_t* dst, const uint32_t* src, uint32_t count) {
+    while (count && ((uintptr_t)dst & 31)) { *dst++ = *src++; count--; }
+    uint32_t blocks = count / 32;
+    if (blocks) {
+        __asm__ volatile (
+            "1:\n\t"
+            "vmovdqu (%[s]), %%ymm0\n\t"
+            "vmovdqu 32(%[s]), %%ymm1\n\t"
+            "vmovdqu 64(%[s]), %%ymm2\n\t"
+            "vmovdqu 96(%[s]), %%ymm3\n\t"
+            "vmovntdq %%ymm0, (%[d])\n\t"
+            "vmovntdq %%ymm1, 32(%[d])\n\t"
+            "vmovntdq %%ymm2, 64(%[d])\n\t"
+            "vmovntdq %%ymm3, 96(%[d])\n\t"
+            "add $128, %[s]\n\t"
+            "add $128, %[d]\n\t"
+            "dec %[n]\n\t"
+            "jnz 1b\n\t"
+            "sfence\n\t"
+            "vzeroupper\n\t"
+            : [d]"+r"(dst), [s]"+r"(src), [n]"+r"(blocks)
+            : : "xmm0", "xmm1", "xmm2", "xmm3", "memory");
+    }
+    count &= 31;
+    while (count--) *dst++ = *src++;
+}
+
+// ---------- Dispatch table ----------
+// Starts on the baseline kernels so it is safe to use before memops_init().
+static MemOps g_memops = {
+    mem_set32_rep, mem_copy32_rep, mem_set32_rep, mem_copy32_rep, "rep"
+};
+
+static inline void memops_init(void) {
+    cpu_init();
+
+    if (g_cpu.has_avx) {
+        g_memops.set32 = mem_set32_avx;
+        g_memops.copy32 = mem_copy32_avx;
+        g_memops.stream_set32 = mem_stream_set32_avx;
+        g_memops.stream_copy32 = mem_stream_copy32_avx;
+        g_memops.name = "AVX";
+    } else if (g_cpu.has_sse2) {
+        g_memops.set32 = mem_set32_sse2;
+        g_memops.copy32 = mem_copy32_sse2;
+        g_memops.stream_set32 = mem_stream_set32_sse2;
+        g_memops.stream_copy32 = mem_stream_copy32_sse2;
+        g_memops.name = "SSE2";
+    }
+}
+
+static inline const char* memops_get_name(void) {
+    return g_memops.name;
+}
+
+// ---------- Byte-granular helpers ----------
+// Rows in 24/16 bpp modes need not be a multiple of 4 bytes or 4-aligned.
+
+static inline void mem_zero(void* dst, uint32_t bytes) {
+    uint8_t* d = (uint8_t*)dst;
+    while (bytes && ((uintptr_t)d & 3)) { *d++ = 0; bytes--; }
+    g_memops.set32((uint32_t*)d, 0, bytes / 4);
+    d += bytes & ~3u;
+    for (bytes &= 3; bytes; bytes--) *d++ = 0;
+}
+
+static inline void mem_copy(void* dst, const void* src, uint32_t bytes) {
+    uint8_t* d = (uint8_t*)dst;
+    const uint8_t* s = (const uint8_t*)src;
+    while (bytes && ((uintptr_t)d & 3)) { *d++ = *s++; bytes--; }
+    g_memops.copy32((uint32_t*)d, (const uint32_t*)s, bytes / 4);
+    d += bytes & ~3u;
+    s += bytes & ~3u;
+    for (bytes &= 3; bytes; bytes--) *d++ = *s++;
+}
+
+static inline void mem_stream_copy(void* dst, const void* src, uint32_t bytes) {
+    uint8_t* d = (uint8_t*)dst;
+    const uint8_t* s = (const uint8_t*)src;
+    while (bytes && ((uintptr_t)d & 3)) { *d++ = *s++; bytes--; }
+    g_memops.stream_copy32((uint32_t*)d, (const uint32_t*)s, bytes / 4);
+    d += bytes & ~3u;
+    s += bytes & ~3u;
+    for (bytes &= 3; bytes; bytes--) *d++ = *s++;
+}
+
+#endif // MEMOPS_H
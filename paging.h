@@ -0,0 +1,221 @@
+#ifndef PAGING_H
+#define PAGING_H
+
+#include "types.h"
+#include "cpu.h"
+#include "pmm.h"
+
+// ============================================================================
+// PAGING FOR MINI-OS
+// Identity map of the whole 32-bit space with 4 MB pages: RAM write-back,
+// everything else uncached, and the framebuffer write-combining via the PAT.
+// 4 MB pages that mix RAM and holes are split into 4 KB page tables.
+// ============================================================================
+
+// Page directory / table entry bits
+#define PAGE_PRESENT        (1u << 0)
+#define PAGE_WRITE          (1u << 1)
+#define PAGE_PWT            (1u << 3)
+#define PAGE_PCD            (1u << 4)
+#define PAGE_LARGE          (1u << 7)   // PDE: maps 4 MB directly
+#define PAGE_PAT_4K         (1u << 7)   // PTE: PAT index bit 2
+#define PAGE_PAT_4M         (1u << 12)  // Large PDE: PAT index bit 2
+
+#define PAGE_SIZE_4K        0x1000u
+#define PAGE_SIZE_4M        0x400000u
+#define PAGE_ENTRIES        1024
+
+// Page tables for split 4 MB regions (each maps 4 MB in 4 KB pages)
+#define PAGING_MAX_TABLES   16
+
+// PAT layout: power-on defaults except entry 4, which becomes WC.
+// Index = PAT:PCD:PWT, so WB = 0, UC = PCD|PWT (3), WC = PAT (4).
+#define PAT_UC              0x00
+#define PAT_WC              0x01
+#define PAT_WT              0x04
+#define PAT_WB              0x06
+#define PAT_UC_MINUS        0x07
+#define PAT_VALUE           ((uint64_t)PAT_WB | ((uint64_t)PAT_WT << 8) |            \
+                             ((uint64_t)PAT_UC_MINUS << 16) | ((uint64_t)PAT_UC << 24) | \
+                             ((uint64_t)PAT_WC << 32) | ((uint64_t)PAT_WT << 40) |     \
+                             ((uint64_t)PAT_UC_MINUS << 48) | ((uint64_t)PAT_UC << 56))
+
+typedef enum {
+    PAGE_CACHE_WB = 0,      // Normal RAM
+    PAGE_CACHE_WC,          // Framebuffers: stores combine into bursts
+    PAGE_CACHE_UC,          // MMIO registers
+} PageCache;
+
+typedef struct {
+    uint32_t* directory;    // Page directory (physical = virtual)
+    uint32_t  tables_used;
+    uint8_t   enabled;
+    uint8_t   has_wc;       // PAT programmed; PAGE_CACHE_WC is real
+} Paging;
+
+static Paging g_paging;
+
+// ---------- Attribute bits ----------
+static inline uint32_t paging_cache_bits(PageCache cache, int large) {
+    switch (cache) {
+        case PAGE_CACHE_UC: return PAGE_PCD | PAGE_PWT;
+        // Without a PAT, leave the type to the MTRRs
+        case PAGE_CACHE_WC: return g_paging.has_wc ? (large ? PAGE_PAT_4M : PAGE_PAT_4K) : 0;
+        default:            return 0;
+    }
+}
+
+// ---------- RAM classification ----------
+static inline int paging_is_ram_type(uint32_t type) {
+    return type == E820_USABLE || type == E820_ACPI || type == E820_NVS;
+}
+
+// Bytes of [base, end) backed by RAM according to the BIOS map
+static inline uint32_t paging_ram_bytes(uint64_t base, uint64_t end) {
+    struct BootInfo* info = BOOTINFO;
+    const struct E820Entry* map = (const struct E820Entry*)(uintptr_t)info->mmap_addr;
+    uint32_t n = info->mmap_addr ? info->mmap_count : 0;
+    uint64_t bytes = 0;
+
+    if (n == 0) {
+        // No map: conventional memory and the range pmm assumes
+        static const uint32_t fallback[2][2] = { { 0, 0xA0000 }, { PMM_LOW_LIMIT, PMM_FALLBACK_END } };
+        for (int i = 0; i < 2; i++) {
+            uint64_t lo = base > fallback[i][0] ? base : fallback[i][0];
+            uint64_t hi = end < fallback[i][1] ? end : fallback[i][1];
+            if (lo < hi) bytes += hi - lo;
+        }
+        return (uint32_t)bytes;
+    }
+
+    for (uint32_t i = 0; i < n; i++) {
+        if (!paging_is_ram_type(map[i].type)) continue;
+        uint64_t lo = base > map[i].base ? base : map[i].base;
+        uint64_t hi = end < map[i].base + map[i].length ? end : map[i].base + map[i].length;
+        if (lo < hi) bytes += hi - lo;
+    }
+    return bytes > end - base ? (uint32_t)(end - base) : (uint32_t)bytes;
+}
+
+// ---------- Page tables ----------
+// Replace large page `index` with a page table of 4 KB pages. Each page is
+// RAM (write-back) if any of it is RAM, else uncached. Returns 0 if the
+// table budget is spent.
+static inline uint32_t* paging_split(uint32_t index) {
+    uint32_t pde = g_paging.directory[index];
+    if (!(pde & PAGE_LARGE)) return (uint32_t*)(pde & ~(PAGE_SIZE_4K - 1));
+    if (g_paging.tables_used >= PAGING_MAX_TABLES) return 0;
+
+    uint32_t* table = (uint32_t*)pmm_alloc(PAGE_SIZE_4K, PAGE_SIZE_4K);
+    if (!table) return 0;
+    g_paging.tables_used++;
+
+    uint32_t base = index * PAGE_SIZE_4M;
+    for (uint32_t i = 0; i < PAGE_ENTRIES; i++) {
+        uint32_t addr = base + i * PAGE_SIZE_4K;
+        PageCache cache = paging_ram_bytes(addr, (uint64_t)addr + PAGE_SIZE_4K) ? PAGE_CACHE_WB : PAGE_CACHE_UC;
+        table[i] = addr | PAGE_PRESENT | PAGE_WRITE | paging_cache_bits(cache, 0);
+    }
+    g_paging.directory[index] = (uint32_t)(uintptr_t)table | PAGE_PRESENT | PAGE_WRITE;
+    return table;
+}
+
+// ---------- Per-CPU setup ----------
+// Every CPU must run this with the same layout before it enables paging
+static inline void paging_program_pat(void) {
+    if (!g_paging.has_wc) return;
+    wbinvd();
+    wrmsr(MSR_IA32_PAT, PAT_VALUE);
+    wbinvd();
+}
+
+// Turn on paging with the shared directory (for this and other CPUs)
+static inline void paging_enable_cpu(void) {
+    paging_program_pat();
+    write_cr4(read_cr4() | CR4_PSE);
+    write_cr3((uint32_t)(uintptr_t)g_paging.directory);
+    write_cr0(read_cr0() | CR0_PG);
+}
+
+static inline uint32_t paging_get_directory(void) {
+    return (uint32_t)(uintptr_t)g_paging.directory;
+}
+
+static inline int paging_is_enabled(void) {
+    return g_paging.enabled;
+}
+
+// ---------- Mapping API ----------
+// Set the cache type of an identity-mapped physical range and return its
+// address. Partial 4 MB pages are split; a range with no table left for
+// its split keeps the large page's type (so RAM stays WB, holes stay UC).
+static inline void* paging_map(uint32_t phys, uint32_t size, PageCache cache) {
+    if (!g_paging.enabled || size == 0) return (void*)(uintptr_t)phys;
+
+    uint64_t addr = phys & ~(PAGE_SIZE_4K - 1);
+    uint64_t end = (uint64_t)phys + size;
+    if (end > 0x100000000ULL) end = 0x100000000ULL;
+
+    while (addr < end) {
+        uint32_t index = (uint32_t)(addr >> 22);
+        uint32_t large_base = index * PAGE_SIZE_4M;
+        uint32_t* pde = &g_paging.directory[index];
+
+        if ((*pde & PAGE_LARGE) && addr == large_base && end - addr >= PAGE_SIZE_4M) {
+            *pde = large_base | PAGE_PRESENT | PAGE_WRITE | PAGE_LARGE | paging_cache_bits(cache, 1);
+            addr += PAGE_SIZE_4M;
+            continue;
+        }
+
+        uint32_t* table = paging_split(index);
+        uint64_t stop = (uint64_t)large_base + PAGE_SIZE_4M;
+        if (stop > end) stop = end;
+        if (!table) {
+            addr = stop;
+            continue;
+        }
+        for (; addr < stop; addr += PAGE_SIZE_4K) {
+            table[(addr >> 12) & (PAGE_ENTRIES - 1)] =
+                (uint32_t)addr | PAGE_PRESENT | PAGE_WRITE | paging_cache_bits(cache, 0);
+        }
+    }
+
+    // Drop stale translations and lines cached under the old type
+    write_cr3(read_cr3());
+    wbinvd();
+    return (void*)(uintptr_t)phys;
+}
+
+// ---------- Initialization ----------
+// Build the identity map, switch this CPU to it and make the boot
+// framebuffer write-combining. Returns -1 (paging stays off) without PSE
+// or memory for the directory.
+static inline int paging_init(void) {
+    if (g_paging.enabled) return 0;
+    cpu_init();
+    if (!g_cpu.has_pse) return -1;
+
+    g_paging.directory = (uint32_t*)pmm_alloc(PAGE_SIZE_4K, PAGE_SIZE_4K);
+    if (!g_paging.directory) return -1;
+    g_paging.tables_used = 0;
+    g_paging.has_wc = g_cpu.has_pat;
+
+    for (uint32_t i = 0; i < PAGE_ENTRIES; i++) {
+        uint32_t base = i * PAGE_SIZE_4M;
+        uint32_t ram = paging_ram_bytes(base, (uint64_t)base + PAGE_SIZE_4M);
+        PageCache cache = ram ? PAGE_CACHE_WB : PAGE_CACHE_UC;
+        g_paging.directory[i] = base | PAGE_PRESENT | PAGE_WRITE | PAGE_LARGE | paging_cache_bits(cache, 1);
+        if (ram && ram < PAGE_SIZE_4M) paging_split(i);
+    }
+
+    paging_enable_cpu();
+    g_paging.enabled = 1;
+
+    struct BootInfo* info = BOOTINFO;
+    if (info->fb_addr) {
+        paging_map(info->fb_addr, (uint32_t)info->fb_pitch * info->fb_height, PAGE_CACHE_WC);
+    }
+    return 0;
+}
+
+#endif // PAGING_H
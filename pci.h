@@ -2,16 +2,26 @@
 #define PCI_H
 
 #include <stdint.h>
+#include "acpi.h"
+#include "paging.h"
 
 // ============================================================================
 // PCI BUS DRIVER FOR MINI-OS
-// Provides PCI configuration space access and device enumeration
+// Provides PCI configuration space access and device enumeration. Config
+// space goes through the memory-mapped ECAM window from the ACPI MCFG when
+// there is one, else through the 0xCF8/0xCFC ports. Enumeration follows
+// PCI-to-PCI bridges from the root buses and sizes every BAR.
 // ============================================================================
 
 // PCI Configuration Space I/O Ports
 #define PCI_CONFIG_ADDR  0xCF8
 #define PCI_CONFIG_DATA  0xCFC
 
+// PCI Express ECAM: 4 KB per function, 32 KB per slot, 1 MB per bus
+#define PCI_ECAM_BUS_SHIFT   20
+#define PCI_ECAM_SLOT_SHIFT  15
+#define PCI_ECAM_FUNC_SHIFT  12
+
 // PCI Configuration Space Registers (offsets)
 #define PCI_VENDOR_ID        0x00
 #define PCI_DEVICE_ID        0x02
@@ -31,18 +41,37 @@
 #define PCI_BAR3             0x1C
 #define PCI_BAR4             0x20
 #define PCI_BAR5             0x24
+#define PCI_CAP_POINTER      0x34
 #define PCI_INTERRUPT_LINE   0x3C
 #define PCI_INTERRUPT_PIN    0x3D
 
+// PCI-to-PCI bridge header (type 1)
+#define PCI_PRIMARY_BUS      0x18
+#define PCI_SECONDARY_BUS    0x19
+#define PCI_SUBORDINATE_BUS  0x1A
+
+// Header Types
+#define PCI_HEADER_NORMAL    0x00
+#define PCI_HEADER_BRIDGE    0x01
+#define PCI_HEADER_MULTIFUNC 0x80
+
 // PCI Command Register Bits
 #define PCI_CMD_IO_SPACE     0x0001
 #define PCI_CMD_MEM_SPACE    0x0002
 #define PCI_CMD_BUS_MASTER   0x0004
 
+// Status Register Bits
+#define PCI_STATUS_CAP_LIST  0x0010
+
+// Capability IDs
+#define PCI_CAP_ID_VENDOR    0x09
+
 // PCI Class Codes
 #define PCI_CLASS_DISPLAY    0x03
 #define PCI_SUBCLASS_VGA     0x00
 #define PCI_SUBCLASS_3D      0x02
+#define PCI_CLASS_BRIDGE     0x06
+#define PCI_SUBCLASS_HOST    0x00
 
 // Known GPU Vendor IDs
 #define PCI_VENDOR_AMD       0x1002
@@ -89,6 +118,22 @@ static inline uint32_t inl(uint16_t port) {
     return ret;
 }
 
+// ---------- PCI State ----------
+#define PCI_MAX_DEVICES 128
+#define PCI_MAX_BUSES   256
+#define PCI_CLASS_COUNT 256
+
+typedef struct {
+    uint32_t ecam_base;                     // Address of bus 0's window; 0 = port I/O only
+    uint8_t  ecam_start, ecam_end;          // Buses the window decodes
+    uint8_t  config_ready;
+    uint32_t bus_seen[PCI_MAX_BUSES / 32];  // Buses already scanned this pass
+    int16_t  class_head[PCI_CLASS_COUNT];   // First device of each class, -1 = none
+    int16_t  display;                       // Device pci_find_display returns, -1 = none
+} PCIState;
+
+static PCIState g_pci;
+
 // ---------- PCI Configuration Space Access ----------
 
 // Build PCI config address
@@ -96,32 +141,56 @@ static inline uint32_t pci_config_addr(uint8_t bus, uint8_t slot, uint8_t func,
     return (uint32_t)((bus << 16) | (slot << 11) | (func << 8) | (offset & 0xFC) | 0x80000000);
 }
 
+// ECAM address of a config register, or 0 when the bus is outside the window
+static inline volatile uint8_t* pci_ecam_addr(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset) {
+    if (!g_pci.ecam_base || bus < g_pci.ecam_start || bus > g_pci.ecam_end) return 0;
+    return (volatile uint8_t*)(uintptr_t)(g_pci.ecam_base + ((uint32_t)bus << PCI_ECAM_BUS_SHIFT) +
+                                          ((uint32_t)slot << PCI_ECAM_SLOT_SHIFT) +
+                                          ((uint32_t)func << PCI_ECAM_FUNC_SHIFT) + offset);
+}
+
 // Read 32-bit value from PCI config space
 static inline uint32_t pci_read32(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset) {
+    volatile uint8_t* ecam = pci_ecam_addr(bus, slot, func, offset & 0xFC);
+    if (ecam) return *(volatile uint32_t*)ecam;
     outl(PCI_CONFIG_ADDR, pci_config_addr(bus, slot, func, offset));
     return inl(PCI_CONFIG_DATA);
 }
 
 // Read 16-bit value from PCI config space
 static inline uint16_t pci_read16(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset) {
+    volatile uint8_t* ecam = pci_ecam_addr(bus, slot, func, offset & 0xFE);
+    if (ecam) return *(volatile uint16_t*)ecam;
     outl(PCI_CONFIG_ADDR, pci_config_addr(bus, slot, func, offset));
     return (uint16_t)(inl(PCI_CONFIG_DATA) >> ((offset & 2) * 8));
 }
 
 // Read 8-bit value from PCI config space
 static inline uint8_t pci_read8(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset) {
+    volatile uint8_t* ecam = pci_ecam_addr(bus, slot, func, offset);
+    if (ecam) return *ecam;
     outl(PCI_CONFIG_ADDR, pci_config_addr(bus, slot, func, offset));
     return (uint8_t)(inl(PCI_CONFIG_DATA) >> ((offset & 3) * 8));
 }
 
 // Write 32-bit value to PCI config space
 static inline void pci_write32(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset, uint32_t val) {
+    volatile uint8_t* ecam = pci_ecam_addr(bus, slot, func, offset & 0xFC);
+    if (ecam) {
+        *(volatile uint32_t*)ecam = val;
+        return;
+    }
     outl(PCI_CONFIG_ADDR, pci_config_addr(bus, slot, func, offset));
     outl(PCI_CONFIG_DATA, val);
 }
 
 // Write 16-bit value to PCI config space
 static inline void pci_write16(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset, uint16_t val) {
+    volatile uint8_t* ecam = pci_ecam_addr(bus, slot, func, offset & 0xFE);
+    if (ecam) {
+        *(volatile uint16_t*)ecam = val;
+        return;
+    }
     outl(PCI_CONFIG_ADDR, pci_config_addr(bus, slot, func, offset));
     uint32_t tmp = inl(PCI_CONFIG_DATA);
     tmp &= ~(0xFFFF << ((offset & 2) * 8));
@@ -129,6 +198,22 @@ static inline void pci_write16(uint8_t bus, uint8_t slot, uint8_t func, uint8_t
     outl(PCI_CONFIG_DATA, tmp);
 }
 
+// Map the MCFG window uncached; buses it does not cover stay on port I/O
+static inline void pci_config_init(void) {
+    if (g_pci.config_ready) return;
+    g_pci.config_ready = 1;
+    
+    uint32_t base;
+    uint8_t start, end;
+    if (acpi_find_mcfg(&base, &start, &end) != 0) return;
+    uint32_t first = base + ((uint32_t)start << PCI_ECAM_BUS_SHIFT);
+    uint32_t size = ((uint32_t)end - start + 1) << PCI_ECAM_BUS_SHIFT;
+    paging_map(first, size, PAGE_CACHE_UC);
+    g_pci.ecam_base = base;
+    g_pci.ecam_start = start;
+    g_pci.ecam_end = end;
+}
+
 // ---------- PCI Device Structure ----------
 typedef struct {
     uint8_t  bus;
@@ -143,12 +228,12 @@ typedef struct {
     uint8_t  header_type;
     uint8_t  interrupt_line;
     uint8_t  interrupt_pin;
-    uint32_t bar[6];
-    uint32_t bar_size[6];
+    uint32_t bar[6];       // Raw; a MEM64 BAR's upper half is the next entry
+    uint32_t bar_size[6];  // Bytes decoded, 0 if unimplemented or 4 GB and up
     uint8_t  bar_type[6];  // 0=unused, 1=IO, 2=MEM32, 3=MEM64
+    int16_t  class_next;   // Next device of the same class, -1 = last
 } PCIDevice;
 
-#define PCI_MAX_DEVICES 32
 static PCIDevice pci_devices[PCI_MAX_DEVICES];
 static int pci_device_count = 0;
 
@@ -171,51 +256,101 @@ static inline uint32_t pci_bar_get_addr(uint32_t bar) {
     }
 }
 
-// Get BAR size - simplified version (skip the risky write)
-static inline uint32_t pci_get_bar_size(uint8_t bus, uint8_t slot, uint8_t func, uint8_t bar_num) {
-    (void)bus; (void)slot; (void)func; (void)bar_num;
-    // Skip BAR size detection to avoid potential issues
-    // Real drivers would probe this properly
-    return 0;
+// Mounted above 4 GB: out of reach of the 32-bit identity map
+static inline int pci_bar_above_4g(const PCIDevice* dev, int bar_num) {
+    return dev->bar_type[bar_num] == 3 && (bar_num == 5 || dev->bar[bar_num + 1] != 0);
+}
+
+// Write all ones and read back which address bits stick, both halves of
+// a 64-bit BAR. Decoding is off meanwhile so the device never answers at
+// the probe address; host bridges keep theirs (they may decode RAM).
+static inline uint32_t pci_get_bar_size(const PCIDevice* dev, uint8_t bar_num) {
+    uint8_t bus = dev->bus, slot = dev->slot, func = dev->func;
+    uint8_t off = PCI_BAR0 + bar_num * 4;
+    uint32_t orig = pci_read32(bus, slot, func, off);
+    int is_io = orig & PCI_BAR_IO;
+    int is_64 = !is_io && (orig & PCI_BAR_MEM_TYPE) == PCI_BAR_MEM_64 && bar_num < 5;
+    
+    uint16_t cmd = pci_read16(bus, slot, func, PCI_COMMAND);
+    int host = dev->class_code == PCI_CLASS_BRIDGE && dev->subclass == PCI_SUBCLASS_HOST;
+    if (!host) pci_write16(bus, slot, func, PCI_COMMAND, cmd & ~(PCI_CMD_IO_SPACE | PCI_CMD_MEM_SPACE));
+    
+    pci_write32(bus, slot, func, off, 0xFFFFFFFF);
+    uint32_t low = pci_read32(bus, slot, func, off);
+    pci_write32(bus, slot, func, off, orig);
+    uint32_t high = 0xFFFFFFFF;
+    if (is_64) {
+        uint32_t orig_high = pci_read32(bus, slot, func, off + 4);
+        pci_write32(bus, slot, func, off + 4, 0xFFFFFFFF);
+        high = pci_read32(bus, slot, func, off + 4);
+        pci_write32(bus, slot, func, off + 4, orig_high);
+    }
+    
+    if (!host) pci_write16(bus, slot, func, PCI_COMMAND, cmd);
+    
+    if (is_io) {
+        uint32_t mask = low & 0xFFFFFFFC;
+        if (!mask) return 0;
+        if (!(mask & 0xFFFF0000)) mask |= 0xFFFF0000;   // 16-bit decoder, upper bits hardwired 0
+        return ~mask + 1;
+    }
+    uint64_t mask = ((uint64_t)high << 32) | (low & 0xFFFFFFF0);
+    if (!(low & 0xFFFFFFF0) && !is_64) return 0;
+    uint64_t size = ~mask + 1;
+    return size > 0xFFFFFFFFULL || !mask ? 0 : (uint32_t)size;
 }
 
 // ---------- PCI Device Enumeration ----------
 static inline int pci_check_device(uint8_t bus, uint8_t slot, uint8_t func) {
-    uint16_t vendor = pci_read16(bus, slot, func, PCI_VENDOR_ID);
-    if (vendor == 0xFFFF) return 0;
+    uint32_t id = pci_read32(bus, slot, func, PCI_VENDOR_ID);
+    if ((id & 0xFFFF) == 0xFFFF) return 0;
     
     if (pci_device_count >= PCI_MAX_DEVICES) return 0;
     
+    // Whole dwords: one config access per four fields
+    uint32_t class_rev = pci_read32(bus, slot, func, PCI_REVISION_ID);
+    uint32_t misc = pci_read32(bus, slot, func, PCI_CACHE_LINE_SIZE);
+    uint32_t irq = pci_read32(bus, slot, func, PCI_INTERRUPT_LINE);
+    
     PCIDevice* dev = &pci_devices[pci_device_count];
     dev->bus = bus;
     dev->slot = slot;
     dev->func = func;
-    dev->vendor_id = vendor;
-    dev->device_id = pci_read16(bus, slot, func, PCI_DEVICE_ID);
-    dev->class_code = pci_read8(bus, slot, func, PCI_CLASS);
-    dev->subclass = pci_read8(bus, slot, func, PCI_SUBCLASS);
-    dev->prog_if = pci_read8(bus, slot, func, PCI_PROG_IF);
-    dev->revision = pci_read8(bus, slot, func, PCI_REVISION_ID);
-    dev->header_type = pci_read8(bus, slot, func, PCI_HEADER_TYPE);
-    dev->interrupt_line = pci_read8(bus, slot, func, PCI_INTERRUPT_LINE);
-    dev->interrupt_pin = pci_read8(bus, slot, func, PCI_INTERRUPT_PIN);
+    dev->vendor_id = id & 0xFFFF;
+    dev->device_id = id >> 16;
+    dev->class_code = class_rev >> 24;
+    dev->subclass = (class_rev >> 16) & 0xFF;
+    dev->prog_if = (class_rev >> 8) & 0xFF;
+    dev->revision = class_rev & 0xFF;
+    dev->header_type = (misc >> 16) & 0xFF;
+    dev->interrupt_line = irq & 0xFF;
+    dev->interrupt_pin = (irq >> 8) & 0xFF;
+    dev->class_next = -1;
     
-    // Read BARs (only for standard header type 0)
-    if ((dev->header_type & 0x7F) == 0) {
-        for (int i = 0; i < 6; i++) {
-            dev->bar[i] = pci_read32(bus, slot, func, PCI_BAR0 + i * 4);
-            dev->bar_size[i] = pci_get_bar_size(bus, slot, func, i);
-            
-            if (dev->bar[i] == 0) {
-                dev->bar_type[i] = 0;
-            } else if (dev->bar[i] & PCI_BAR_IO) {
-                dev->bar_type[i] = 1;
-            } else if ((dev->bar[i] & PCI_BAR_MEM_TYPE) == PCI_BAR_MEM_64) {
-                dev->bar_type[i] = 3;
-                i++; // Skip next BAR (upper 32 bits)
-            } else {
-                dev->bar_type[i] = 2;
-            }
+    // Normal devices have six BARs, bridges two, anything else none
+    int bar_count = 0;
+    if ((dev->header_type & 0x7F) == PCI_HEADER_NORMAL) bar_count = 6;
+    else if ((dev->header_type & 0x7F) == PCI_HEADER_BRIDGE) bar_count = 2;
+    
+    for (int i = 0; i < 6; i++) {
+        dev->bar[i] = 0;
+        dev->bar_size[i] = 0;
+        dev->bar_type[i] = 0;
+    }
+    for (int i = 0; i < bar_count; i++) {
+        dev->bar[i] = pci_read32(bus, slot, func, PCI_BAR0 + i * 4);
+        dev->bar_size[i] = pci_get_bar_size(dev, i);
+        
+        if (dev->bar[i] == 0) {
+            dev->bar_type[i] = 0;
+        } else if (dev->bar[i] & PCI_BAR_IO) {
+            dev->bar_type[i] = 1;
+        } else if ((dev->bar[i] & PCI_BAR_MEM_TYPE) == PCI_BAR_MEM_64 && i < bar_count - 1) {
+            dev->bar_type[i] = 3;
+            dev->bar[i + 1] = pci_read32(bus, slot, func, PCI_BAR0 + (i + 1) * 4);
+            i++; // Next BAR holds the upper 32 bits
+        } else {
+            dev->bar_type[i] = 2;
         }
     }
     
@@ -223,30 +358,77 @@ static inline int pci_check_device(uint8_t bus, uint8_t slot, uint8_t func) {
     return 1;
 }
 
-static inline void pci_enumerate(void) {
-    pci_device_count = 0;
+static inline void pci_scan_bus(uint8_t bus);
+
+// Record the function, then descend through it if it is a bridge. The
+// secondary bus number is the one firmware assigned; 0 means unconfigured.
+static inline void pci_scan_function(uint8_t bus, uint8_t slot, uint8_t func) {
+    pci_check_device(bus, slot, func);
+    
+    uint8_t header = pci_read8(bus, slot, func, PCI_HEADER_TYPE);
+    if ((header & 0x7F) != PCI_HEADER_BRIDGE) return;
+    uint8_t secondary = pci_read8(bus, slot, func, PCI_SECONDARY_BUS);
+    if (secondary > bus) pci_scan_bus(secondary);
+}
+
+static inline void pci_scan_bus(uint8_t bus) {
+    // Each bus once, so a misprogrammed bridge cannot loop the walk
+    if (g_pci.bus_seen[bus >> 5] & (1u << (bus & 31))) return;
+    g_pci.bus_seen[bus >> 5] |= 1u << (bus & 31);
     
-    // Only scan bus 0 for simplicity (covers most devices in QEMU)
     for (int slot = 0; slot < 32; slot++) {
-        uint16_t vendor = pci_read16(0, slot, 0, PCI_VENDOR_ID);
+        uint16_t vendor = pci_read16(bus, slot, 0, PCI_VENDOR_ID);
         if (vendor == 0xFFFF || vendor == 0x0000) continue;
         
-        pci_check_device(0, slot, 0);
+        pci_scan_function(bus, slot, 0);
         
         // Check for multi-function device
-        uint8_t header = pci_read8(0, slot, 0, PCI_HEADER_TYPE);
-        if (header & 0x80) {
+        uint8_t header = pci_read8(bus, slot, 0, PCI_HEADER_TYPE);
+        if (header & PCI_HEADER_MULTIFUNC) {
             for (int func = 1; func < 8; func++) {
-                if (pci_read16(0, slot, func, PCI_VENDOR_ID) != 0xFFFF) {
-                    pci_check_device(0, slot, func);
+                if (pci_read16(bus, slot, func, PCI_VENDOR_ID) != 0xFFFF) {
+                    pci_scan_function(bus, slot, func);
                 }
             }
         }
-        
-        if (pci_device_count >= PCI_MAX_DEVICES) break;
     }
 }
 
+// Chain the devices of each class in bus order and settle the display
+static inline void pci_build_index(void) {
+    for (int i = 0; i < PCI_CLASS_COUNT; i++) g_pci.class_head[i] = -1;
+    for (int i = pci_device_count - 1; i >= 0; i--) {
+        pci_devices[i].class_next = g_pci.class_head[pci_devices[i].class_code];
+        g_pci.class_head[pci_devices[i].class_code] = (int16_t)i;
+    }
+    
+    // First VGA controller, else the first 3D controller
+    int16_t vga = -1, other = -1;
+    for (int16_t i = g_pci.class_head[PCI_CLASS_DISPLAY]; i >= 0; i = pci_devices[i].class_next) {
+        if (pci_devices[i].subclass == PCI_SUBCLASS_VGA && vga < 0) vga = i;
+        if (pci_devices[i].subclass == PCI_SUBCLASS_3D && other < 0) other = i;
+    }
+    g_pci.display = vga >= 0 ? vga : other;
+}
+
+static inline void pci_enumerate(void) {
+    pci_config_init();
+    pci_device_count = 0;
+    for (int i = 0; i < PCI_MAX_BUSES / 32; i++) g_pci.bus_seen[i] = 0;
+    
+    // A multi-function host bridge at 0:0.0 means one root bus per function
+    uint8_t header = pci_read8(0, 0, 0, PCI_HEADER_TYPE);
+    if (!(header & PCI_HEADER_MULTIFUNC)) {
+        pci_scan_bus(0);
+    } else {
+        for (int func = 0; func < 8; func++) {
+            if (pci_read16(0, 0, func, PCI_VENDOR_ID) != 0xFFFF) pci_scan_bus(func);
+        }
+    }
+    
+    pci_build_index();
+}
+
 // ---------- PCI Device Lookup ----------
 static inline PCIDevice* pci_find_device(uint16_t vendor, uint16_t device) {
     for (int i = 0; i < pci_device_count; i++) {
@@ -257,21 +439,17 @@ static inline PCIDevice* pci_find_device(uint16_t vendor, uint16_t device) {
     return 0;
 }
 
+// Walks only the devices of this class
 static inline PCIDevice* pci_find_class(uint8_t class_code, uint8_t subclass) {
-    for (int i = 0; i < pci_device_count; i++) {
-        if (pci_devices[i].class_code == class_code && pci_devices[i].subclass == subclass) {
-            return &pci_devices[i];
-        }
+    if (!pci_device_count) return 0;
+    for (int16_t i = g_pci.class_head[class_code]; i >= 0; i = pci_devices[i].class_next) {
+        if (pci_devices[i].subclass == subclass) return &pci_devices[i];
     }
     return 0;
 }
 
 static inline PCIDevice* pci_find_display(void) {
-    // First try VGA controller
-    PCIDevice* dev = pci_find_class(PCI_CLASS_DISPLAY, PCI_SUBCLASS_VGA);
-    if (dev) return dev;
-    // Then try 3D controller
-    return pci_find_class(PCI_CLASS_DISPLAY, PCI_SUBCLASS_3D);
+    return pci_device_count && g_pci.display >= 0 ? &pci_devices[g_pci.display] : 0;
 }
 
 // ---------- PCI Device Enable ----------
@@ -281,6 +459,23 @@ static inline void pci_enable_device(PCIDevice* dev) {
     pci_write16(dev->bus, dev->slot, dev->func, PCI_COMMAND, cmd);
 }
 
+// ---------- PCI Capabilities ----------
+// Config offset of the first capability with this ID after `from` (0 =
+// from the start of the list), or 0 when there is none
+static inline uint8_t pci_find_capability(const PCIDevice* dev, uint8_t id, uint8_t from) {
+    if (!(pci_read16(dev->bus, dev->slot, dev->func, PCI_STATUS) & PCI_STATUS_CAP_LIST)) return 0;
+    
+    uint8_t off = from ? pci_read8(dev->bus, dev->slot, dev->func, from + 1)
+                       : pci_read8(dev->bus, dev->slot, dev->func, PCI_CAP_POINTER);
+    // The list may not loop; 48 entries fill the whole config space
+    for (int i = 0; i < 48 && off >= 0x40; i++) {
+        off &= 0xFC;
+        if (pci_read8(dev->bus, dev->slot, dev->func, off) == id) return off;
+        off = pci_read8(dev->bus, dev->slot, dev->func, off + 1);
+    }
+    return 0;
+}
+
 // ---------- Vendor Name Lookup ----------
 static inline const char* pci_vendor_name(uint16_t vendor) {
     switch (vendor) {
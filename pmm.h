@@ -0,0 +1,235 @@
+#ifndef PMM_H
+#define PMM_H
+
+#include "types.h"
+
+// ============================================================================
+// PHYSICAL MEMORY FOR MINI-OS
+// Boot-time page allocator over the BIOS E820 map, plus arena (bump) and
+// fixed-size pool allocators built on top of it
+// ============================================================================
+
+#define PMM_PAGE_SIZE       4096
+#define PMM_MAX_REGIONS     16
+
+// Low memory holds the IVT, BIOS data, boot structures, kernel and stack
+#define PMM_LOW_LIMIT       0x00100000
+
+// Used when the BIOS gave no E820 map: assume 16 MB of RAM
+#define PMM_FALLBACK_END    0x01000000
+
+// Highest address handed out: 32-bit physical space minus the last page
+#define PMM_TOP             0xFFFFF000ULL
+
+typedef struct {
+    uint32_t base;
+    uint32_t end;           // Exclusive
+    uint32_t next;          // First unallocated byte
+} PMMRegion;
+
+typedef struct {
+    PMMRegion regions[PMM_MAX_REGIONS];
+    uint32_t count;
+    uint32_t total;         // Usable bytes found at init
+    uint32_t used;          // Bytes handed out (including alignment gaps)
+    uint8_t  ready;
+} PMM;
+
+static PMM g_pmm;
+
+static inline uint32_t pmm_align_up(uint32_t v, uint32_t align) {
+    return (v + align - 1) & ~(align - 1);
+}
+
+// ---------- Region bookkeeping ----------
+static inline void pmm_add_region(uint64_t base, uint64_t end) {
+    if (end > PMM_TOP) end = PMM_TOP;
+    if (base < PMM_LOW_LIMIT) base = PMM_LOW_LIMIT;
+    if (base >= end || g_pmm.count >= PMM_MAX_REGIONS) return;
+
+    uint32_t b = pmm_align_up((uint32_t)base, PMM_PAGE_SIZE);
+    uint32_t e = (uint32_t)end & ~(PMM_PAGE_SIZE - 1);
+    if (b >= e) return;
+
+    PMMRegion* r = &g_pmm.regions[g_pmm.count++];
+    r->base = b;
+    r->end = e;
+    r->next = b;
+}
+
+// Take [base, end) out of every usable region, splitting where needed
+static inline void pmm_reserve(uint64_t base, uint64_t end) {
+    if (base >= PMM_TOP) return;
+    if (end > PMM_TOP) end = PMM_TOP;
+    uint32_t b = (uint32_t)base & ~(PMM_PAGE_SIZE - 1);
+    uint32_t e = pmm_align_up((uint32_t)end, PMM_PAGE_SIZE);
+
+    for (uint32_t i = 0; i < g_pmm.count; i++) {
+        PMMRegion* r = &g_pmm.regions[i];
+        if (e <= r->base || b >= r->end) continue;
+
+        if (b > r->base && e < r->end) {
+            if (g_pmm.count < PMM_MAX_REGIONS) {
+                PMMRegion* tail = &g_pmm.regions[g_pmm.count++];
+                tail->base = e;
+                tail->end = r->end;
+                tail->next = e;
+            }
+            r->end = b;
+        } else if (b <= r->base) {
+            r->base = e < r->end ? e : r->end;
+        } else {
+            r->end = b;
+        }
+        r->next = r->base;
+    }
+}
+
+// ---------- Initialization ----------
+// Usable E820 ranges minus every reserved range (reserved wins on overlap)
+// and minus the framebuffer
+static inline void pmm_init(void) {
+    if (g_pmm.ready) return;
+    struct BootInfo* info = BOOTINFO;
+    const struct E820Entry* map = (const struct E820Entry*)(uintptr_t)info->mmap_addr;
+    uint32_t n = info->mmap_addr ? info->mmap_count : 0;
+
+    g_pmm.count = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        if (map[i].type != E820_USABLE || map[i].length == 0) continue;
+        if (!(map[i].acpi & 1)) continue;
+        pmm_add_region(map[i].base, map[i].base + map[i].length);
+    }
+    if (g_pmm.count == 0) pmm_add_region(PMM_LOW_LIMIT, PMM_FALLBACK_END);
+
+    for (uint32_t i = 0; i < n; i++) {
+        if (map[i].type == E820_USABLE || map[i].length == 0) continue;
+        pmm_reserve(map[i].base, map[i].base + map[i].length);
+    }
+    if (info->fb_addr) {
+        pmm_reserve(info->fb_addr, (uint64_t)info->fb_addr + (uint32_t)info->fb_pitch * info->fb_height);
+    }
+
+    g_pmm.total = 0;
+    for (uint32_t i = 0; i < g_pmm.count; i++) {
+        g_pmm.total += g_pmm.regions[i].end - g_pmm.regions[i].base;
+    }
+    g_pmm.used = 0;
+    g_pmm.ready = 1;
+}
+
+// ---------- Page allocation ----------
+// Whole pages, aligned to `align` (a power of two, at least a page).
+// Boot-time only: pages are never given back. Returns 0 when out of memory.
+static inline void* pmm_alloc(uint32_t size, uint32_t align) {
+    if (!g_pmm.ready) pmm_init();
+    if (size == 0) return 0;
+    if (align < PMM_PAGE_SIZE) align = PMM_PAGE_SIZE;
+    size = pmm_align_up(size, PMM_PAGE_SIZE);
+
+    for (uint32_t i = 0; i < g_pmm.count; i++) {
+        PMMRegion* r = &g_pmm.regions[i];
+        uint32_t p = pmm_align_up(r->next, align);
+        if (p < r->next || p > r->end || r->end - p < size) continue;
+        g_pmm.used += p + size - r->next;
+        r->next = p + size;
+        return (void*)(uintptr_t)p;
+    }
+    return 0;
+}
+
+static inline uint32_t pmm_get_total(void) { return g_pmm.total; }
+static inline uint32_t pmm_get_used(void) { return g_pmm.used; }
+static inline uint32_t pmm_get_free(void) { return g_pmm.total - g_pmm.used; }
+
+// ============================================================================
+// ARENA (bump allocator over one block, freed all at once)
+// ============================================================================
+
+typedef struct {
+    uint8_t* base;
+    uint32_t size;
+    uint32_t used;
+} Arena;
+
+static inline int arena_init(Arena* arena, uint32_t size) {
+    arena->base = (uint8_t*)pmm_alloc(size, PMM_PAGE_SIZE);
+    arena->size = arena->base ? pmm_align_up(size, PMM_PAGE_SIZE) : 0;
+    arena->used = 0;
+    return arena->base ? 0 : -1;
+}
+
+// `align` must be a power of two
+static inline void* arena_alloc(Arena* arena, uint32_t size, uint32_t align) {
+    uint32_t offset = pmm_align_up(arena->used, align ? align : 1);
+    if (offset > arena->size || arena->size - offset < size) return 0;
+    arena->used = offset + size;
+    return arena->base + offset;
+}
+
+static inline void arena_reset(Arena* arena) {
+    arena->used = 0;
+}
+
+// Free everything allocated after a saved point
+static inline uint32_t arena_save(const Arena* arena) {
+    return arena->used;
+}
+
+static inline void arena_restore(Arena* arena, uint32_t mark) {
+    if (mark <= arena->used) arena->used = mark;
+}
+
+// ============================================================================
+// POOL (fixed-size blocks with a free list)
+// ============================================================================
+
+typedef struct PoolBlock {
+    struct PoolBlock* next;
+} PoolBlock;
+
+typedef struct {
+    uint8_t* base;
+    uint32_t block_size;
+    uint32_t count;
+    uint32_t free_count;
+    PoolBlock* free_list;
+} Pool;
+
+// `block_size` is rounded up to 16 bytes so blocks suit SIMD loads
+static inline int pool_init(Pool* pool, uint32_t block_size, uint32_t count) {
+    pool->block_size = pmm_align_up(block_size < sizeof(PoolBlock) ? sizeof(PoolBlock) : block_size, 16);
+    pool->base = (uint8_t*)pmm_alloc(pool->block_size * count, PMM_PAGE_SIZE);
+    pool->count = pool->base ? count : 0;
+    pool->free_count = pool->count;
+    pool->free_list = 0;
+    for (uint32_t i = pool->count; i-- > 0;) {
+        PoolBlock* block = (PoolBlock*)(pool->base + i * pool->block_size);
+        block->next = pool->free_list;
+        pool->free_list = block;
+    }
+    return pool->base ? 0 : -1;
+}
+
+static inline void* pool_alloc(Pool* pool) {
+    PoolBlock* block = pool->free_list;
+    if (!block) return 0;
+    pool->free_list = block->next;
+    pool->free_count--;
+    return block;
+}
+
+static inline int pool_owns(const Pool* pool, const void* p) {
+    const uint8_t* b = (const uint8_t*)p;
+    return pool->base && b >= pool->base && b < pool->base + pool->block_size * pool->count;
+}
+
+static inline void pool_free(Pool* pool, void* p) {
+    if (!p || !pool_owns(pool, p)) return;
+    PoolBlock* block = (PoolBlock*)p;
+    block->next = pool->free_list;
+    pool->free_list = block;
+    pool->free_count++;
+}
+
+#endif // PMM_H
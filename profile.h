@@ -0,0 +1,172 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "types.h"
+#include "cpu.h"
+#include "timer.h"
+
+// ============================================================================
+// FRAME PROFILER FOR MINI-OS
+// PROFILE_ZONE(zone) at the top of a function times it with the TSC until
+// it returns. Each CPU sums its own zones (tile jobs run them on the APs
+// too), and only the outermost scope of a zone counts, so nested and
+// recursive calls are not counted twice. profile_end_frame folds the sums
+// into one record of a PROFILE_FRAMES ring. Each zone keeps a histogram of
+// exactly the frames in the ring, which makes p50 / p99 a walk over its
+// buckets. display.h draws the numbers into LAYER_OVERLAY.
+//
+// Built only with -DPROFILE (compile-and-run.sh --profile). Otherwise
+// PROFILE_ZONE expands to nothing and none of this state exists.
+// ============================================================================
+
+#ifdef PROFILE
+
+typedef enum {
+    PROFILE_FRAME = 0,          // display_begin_frame to display_end_frame
+    PROFILE_COMPOSITE,
+    PROFILE_PRESENT,
+    PROFILE_FONT,
+    PROFILE_RASTER,
+    PROFILE_ZONE_COUNT
+} ProfileZone;
+
+// Frames of history (power of two)
+#define PROFILE_FRAMES      128
+
+// Microseconds below PROFILE_LINEAR get a bucket each, then four buckets
+// per power of two up to 2^32: never worse than 25% resolution
+#define PROFILE_LINEAR      16
+#define PROFILE_BUCKETS     (PROFILE_LINEAR + 28 * 4)
+
+typedef struct __attribute__((aligned(64))) {
+    uint64_t cycles[PROFILE_ZONE_COUNT];    // Outermost scopes only
+    uint32_t calls[PROFILE_ZONE_COUNT];
+    uint8_t  depth[PROFILE_ZONE_COUNT];     // Scopes of the zone open on this CPU
+} ProfileCPU;
+
+typedef struct {
+    uint32_t frame;             // display frame_count
+    uint32_t us[PROFILE_ZONE_COUNT];
+    uint32_t calls[PROFILE_ZONE_COUNT];
+} ProfileFrame;
+
+typedef struct {
+    ProfileCPU   cpu[CPU_MAX];
+    ProfileFrame ring[PROFILE_FRAMES];
+    uint32_t     count;         // Frames recorded; the ring keeps the last PROFILE_FRAMES
+    uint16_t     histogram[PROFILE_ZONE_COUNT][PROFILE_BUCKETS];
+} Profiler;
+
+typedef struct {
+    uint32_t zone;
+    uint32_t outer;
+    uint64_t start;
+} ProfileScope;
+
+static Profiler g_profile;
+
+// ---------- Zones ----------
+static inline ProfileScope profile_zone_begin(uint32_t zone) {
+    ProfileCPU* c = &g_profile.cpu[cpu_index()];
+    ProfileScope s = {zone, c->depth[zone]++ == 0, rdtsc()};
+    return s;
+}
+
+static inline void profile_zone_end(ProfileScope* s) {
+    uint64_t end = rdtsc();
+    ProfileCPU* c = &g_profile.cpu[cpu_index()];
+    c->depth[s->zone]--;
+    if (!s->outer) return;
+    c->cycles[s->zone] += end - s->start;
+    c->calls[s->zone]++;
+}
+
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b)  PROFILE_CONCAT2(a, b)
+
+// Times the rest of the enclosing block
+#define PROFILE_ZONE(zone) \
+    ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__) \
+        __attribute__((cleanup(profile_zone_end))) = profile_zone_begin(zone)
+
+// ---------- Histograms ----------
+static inline uint32_t profile_bucket(uint32_t us) {
+    if (us < PROFILE_LINEAR) return us;
+    uint32_t e = 31 - (uint32_t)__builtin_clz(us);
+    return PROFILE_LINEAR + (e - 4) * 4 + ((us >> (e - 2)) & 3);
+}
+
+// Largest value that lands in bucket `b`
+static inline uint32_t profile_bucket_max(uint32_t b) {
+    if (b < PROFILE_LINEAR) return b;
+    uint32_t e = (b - PROFILE_LINEAR) / 4 + 4;
+    uint32_t m = (b - PROFILE_LINEAR) & 3;
+    return (uint32_t)(((uint64_t)(5 + m) << (e - 2)) - 1);
+}
+
+// ---------- Frames ----------
+// Call once a frame is done. Tile jobs have finished by then, so no CPU
+// is inside a zone while its sums are taken and cleared.
+static inline void profile_end_frame(uint32_t frame, uint32_t frame_us) {
+    ProfileFrame* f = &g_profile.ring[g_profile.count & (PROFILE_FRAMES - 1)];
+    if (g_profile.count >= PROFILE_FRAMES) {
+        for (uint32_t z = 0; z < PROFILE_ZONE_COUNT; z++) g_profile.histogram[z][profile_bucket(f->us[z])]--;
+    }
+
+    f->frame = frame;
+    for (uint32_t z = 1; z < PROFILE_ZONE_COUNT; z++) {
+        uint64_t cycles = 0;
+        uint32_t calls = 0;
+        for (uint32_t c = 0; c < CPU_MAX; c++) {
+            cycles += g_profile.cpu[c].cycles[z];
+            calls += g_profile.cpu[c].calls[z];
+            g_profile.cpu[c].cycles[z] = 0;
+            g_profile.cpu[c].calls[z] = 0;
+        }
+        f->us[z] = timer_ns_to_us(timer_cycles_to_ns(cycles));
+        f->calls[z] = calls;
+    }
+    f->us[PROFILE_FRAME] = frame_us;
+    f->calls[PROFILE_FRAME] = 1;
+
+    for (uint32_t z = 0; z < PROFILE_ZONE_COUNT; z++) g_profile.histogram[z][profile_bucket(f->us[z])]++;
+    g_profile.count++;
+}
+
+static inline const ProfileFrame* profile_last_frame(void) {
+    if (!g_profile.count) return 0;
+    return &g_profile.ring[(g_profile.count - 1) & (PROFILE_FRAMES - 1)];
+}
+
+// Upper bound, in us, of the bucket reaching `percent` of the frames in the ring
+static inline uint32_t profile_percentile(uint32_t zone, uint32_t percent) {
+    uint32_t n = g_profile.count < PROFILE_FRAMES ? g_profile.count : PROFILE_FRAMES;
+    if (!n) return 0;
+
+    uint32_t need = (n * percent + 99) / 100;
+    uint32_t seen = 0;
+    for (uint32_t b = 0; b < PROFILE_BUCKETS; b++) {
+        seen += g_profile.histogram[zone][b];
+        if (seen >= need) return profile_bucket_max(b);
+    }
+    return profile_bucket_max(PROFILE_BUCKETS - 1);
+}
+
+static inline const char* profile_zone_name(uint32_t zone) {
+    switch (zone) {
+        case PROFILE_FRAME:     return "frame";
+        case PROFILE_COMPOSITE: return "composite";
+        case PROFILE_PRESENT:   return "present";
+        case PROFILE_FONT:      return "font";
+        case PROFILE_RASTER:    return "raster";
+        default:                return "?";
+    }
+}
+
+#else
+
+#define PROFILE_ZONE(zone)
+
+#endif // PROFILE
+
+#endif // PROFILE_H
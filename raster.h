@@ -0,0 +1,404 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+#include "types.h"
+#include "trig.h"
+#include "profile.h"
+
+// ============================================================================
+// SCANLINE POLYGON RASTERIZER FOR MINI-OS
+// Edge table + active edge list. Edges are stepped in 16.16 fixed point,
+// pixels are sampled at their centers and the nonzero winding rule decides
+// what is inside, so convex, concave and self-intersecting outlines all
+// fill. Each covered run of a row goes out as one span, so the callback can
+// hand it straight to a span writer. Polygons that share an edge never both
+// cover a pixel on it.
+// Ellipses, circles and rings are filled row by row too: the half-width of
+// each row is walked down from the previous one, so there is no per-pixel
+// distance test.
+// Arcs and Bezier curves are flattened into point lists here as well, for
+// polylines or as outlines for raster_fill_polygon. Lines are clipped once
+// and emitted as horizontal or vertical runs.
+// ============================================================================
+
+// Edges per polygon (one per non-horizontal side); extra sides are dropped
+#define RASTER_MAX_EDGES    128
+
+// Coordinates must stay within +-32767 so x << 16 fits
+#define RASTER_FIX_SHIFT    16
+#define RASTER_FIX_HALF     (1 << (RASTER_FIX_SHIFT - 1))
+
+// Receives pixels [x, x + len) of row y, already clipped to the row range
+typedef void (*RasterSpanFn)(void* arg, int x, int y, int len);
+
+typedef struct {
+    int32_t x;          // 16.16 at the center of the current row
+    int32_t dx;         // Per row
+    int32_t y_top;      // First row covered
+    int32_t y_bottom;   // One past the last row
+    int32_t winding;    // +1 going down, -1 going up
+} RasterEdge;
+
+// ---------- Edge table ----------
+// Builds the edges of a closed outline sorted by their first row. Edges
+// entirely outside rows [clip_top, clip_bottom) are dropped and the rest
+// start at clip_top at the earliest. Returns the number of edges.
+static inline int raster_build_edges(RasterEdge* edges, const int* points, int count,
+                                     int clip_top, int clip_bottom) {
+    int n = 0;
+    for (int i = 0; i < count && n < RASTER_MAX_EDGES; i++) {
+        int j = (i + 1 == count) ? 0 : i + 1;
+        int x0 = points[i * 2], y0 = points[i * 2 + 1];
+        int x1 = points[j * 2], y1 = points[j * 2 + 1];
+        if (y0 == y1) continue;
+
+        int winding = 1;
+        if (y0 > y1) {
+            int t = x0; x0 = x1; x1 = t;
+            t = y0; y0 = y1; y1 = t;
+            winding = -1;
+        }
+        if (y1 <= clip_top || y0 >= clip_bottom) continue;
+
+        // Integer vertices: row y0 is the first whose center is below y0
+        RasterEdge e;
+        e.dx = ((x1 - x0) << RASTER_FIX_SHIFT) / (y1 - y0);
+        e.x = (x0 << RASTER_FIX_SHIFT) + e.dx / 2;
+        e.y_top = y0;
+        e.y_bottom = y1;
+        e.winding = winding;
+        if (e.y_top < clip_top) {
+            e.x += e.dx * (clip_top - e.y_top);
+            e.y_top = clip_top;
+        }
+
+        // Insertion sort by first row; outlines arrive mostly in order
+        int k = n++;
+        while (k > 0 && edges[k - 1].y_top > e.y_top) {
+            edges[k] = edges[k - 1];
+            k--;
+        }
+        edges[k] = e;
+    }
+    return n;
+}
+
+// ---------- Fill ----------
+// Fill a closed outline of `count` (x, y) pairs with the nonzero rule,
+// emitting spans for rows [clip_top, clip_bottom)
+static inline void raster_fill_polygon(const int* points, int count, int clip_top, int clip_bottom,
+                                       RasterSpanFn fn, void* arg) {
+    PROFILE_ZONE(PROFILE_RASTER);
+    if (count < 3 || clip_top >= clip_bottom) return;
+
+    RasterEdge edges[RASTER_MAX_EDGES];
+    RasterEdge* active[RASTER_MAX_EDGES];
+    int n = raster_build_edges(edges, points, count, clip_top, clip_bottom);
+    if (n < 2) return;
+
+    int next = 0, n_active = 0;
+    int y_end = clip_bottom;
+    for (int y = edges[0].y_top; y < y_end; y++) {
+        // Retire finished edges, then pull in the ones starting on this row
+        int kept = 0;
+        for (int i = 0; i < n_active; i++) {
+            if (active[i]->y_bottom > y) active[kept++] = active[i];
+        }
+        n_active = kept;
+        while (next < n && edges[next].y_top == y) active[n_active++] = &edges[next++];
+        if (n_active == 0) {
+            if (next == n) break;
+            y = edges[next].y_top - 1;
+            continue;
+        }
+
+        // Order by x; stepping keeps the list almost sorted between rows
+        for (int i = 1; i < n_active; i++) {
+            RasterEdge* e = active[i];
+            int k = i;
+            while (k > 0 && active[k - 1]->x > e->x) {
+                active[k] = active[k - 1];
+                k--;
+            }
+            active[k] = e;
+        }
+
+        // Pixel centers in [x_left, x_right) of each nonzero run
+        int winding = 0;
+        int32_t x_left = 0;
+        for (int i = 0; i < n_active; i++) {
+            int was = winding;
+            winding += active[i]->winding;
+            if (was == 0) {
+                x_left = active[i]->x;
+            } else if (winding == 0) {
+                int x0 = (x_left + RASTER_FIX_HALF - 1) >> RASTER_FIX_SHIFT;
+                int x1 = (active[i]->x + RASTER_FIX_HALF - 1) >> RASTER_FIX_SHIFT;
+                if (x1 > x0) fn(arg, x0, y, x1 - x0);
+            }
+        }
+
+        for (int i = 0; i < n_active; i++) active[i]->x += active[i]->dx;
+    }
+}
+
+// ---------- Conic spans ----------
+// Largest value <= x (or -1) whose square times `weight` is within
+// `budget`. Rows walked outward from the center only ever shrink it, so a
+// whole shape costs O(radius) steps.
+static inline int32_t raster_shrink(int32_t x, int64_t weight, int64_t budget) {
+    while (x >= 0 && (int64_t)x * x * weight > budget) x--;
+    return x;
+}
+
+// Emit [cx + x0, cx + x1] on rows cy - dy and cy + dy if they are in range
+static inline void raster_emit_pair(int32_t cx, int32_t cy, int32_t dy, int32_t x0, int32_t x1,
+                                    int clip_top, int clip_bottom, RasterSpanFn fn, void* arg) {
+    if (x1 < x0) return;
+    int32_t top = cy - dy, bottom = cy + dy;
+    if (top >= clip_top && top < clip_bottom) fn(arg, cx + x0, top, x1 - x0 + 1);
+    if (dy && bottom >= clip_top && bottom < clip_bottom) fn(arg, cx + x0, bottom, x1 - x0 + 1);
+}
+
+// Every (x, y) with x^2 / rx^2 + y^2 / ry^2 <= 1; rx == ry is a circle
+static inline void raster_fill_ellipse(int32_t cx, int32_t cy, int32_t rx, int32_t ry,
+                                       int clip_top, int clip_bottom, RasterSpanFn fn, void* arg) {
+    PROFILE_ZONE(PROFILE_RASTER);
+    if (rx < 0 || ry < 0 || clip_top >= clip_bottom) return;
+    int64_t rx2 = (int64_t)rx * rx, ry2 = (int64_t)ry * ry;
+    int32_t hw = rx;
+    for (int32_t dy = 0; dy <= ry; dy++) {
+        if (cy - dy < clip_top && cy + dy >= clip_bottom) break;
+        hw = raster_shrink(hw, ry2, rx2 * ry2 - (int64_t)dy * dy * rx2);
+        raster_emit_pair(cx, cy, dy, -hw, hw, clip_top, clip_bottom, fn, arg);
+    }
+}
+
+// Every (x, y) with r_inner^2 <= x^2 + y^2 <= r_outer^2
+static inline void raster_fill_ring(int32_t cx, int32_t cy, int32_t r_outer, int32_t r_inner,
+                                    int clip_top, int clip_bottom, RasterSpanFn fn, void* arg) {
+    PROFILE_ZONE(PROFILE_RASTER);
+    if (r_inner <= 0) {
+        raster_fill_ellipse(cx, cy, r_outer, r_outer, clip_top, clip_bottom, fn, arg);
+        return;
+    }
+    if (r_outer < r_inner || clip_top >= clip_bottom) return;
+    int64_t ro2 = (int64_t)r_outer * r_outer, ri2 = (int64_t)r_inner * r_inner;
+    int32_t outer = r_outer, inner = r_inner;   // Inner: last x left out of the ring
+    for (int32_t dy = 0; dy <= r_outer; dy++) {
+        if (cy - dy < clip_top && cy + dy >= clip_bottom) break;
+        int64_t dy2 = (int64_t)dy * dy;
+        outer = raster_shrink(outer, 1, ro2 - dy2);
+        inner = raster_shrink(inner, 1, ri2 - 1 - dy2);
+        if (inner < 0) {
+            raster_emit_pair(cx, cy, dy, -outer, outer, clip_top, clip_bottom, fn, arg);
+        } else {
+            raster_emit_pair(cx, cy, dy, -outer, -inner - 1, clip_top, clip_bottom, fn, arg);
+            raster_emit_pair(cx, cy, dy, inner + 1, outer, clip_top, clip_bottom, fn, arg);
+        }
+    }
+}
+
+// ---------- Curve flattening ----------
+// Curves are split in 1/16 pixel units until they are within about a
+// quarter pixel of a straight line, then written out as whole-pixel points.
+#define RASTER_CURVE_SHIFT  4
+#define RASTER_CURVE_DEPTH  10      // At most 1024 segments per curve
+#define RASTER_CURVE_TOL    4       // Flatness in curve units
+
+// Append (x, y) unless it repeats the last point; returns the new count
+static inline int raster_push_point(int* out, int n, int max, int x, int y) {
+    if (n > 0 && out[n * 2 - 2] == x && out[n * 2 - 1] == y) return n;
+    if (n >= max) return n;
+    out[n * 2] = x;
+    out[n * 2 + 1] = y;
+    return n + 1;
+}
+
+static inline int raster_curve_round(int32_t v) {
+    return (v + (1 << (RASTER_CURVE_SHIFT - 1))) >> RASTER_CURVE_SHIFT;
+}
+
+// Cubic with control points c[0..7] = x0 y0 x1 y1 x2 y2 x3 y3 in curve
+// units. Appends every point after the first to out (max points in all).
+static inline int raster_flatten_cubic(const int32_t* c, int* out, int n, int max) {
+    int32_t stack[RASTER_CURVE_DEPTH + 1][8];
+    int depth[RASTER_CURVE_DEPTH + 1];
+    int top = 0;
+    for (int i = 0; i < 8; i++) stack[0][i] = c[i];
+    depth[0] = 0;
+    
+    while (top >= 0) {
+        int32_t* p = stack[top];
+        // Distance of the control points from the chord, doubled (Willcocks)
+        int64_t ux = 3 * p[2] - 2 * p[0] - p[6], uy = 3 * p[3] - 2 * p[1] - p[7];
+        int64_t vx = 3 * p[4] - p[0] - 2 * p[6], vy = 3 * p[5] - p[1] - 2 * p[7];
+        ux *= ux; uy *= uy; vx *= vx; vy *= vy;
+        int64_t flat = (ux > vx ? ux : vx) + (uy > vy ? uy : vy);
+        
+        if (depth[top] == RASTER_CURVE_DEPTH || flat <= 16 * RASTER_CURVE_TOL * RASTER_CURVE_TOL) {
+            n = raster_push_point(out, n, max, raster_curve_round(p[6]), raster_curve_round(p[7]));
+            top--;
+            continue;
+        }
+        
+        // de Casteljau at t = 1/2: right half replaces p, left half goes on top
+        int32_t* q = stack[top + 1];
+        for (int k = 0; k < 2; k++) {
+            int32_t a = (p[k] + p[2 + k]) / 2, b = (p[2 + k] + p[4 + k]) / 2, e = (p[4 + k] + p[6 + k]) / 2;
+            int32_t ab = (a + b) / 2, be = (b + e) / 2, mid = (ab + be) / 2;
+            q[k] = p[k]; q[2 + k] = a; q[4 + k] = ab; q[6 + k] = mid;
+            p[k] = mid; p[2 + k] = be; p[4 + k] = e;
+        }
+        depth[top + 1] = ++depth[top];
+        top++;
+    }
+    return n;
+}
+
+// Cubic through pixel coordinates: (x0, y0) then the flattened points
+static inline int raster_cubic_points(int x0, int y0, int x1, int y1, int x2, int y2, int x3, int y3,
+                                      int* out, int max) {
+    int32_t c[8] = { x0, y0, x1, y1, x2, y2, x3, y3 };
+    for (int i = 0; i < 8; i++) c[i] *= 1 << RASTER_CURVE_SHIFT;
+    int n = raster_push_point(out, 0, max, x0, y0);
+    return raster_flatten_cubic(c, out, n, max);
+}
+
+// A quadratic is the cubic with controls 2/3 of the way to its middle point
+static inline int raster_quadratic_points(int x0, int y0, int x1, int y1, int x2, int y2,
+                                          int* out, int max) {
+    int32_t s = 1 << RASTER_CURVE_SHIFT;
+    int32_t c[8] = {
+        x0 * s, y0 * s,
+        (x0 * s + 2 * x1 * s) / 3, (y0 * s + 2 * y1 * s) / 3,
+        (x2 * s + 2 * x1 * s) / 3, (y2 * s + 2 * y1 * s) / 3,
+        x2 * s, y2 * s,
+    };
+    int n = raster_push_point(out, 0, max, x0, y0);
+    return raster_flatten_cubic(c, out, n, max);
+}
+
+// Points of an arc from angle a0 to a1 (trig.h units, counterclockwise,
+// y up). Chords are sized so they stay within half a pixel of the circle.
+static inline int raster_arc_points(int cx, int cy, int r, int32_t a0, int32_t a1,
+                                    int* out, int n, int max) {
+    if (r < 0 || a1 < a0 || n >= max) return n;
+    
+    // Sagitta r * (1 - cos(step / 2)) <= 1/2 gives step ~ 326 / sqrt(r) units
+    int32_t step = r > 0 ? 326 / (int32_t)trig_isqrt(r) : TRIG_QUARTER;
+    if (step < 1) step = 1;
+    if (step > TRIG_STEPS / 16) step = TRIG_STEPS / 16;
+    int32_t segments = (a1 - a0 + step - 1) / step;
+    if (segments < 1) segments = 1;
+    if (segments > max - n - 1) segments = max - n - 1 > 0 ? max - n - 1 : 1;
+    
+    for (int32_t i = 0; i <= segments; i++) {
+        int32_t a = a0 + (a1 - a0) * i / segments;
+        int x = cx + (int)(((int64_t)r * trig_cos(a) + TRIG_ONE / 2) >> 16);
+        int y = cy - (int)(((int64_t)r * trig_sin(a) + TRIG_ONE / 2) >> 16);
+        n = raster_push_point(out, n, max, x, y);
+    }
+    return n;
+}
+
+// ---------- Lines ----------
+// Pixel k of a line (0 <= k <= major length) is k steps along the major
+// axis and floor((2k * minor + major) / (2 * major)) along the minor one.
+// Clipping solves that for the first and last k inside the clip rectangle
+// (Liang-Barsky on the step count), so a clipped line lights exactly the
+// pixels of the unclipped one and tiles drawn separately meet without
+// seams. Coordinates must stay within +-16383 for the 32-bit products.
+
+// Runs are hfn(x, y, len) along x or vfn(x, y, len) down y, already clipped
+static inline void raster_line(int32_t x0, int32_t y0, int32_t x1, int32_t y1,
+                               int32_t clip_x0, int32_t clip_y0, int32_t clip_x1, int32_t clip_y1,
+                               RasterSpanFn hfn, RasterSpanFn vfn, void* arg) {
+    PROFILE_ZONE(PROFILE_RASTER);
+    int32_t dx = x1 - x0, dy = y1 - y0;
+    int x_major = (dx < 0 ? -dx : dx) >= (dy < 0 ? -dy : dy);
+    
+    // Major axis a, minor axis b; the clip range is [lo, hi] on each
+    int32_t a0 = x_major ? x0 : y0, b0 = x_major ? y0 : x0;
+    int32_t da = x_major ? dx : dy, db = x_major ? dy : dx;
+    int32_t a_lo = x_major ? clip_x0 : clip_y0, a_hi = (x_major ? clip_x1 : clip_y1) - 1;
+    int32_t b_lo = x_major ? clip_y0 : clip_x0, b_hi = (x_major ? clip_y1 : clip_x1) - 1;
+    int32_t sa = da < 0 ? -1 : 1, sb = db < 0 ? -1 : 1;
+    uint32_t la = (uint32_t)(da * sa), lb = (uint32_t)(db * sb);
+    
+    // Steps whose major coordinate is inside
+    int32_t k0 = sa > 0 ? a_lo - a0 : a0 - a_hi;
+    int32_t k1 = sa > 0 ? a_hi - a0 : a0 - a_lo;
+    if (k0 < 0) k0 = 0;
+    if (k1 > (int32_t)la) k1 = (int32_t)la;
+    
+    // Steps whose minor offset q (0..lb, non-decreasing in k) is inside
+    int32_t q_lo = sb > 0 ? b_lo - b0 : b0 - b_hi;
+    int32_t q_hi = sb > 0 ? b_hi - b0 : b0 - b_lo;
+    if (q_hi < 0 || q_lo > (int32_t)lb) return;
+    if (lb) {
+        if (q_lo > 0) {
+            int32_t k = (int32_t)(((uint32_t)(2 * q_lo - 1) * la + 2 * lb - 1) / (2 * lb));
+            if (k > k0) k0 = k;
+        }
+        if (q_hi < (int32_t)lb) {
+            int32_t k = (int32_t)(((uint32_t)(2 * q_hi + 1) * la - 1) / (2 * lb));
+            if (k < k1) k1 = k;
+        }
+    }
+    if (k0 > k1) return;
+    if (la == 0) {
+        hfn(arg, x0, y0, 1);
+        return;
+    }
+    
+    // Walk the error term from k0, emitting one run per minor step
+    uint32_t two_la = 2 * la, two_lb = 2 * lb;
+    uint32_t num = (uint32_t)k0 * two_lb + la;
+    int32_t q = (int32_t)(num / two_la);
+    uint32_t err = num % two_la;
+    int32_t start = k0;
+    for (int32_t k = k0; k <= k1; k++) {
+        int last = k == k1;
+        if (!last) {
+            err += two_lb;
+            if (err < two_la) continue;
+            err -= two_la;
+        }
+        int32_t a = sa > 0 ? a0 + start : a0 - k;
+        int32_t b = b0 + sb * q;
+        if (x_major) hfn(arg, a, b, k - start + 1);
+        else vfn(arg, b, a, k - start + 1);
+        start = k + 1;
+        q++;
+    }
+}
+
+// A line `thickness` pixels wide as one quad, with square caps reaching
+// half the thickness past each end. Corners are placed in 1/16 pixels
+// around the pixel centers, then rounded.
+static inline void raster_thick_line(int32_t x0, int32_t y0, int32_t x1, int32_t y1, int32_t thickness,
+                                     int clip_top, int clip_bottom, RasterSpanFn fn, void* arg) {
+    PROFILE_ZONE(PROFILE_RASTER);
+    int32_t dx = x1 - x0, dy = y1 - y0;
+    uint32_t len = trig_isqrt((uint32_t)(dx * dx) + (uint32_t)(dy * dy));
+    
+    // Half-thickness along (d) and across (n) the line, in 1/16 pixels
+    int32_t half = thickness * 8;
+    int32_t ux = len ? dx * half / (int32_t)len : half;
+    int32_t uy = len ? dy * half / (int32_t)len : 0;
+    int32_t px0 = x0 * 16 + 8, py0 = y0 * 16 + 8;
+    int32_t px1 = x1 * 16 + 8, py1 = y1 * 16 + 8;
+    
+    int32_t q[8] = {
+        px0 - ux - uy, py0 - uy + ux,
+        px1 + ux - uy, py1 + uy + ux,
+        px1 + ux + uy, py1 + uy - ux,
+        px0 - ux + uy, py0 - uy - ux,
+    };
+    int points[8];
+    for (int i = 0; i < 8; i++) points[i] = (q[i] + 8) >> 4;
+    raster_fill_polygon(points, 4, clip_top, clip_bottom, fn, arg);
+}
+
+#endif // RASTER_H
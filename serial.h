@@ -0,0 +1,118 @@
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include <stdint.h>
+#include "pci.h"
+
+// ============================================================================
+// SERIAL PORT FOR MINI-OS
+// Polled 16550 UART on COM1 (115200 8N1) for logs and benchmark output
+// ============================================================================
+
+#define SERIAL_COM1         0x3F8
+
+// Register offsets from the base port
+#define SERIAL_DATA         0   // DLAB=0: THR/RBR, DLAB=1: divisor low
+#define SERIAL_IER          1   // DLAB=0: interrupt enable, DLAB=1: divisor high
+#define SERIAL_FCR          2
+#define SERIAL_LCR          3
+#define SERIAL_MCR          4
+#define SERIAL_LSR          5
+#define SERIAL_SCRATCH      7
+
+#define SERIAL_LCR_8N1      0x03
+#define SERIAL_LCR_DLAB     0x80
+#define SERIAL_LSR_THRE     0x20    // Transmit holding register empty
+
+// Bytes the transmit FIFO takes at once after THRE is set
+#define SERIAL_FIFO_SIZE    16
+
+// 115200 / SERIAL_DIVISOR baud
+#define SERIAL_DIVISOR      1
+
+// Polls before giving up on a stuck transmitter
+#define SERIAL_TIMEOUT      100000
+
+typedef struct {
+    uint16_t port;
+    uint8_t  ready;         // UART answered the scratch register probe
+} SerialPort;
+
+static SerialPort g_serial;
+
+// ---------- Initialization ----------
+static inline int serial_init(void) {
+    uint16_t port = SERIAL_COM1;
+    g_serial.port = port;
+    g_serial.ready = 0;
+
+    // An absent UART reads back 0xFF, so a scratch round-trip detects it
+    outb(port + SERIAL_SCRATCH, 0x5A);
+    if (inb(port + SERIAL_SCRATCH) != 0x5A) return -1;
+
+    outb(port + SERIAL_IER, 0x00);                  // Polled only
+    outb(port + SERIAL_LCR, SERIAL_LCR_DLAB);
+    outb(port + SERIAL_DATA, SERIAL_DIVISOR & 0xFF);
+    outb(port + SERIAL_IER, SERIAL_DIVISOR >> 8);
+    outb(port + SERIAL_LCR, SERIAL_LCR_8N1);
+    outb(port + SERIAL_FCR, 0xC7);                  // FIFO on, cleared, 14-byte threshold
+    outb(port + SERIAL_MCR, 0x03);                  // DTR + RTS
+
+    g_serial.ready = 1;
+    return 0;
+}
+
+static inline int serial_is_ready(void) {
+    return g_serial.ready;
+}
+
+// ---------- Output ----------
+static inline void serial_putc_raw(char c) {
+    uint32_t spins = SERIAL_TIMEOUT;
+    while (!(inb(g_serial.port + SERIAL_LSR) & SERIAL_LSR_THRE) && --spins);
+    outb(g_serial.port + SERIAL_DATA, (uint8_t)c);
+}
+
+static inline void serial_putc(char c) {
+    if (!g_serial.ready) return;
+    if (c == '\n') serial_putc_raw('\r');
+    serial_putc_raw(c);
+}
+
+static inline void serial_write(const char* str) {
+    while (*str) serial_putc(*str++);
+}
+
+static inline void serial_write_uint(uint32_t value) {
+    char buf[11];
+    int i = 10;
+    buf[i] = '\0';
+    do {
+        buf[--i] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+    serial_write(&buf[i]);
+}
+
+static inline void serial_write_hex(uint32_t value) {
+    static const char hex[] = "0123456789ABCDEF";
+    serial_write("0x");
+    for (int shift = 28; shift >= 0; shift -= 4) {
+        serial_putc(hex[(value >> shift) & 0xF]);
+    }
+}
+
+// ---------- Non-blocking output ----------
+static inline int serial_tx_ready(void) {
+    return g_serial.ready && (inb(g_serial.port + SERIAL_LSR) & SERIAL_LSR_THRE);
+}
+
+// Push up to one FIFO's worth of bytes without waiting; returns bytes sent
+static inline uint32_t serial_write_fifo(const uint8_t* data, uint32_t len) {
+    if (!serial_tx_ready()) return 0;
+    if (len > SERIAL_FIFO_SIZE) len = SERIAL_FIFO_SIZE;
+    for (uint32_t i = 0; i < len; i++) outb(g_serial.port + SERIAL_DATA, data[i]);
+    return len;
+}
+
+#endif // SERIAL_H
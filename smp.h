@@ -0,0 +1,224 @@
+#ifndef SMP_H
+#define SMP_H
+
+#include "types.h"
+#include "cpu.h"
+#include "timer.h"
+#include "pmm.h"
+#include "paging.h"
+#include "acpi.h"
+#include "irq.h"
+#include "jobs.h"
+
+// ============================================================================
+// SMP FOR MINI-OS
+// Starts the application processors listed by the firmware with
+// INIT-SIPI-SIPI. Each AP gets its own stack and FS selector (see
+// cpu_index), joins the shared page tables and then serves jobs.h forever.
+// Once smp_enable_wake has run, idle APs halt and jobs_parallel_for wakes
+// them with a local APIC IPI.
+// ============================================================================
+
+// Real-mode startup code is copied here (SIPI vector = address >> 12).
+// Must match TRAMP_BASE in kernel_entry.asm.
+#define SMP_TRAMPOLINE      0x7000
+#define SMP_STACK_SIZE      0x4000
+
+// Local APIC registers (offsets from the APIC base)
+#define LAPIC_ID            0x020
+#define LAPIC_EOI           0x0B0
+#define LAPIC_SVR           0x0F0
+#define LAPIC_ICR_LOW       0x300
+#define LAPIC_ICR_HIGH      0x310
+
+#define LAPIC_SVR_ENABLE    (1u << 8)
+#define LAPIC_SPURIOUS      IRQ_APIC_SPURIOUS
+#define LAPIC_ICR_INIT      0x00000500
+#define LAPIC_ICR_STARTUP   0x00000600
+#define LAPIC_ICR_ASSERT    0x00004000
+#define LAPIC_ICR_PENDING   (1u << 12)
+#define LAPIC_ICR_OTHERS    0x000C0000  // Shorthand: all but self
+#define APIC_BASE_ENABLE    (1u << 11)
+
+// Startup timing from the MP specification
+#define SMP_INIT_DELAY_US   10000
+#define SMP_SIPI_DELAY_US   200
+#define SMP_ONLINE_US       100000
+
+// Patched into the tail of the trampoline before each startup
+typedef struct __attribute__((packed)) {
+    uint16_t gdt_limit;
+    uint32_t gdt_base;
+    uint16_t fs;
+    uint32_t stack;
+    uint32_t entry;
+} SMPTrampolineParams;
+
+// Startup code and parameter block (kernel_entry.asm)
+extern const uint8_t ap_trampoline[];
+extern const uint8_t ap_trampoline_end[];
+
+typedef struct {
+    uint32_t lapic;                 // Local APIC base (identity mapped, uncached)
+    uint32_t cpu_count;             // CPUs running, BSP included
+    uint8_t  apic_ids[CPU_MAX];     // By CPU index
+    volatile uint32_t started;      // Set by the AP being brought up
+    uint8_t  ready;
+} SMP;
+
+static SMP g_smp;
+
+// Null, code, then one flat data segment per CPU (its FS selector)
+static uint64_t g_gdt[2 + CPU_MAX];
+
+// ---------- Local APIC ----------
+static inline uint32_t lapic_read(uint32_t reg) {
+    return *(volatile uint32_t*)(uintptr_t)(g_smp.lapic + reg);
+}
+
+static inline void lapic_write(uint32_t reg, uint32_t value) {
+    *(volatile uint32_t*)(uintptr_t)(g_smp.lapic + reg) = value;
+}
+
+static inline uint8_t lapic_id(void) {
+    return lapic_read(LAPIC_ID) >> 24;
+}
+
+static inline void lapic_enable(void) {
+    wrmsr(MSR_IA32_APIC_BASE, rdmsr(MSR_IA32_APIC_BASE) | APIC_BASE_ENABLE);
+    lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | LAPIC_SPURIOUS);
+}
+
+static inline int lapic_send_ipi(uint8_t apic_id, uint32_t command) {
+    lapic_write(LAPIC_ICR_HIGH, (uint32_t)apic_id << 24);
+    lapic_write(LAPIC_ICR_LOW, command);
+    for (uint32_t i = 0; i < 1000; i++) {
+        if (!(lapic_read(LAPIC_ICR_LOW) & LAPIC_ICR_PENDING)) return 0;
+        timer_delay_us(1);
+    }
+    return -1;
+}
+
+// Fixed `vector` to every other CPU; waits only for the previous IPI to go
+static inline void lapic_send_ipi_others(uint32_t vector) {
+    while (lapic_read(LAPIC_ICR_LOW) & LAPIC_ICR_PENDING) cpu_relax();
+    lapic_write(LAPIC_ICR_LOW, LAPIC_ICR_OTHERS | LAPIC_ICR_ASSERT | vector);
+}
+
+// ---------- Waking idle APs ----------
+static void smp_wake_eoi(void) {
+    lapic_write(LAPIC_EOI, 0);
+}
+
+// Idle APs are halted with only the wake vector able to reach them
+static void smp_wake_workers(void) {
+    lapic_send_ipi_others(IRQ_WAKE);
+}
+
+// ---------- GDT ----------
+static inline void smp_load_gdt(void) {
+    struct __attribute__((packed)) { uint16_t limit; uint32_t base; } desc = {
+        sizeof(g_gdt) - 1, (uint32_t)(uintptr_t)g_gdt
+    };
+    __asm__ volatile ("lgdt %0" : : "m"(desc));
+}
+
+static inline void smp_build_gdt(void) {
+    g_gdt[0] = 0;
+    g_gdt[1] = 0x00CF9A000000FFFFULL;   // Same flat segments as boot.asm
+    for (uint32_t i = 0; i < CPU_MAX; i++) {
+        g_gdt[2 + i] = 0x00CF92000000FFFFULL;
+    }
+}
+
+// ---------- AP side ----------
+static inline void smp_ap_main(void) {
+    paging_enable_cpu();
+    cpu_init_local();
+    irq_load_idt();
+    lapic_enable();
+    __atomic_store_n(&g_smp.started, 1, __ATOMIC_RELEASE);
+    jobs_worker();
+}
+
+// ---------- BSP side ----------
+static inline int smp_start_ap(uint32_t index, uint8_t apic_id) {
+    uint8_t* stack = (uint8_t*)pmm_alloc(SMP_STACK_SIZE, PMM_PAGE_SIZE);
+    if (!stack) return -1;
+
+    uint32_t code_size = (uint32_t)(ap_trampoline_end - ap_trampoline);
+    SMPTrampolineParams* params = (SMPTrampolineParams*)(uintptr_t)
+        (SMP_TRAMPOLINE + code_size - sizeof(SMPTrampolineParams));
+    params->gdt_limit = sizeof(g_gdt) - 1;
+    params->gdt_base = (uint32_t)(uintptr_t)g_gdt;
+    params->fs = GDT_DATA + index * 8;
+    params->stack = (uint32_t)(uintptr_t)(stack + SMP_STACK_SIZE);
+    params->entry = (uint32_t)(uintptr_t)smp_ap_main;
+    g_smp.started = 0;
+
+    uint32_t vector = SMP_TRAMPOLINE >> 12;
+    if (lapic_send_ipi(apic_id, LAPIC_ICR_INIT | LAPIC_ICR_ASSERT) != 0) return -1;
+    timer_delay_us(SMP_INIT_DELAY_US);
+    for (int i = 0; i < 2 && !g_smp.started; i++) {
+        lapic_send_ipi(apic_id, LAPIC_ICR_STARTUP | LAPIC_ICR_ASSERT | vector);
+        timer_delay_us(SMP_SIPI_DELAY_US);
+    }
+
+    uint64_t deadline = timer_us() + SMP_ONLINE_US;
+    while (!__atomic_load_n(&g_smp.started, __ATOMIC_ACQUIRE)) {
+        if (timer_us() > deadline) return -1;
+        cpu_relax();
+    }
+    return 0;
+}
+
+// ---------- Initialization ----------
+// Bring up every AP the firmware lists. Needs paging (APs take the same
+// page tables) and a calibrated timer. Returns the number of CPUs running.
+static inline uint32_t smp_init(void) {
+    if (g_smp.ready) return g_smp.cpu_count;
+    g_smp.ready = 1;
+    g_smp.cpu_count = 1;
+    g_smp.apic_ids[0] = 0;
+
+    uint32_t found = acpi_init();
+    cpu_init();
+    if (found < 2 || !paging_is_enabled() || !(g_cpu.features_edx & CPUID_EDX_MSR)) return 1;
+    timer_init();
+    if (!timer_is_ready()) return 1;
+    if (jobs_init(found) != 0) return 1;
+
+    g_smp.lapic = (uint32_t)(uintptr_t)paging_map(g_acpi.lapic_address, PAGE_SIZE_4K, PAGE_CACHE_UC);
+    lapic_enable();
+    uint8_t self = lapic_id();
+    g_smp.apic_ids[0] = self;
+
+    smp_build_gdt();
+    smp_load_gdt();
+
+    uint32_t code_size = (uint32_t)(ap_trampoline_end - ap_trampoline);
+    for (uint32_t i = 0; i < code_size; i++) {
+        ((volatile uint8_t*)SMP_TRAMPOLINE)[i] = ap_trampoline[i];
+    }
+
+    for (uint32_t i = 0; i < found && g_smp.cpu_count < found; i++) {
+        uint8_t id = g_acpi.apic_ids[i];
+        if (id == self) continue;
+        if (smp_start_ap(g_smp.cpu_count, id) != 0) continue;
+        g_smp.apic_ids[g_smp.cpu_count++] = id;
+    }
+    return g_smp.cpu_count;
+}
+
+static inline uint32_t smp_get_cpu_count(void) {
+    return g_smp.ready ? g_smp.cpu_count : 1;
+}
+
+// Let idle APs halt. Call after irq_init: the wake IPI needs its gate.
+static inline void smp_enable_wake(void) {
+    if (!g_irq.ready || smp_get_cpu_count() < 2) return;
+    irq_set_wake_handler(smp_wake_eoi);
+    jobs_set_wake(smp_wake_workers);
+}
+
+#endif // SMP_H
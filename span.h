@@ -0,0 +1,237 @@
+#ifndef SPAN_H
+#define SPAN_H
+
+#include "types.h"
+#include "memops.h"
+#include "blend.h"
+
+// ============================================================================
+// SPAN WRITERS FOR MINI-OS
+// Format-specialized pixel, row and column writers shared by graphics.h and
+// gpu.h. Each format gets a PixelOps table, picked once at init; callers
+// clip once, then hand a whole run of pixels to one of these. Loops that
+// are not hand-tuned are generated per format by SPAN_DEFINE_FORMAT from
+// the format's load/store pair, so no inner loop tests the pixel format.
+// ============================================================================
+
+// Fill `count` pixels of `row` starting at pixel `x` (no clipping).
+typedef void (*SpanFillFn)(uint8_t* row, int32_t x, uint32_t count, Color color);
+
+// Convert `count` 32-bit pixels from `src` into `row` starting at pixel `x`.
+typedef void (*SpanCopyFn)(uint8_t* row, int32_t x, const uint32_t* src, uint32_t count);
+
+// Fill `count` pixels of column `x` going down from `row`, `pitch` bytes apart.
+typedef void (*SpanColumnFn)(uint8_t* row, int32_t x, uint32_t pitch, uint32_t count, Color color);
+
+// Blend `count` premultiplied 32-bit pixels from `src` over `row` from pixel `x`.
+typedef void (*SpanBlendFn)(uint8_t* row, int32_t x, const uint32_t* src, uint32_t count);
+
+// Single pixels (no clipping)
+typedef void (*SpanPutFn)(uint8_t* row, int32_t x, Color color);
+typedef Color (*SpanGetFn)(const uint8_t* row, int32_t x);
+
+typedef struct {
+    uint8_t      bpp;
+    SpanFillFn   fill;
+    SpanCopyFn   copy;
+    SpanColumnFn column;
+    SpanBlendFn  blend;
+    SpanPutFn    put;
+    SpanGetFn    get;
+} PixelOps;
+
+// Per-pixel loops from a format's span_load_<fmt>/span_store_<fmt> and
+// its ops table. Fill and, for 32 bpp, copy and blend are written by hand.
+#define SPAN_DEFINE_FORMAT(fmt, BPP, FILL, COPY, BLEND)                                         \
+    static inline void span_put_##fmt(uint8_t* row, int32_t x, Color color) {                  \
+        span_store_##fmt(row + x * ((BPP) / 8), color);                                         \
+    }                                                                                           \
+    static inline Color span_get_##fmt(const uint8_t* row, int32_t x) {                         \
+        return span_load_##fmt(row + x * ((BPP) / 8));                                          \
+    }                                                                                           \
+    static inline void span_copy_##fmt(uint8_t* row, int32_t x, const uint32_t* src, uint32_t count) { \
+        uint8_t* p = row + x * ((BPP) / 8);                                                     \
+        for (; count; count--, p += (BPP) / 8) span_store_##fmt(p, *src++);                     \
+    }                                                                                           \
+    static inline void span_column_##fmt(uint8_t* row, int32_t x, uint32_t pitch, uint32_t count, Color color) { \
+        uint8_t* p = row + x * ((BPP) / 8);                                                     \
+        for (; count; count--, p += pitch) span_store_##fmt(p, color);                          \
+    }                                                                                           \
+    static inline void span_blend_##fmt(uint8_t* row, int32_t x, const uint32_t* src, uint32_t count) { \
+        uint8_t* p = row + x * ((BPP) / 8);                                                     \
+        for (; count; count--, p += (BPP) / 8) {                                                \
+            uint32_t s = *src++;                                                                \
+            if (s >> 24 == 255) span_store_##fmt(p, s);                                         \
+            else if (s >> 24) span_store_##fmt(p, blend_pixel(s, span_load_##fmt(p)));          \
+        }                                                                                       \
+    }                                                                                           \
+    static const PixelOps g_span_ops_##fmt = {                                                  \
+        BPP, FILL, COPY, span_column_##fmt, BLEND, span_put_##fmt, span_get_##fmt,              \
+    };
+
+// ---------- XRGB8888 ----------
+static inline void span_store_xrgb8888(uint8_t* p, Color color) {
+    *(uint32_t*)p = color;
+}
+
+static inline Color span_load_xrgb8888(const uint8_t* p) {
+    return *(const uint32_t*)p;
+}
+
+static inline void span_fill_xrgb8888(uint8_t* row, int32_t x, uint32_t count, Color color) {
+    uint32_t* p = (uint32_t*)row + x;
+    while (count--) *p++ = color;
+}
+
+// Rows are the source format: the wide copy and blend kernels apply
+static inline void span_copy32_xrgb8888(uint8_t* row, int32_t x, const uint32_t* src, uint32_t count) {
+    g_memops.copy32((uint32_t*)row + x, src, count);
+}
+
+static inline void span_blend32_xrgb8888(uint8_t* row, int32_t x, const uint32_t* src, uint32_t count) {
+    g_blend_row((uint32_t*)row + x, src, count, 255);
+}
+
+SPAN_DEFINE_FORMAT(xrgb8888, 32, span_fill_xrgb8888, span_copy32_xrgb8888, span_blend32_xrgb8888)
+
+// ---------- RGB888 ----------
+static inline void span_store_rgb888(uint8_t* p, Color color) {
+    p[0] = GET_B(color);
+    p[1] = GET_G(color);
+    p[2] = GET_R(color);
+}
+
+static inline Color span_load_rgb888(const uint8_t* p) {
+    return RGB(p[2], p[1], p[0]);
+}
+
+static inline void span_fill_rgb888(uint8_t* row, int32_t x, uint32_t count, Color color) {
+    uint8_t* p = row + x * 3;
+    uint8_t b = GET_B(color);
+    uint8_t g = GET_G(color);
+    uint8_t r = GET_R(color);
+
+    // Four pixels are exactly three 32-bit words: B G R B | G R B G | R B G R
+    if (count >= 8) {
+        while ((uintptr_t)p & 3) {
+            p[0] = b; p[1] = g; p[2] = r;
+            p += 3;
+            count--;
+        }
+        uint32_t w0 = b | (g << 8) | (r << 16) | ((uint32_t)b << 24);
+        uint32_t w1 = g | (r << 8) | (b << 16) | ((uint32_t)g << 24);
+        uint32_t w2 = r | (b << 8) | (g << 16) | ((uint32_t)r << 24);
+        uint32_t* w = (uint32_t*)p;
+        for (; count >= 4; count -= 4) {
+            w[0] = w0; w[1] = w1; w[2] = w2;
+            w += 3;
+        }
+        p = (uint8_t*)w;
+    }
+    while (count--) {
+        p[0] = b; p[1] = g; p[2] = r;
+        p += 3;
+    }
+}
+
+SPAN_DEFINE_FORMAT(rgb888, 24, span_fill_rgb888, span_copy_rgb888, span_blend_rgb888)
+
+// ---------- RGB565 ----------
+static inline uint16_t span_pack_rgb565(Color color) {
+    return (uint16_t)(((GET_R(color) >> 3) << 11) |
+                      ((GET_G(color) >> 2) << 5) |
+                       (GET_B(color) >> 3));
+}
+
+static inline void span_store_rgb565(uint8_t* p, Color color) {
+    *(uint16_t*)p = span_pack_rgb565(color);
+}
+
+static inline Color span_load_rgb565(const uint8_t* p) {
+    uint16_t v = *(const uint16_t*)p;
+    return RGB(((v >> 11) & 0x1F) << 3, ((v >> 5) & 0x3F) << 2, (v & 0x1F) << 3);
+}
+
+static inline void span_fill_rgb565(uint8_t* row, int32_t x, uint32_t count, Color color) {
+    uint16_t v = span_pack_rgb565(color);
+    uint16_t* p = (uint16_t*)row + x;
+
+    if (count && ((uintptr_t)p & 2)) { *p++ = v; count--; }
+    uint32_t pair = v | ((uint32_t)v << 16);
+    uint32_t* w = (uint32_t*)p;
+    for (; count >= 2; count -= 2) *w++ = pair;
+    if (count) *(uint16_t*)w = v;
+}
+
+SPAN_DEFINE_FORMAT(rgb565, 16, span_fill_rgb565, span_copy_rgb565, span_blend_rgb565)
+
+// ---------- Unsupported formats ----------
+// Drawing into an unknown format is a no-op rather than a branch per call
+static inline void span_store_none(uint8_t* p, Color color) {
+    (void)p; (void)color;
+}
+
+static inline Color span_load_none(const uint8_t* p) {
+    (void)p;
+    return 0;
+}
+
+static inline void span_fill_none(uint8_t* row, int32_t x, uint32_t count, Color color) {
+    (void)row; (void)x; (void)count; (void)color;
+}
+
+SPAN_DEFINE_FORMAT(none, 0, span_fill_none, span_copy_none, span_blend_none)
+
+// ---------- Integer upscaling ----------
+// Write `n` pixels to dst, each pixel of src repeated k times, starting
+// `phase` (< k) copies into src[0]. 2x, 3x and 4x have their own loops.
+static inline void span_repeat32(uint32_t* dst, const uint32_t* src, uint32_t n, uint32_t k, uint32_t phase) {
+    if (n == 0) return;
+    uint32_t c = *src++;
+    uint32_t first = k - phase < n ? k - phase : n;
+    for (uint32_t i = 0; i < first; i++) *dst++ = c;
+    n -= first;
+    
+    switch (k) {
+        case 2:
+            for (; n >= 2; n -= 2, dst += 2) {
+                c = *src++;
+                dst[0] = c; dst[1] = c;
+            }
+            break;
+        case 3:
+            for (; n >= 3; n -= 3, dst += 3) {
+                c = *src++;
+                dst[0] = c; dst[1] = c; dst[2] = c;
+            }
+            break;
+        case 4:
+            for (; n >= 4; n -= 4, dst += 4) {
+                c = *src++;
+                dst[0] = c; dst[1] = c; dst[2] = c; dst[3] = c;
+            }
+            break;
+        default:
+            for (; n >= k; n -= k) {
+                c = *src++;
+                for (uint32_t i = 0; i < k; i++) *dst++ = c;
+            }
+            break;
+    }
+    if (n) {
+        c = *src;
+        while (n--) *dst++ = c;
+    }
+}
+
+// ---------- Selection (done once at init time) ----------
+static inline const PixelOps* span_select(uint8_t bpp) {
+    switch (bpp) {
+        case 32: return &g_span_ops_xrgb8888;
+        case 24: return &g_span_ops_rgb888;
+        case 16: return &g_span_ops_rgb565;
+        default: return &g_span_ops_none;
+    }
+}
+
+#endif // SPAN_H
@@ -0,0 +1,398 @@
+; stage2.asm — second-stage loader, loaded to 0x1000 by boot.asm
+; Collects the boot information (E820 map, VBE mode list), sets the best
+; LFB mode under VBE_MAX_PIXELS, reads the kernel with
+; INT 13h extensions (or CHS a track at a time when the BIOS has none),
+; then switches to protected mode and calls it.
+BITS 16
+ORG 0x1000
+
+BOOTINFO equ 0x7E00
+VBEMODE  equ 0x118      ; Fallback when the mode list yields nothing
+VBEBUF   equ 0x9000     ; Controller info at +0, mode info at +0x200
+MMAPBUF  equ 0x8000     ; E820 entries, 24 bytes each
+MMAPMAX  equ 32
+VBEMODES equ 0x8800     ; VBEModeEntry table (types.h), 16 bytes each
+VBEMODEMAX     equ 64     ; Must match VBE_MODES_MAX in types.h
+VBE_MAX_PIXELS equ 1024 * 768   ; Fill-rate cap, as GPU_MODE_MAX_PIXELS in gpu_hw.h
+
+; Disk layout: LBA 0 boot.asm, LBA 1.. this file, then the kernel image
+STAGE2_SECTORS equ 4    ; Must match boot.asm
+KERNEL_LBA     equ 1 + STAGE2_SECTORS
+KERNEL_SEG     equ 0x1000                       ; 0x10000, as linked in kernel.ld
+KERNEL_MAX     equ (0x80000 - 0x10000) / 512    ; Image stays clear of the stack
+KHDR_MAGIC     equ 'KRNL'                       ; kernel_entry.asm header
+READ_CHUNK     equ 64   ; Sectors per LBA read (32 KB)
+
+start:
+    cli
+    xor ax, ax
+    mov ds, ax
+    mov es, ax
+    mov [drv], dl
+
+    ; Zero bootinfo
+    mov di, BOOTINFO
+    mov cx, 22
+    rep stosw
+    mov dword [BOOTINFO], 0x1BADB002
+    mov al, [drv]
+    mov [BOOTINFO+4], al
+
+    ; BIOS memory map (E820)
+    mov di, MMAPBUF
+    xor ebx, ebx
+    xor bp, bp
+e820:
+    mov eax, 0xE820
+    mov edx, 0x534D4150
+    mov ecx, 24
+    mov dword [di+20], 1
+    int 0x15
+    jc e820_done
+    cmp eax, 0x534D4150
+    jne e820_done
+    inc bp
+    add di, 24
+    test ebx, ebx
+    jz e820_done
+    cmp bp, MMAPMAX
+    jb e820
+e820_done:
+    mov dword [BOOTINFO+28], MMAPBUF
+    mov [BOOTINFO+32], bp
+
+    ; VBE controller info: ask for the VBE 2.0 block to get the mode list
+    mov ax, VBEBUF
+    mov es, ax
+    xor di, di
+    mov dword [es:0], 'VBE2'
+    mov ax, 0x4F00
+    int 0x10
+    cmp ax, 0x004F
+    jne vbe_fallback
+    lfs si, [es:0x0E]           ; Mode list may point into the block itself
+
+    ; Keep every LFB mode with packed/direct pixels of 16, 24 or 32 bpp
+    mov bx, VBEMODES
+vbe_scan:
+    mov cx, [fs:si]
+    add si, 2
+    cmp cx, 0xFFFF
+    je vbe_scanned
+    cmp word [vbe_count], VBEMODEMAX
+    jae vbe_scanned
+    mov di, 0x200
+    mov ax, 0x4F01
+    int 0x10
+    cmp ax, 0x004F
+    jne vbe_scan
+    mov ax, [es:0x200]
+    and ax, 0x0091              ; Supported, graphics, linear framebuffer
+    cmp ax, 0x0091
+    jne vbe_scan
+    mov al, [es:0x21B]          ; Memory model: 4 packed, 6 direct color
+    cmp al, 4
+    je .model
+    cmp al, 6
+    jne vbe_scan
+.model:
+    mov al, [es:0x219]
+    cmp al, 16
+    je .keep
+    cmp al, 24
+    je .keep
+    cmp al, 32
+    jne vbe_scan
+.keep:
+    mov [bx], cx
+    mov ax, [es:0x212]
+    mov [bx+2], ax
+    mov ax, [es:0x214]
+    mov [bx+4], ax
+    mov ax, [es:0x210]
+    mov [bx+6], ax
+    mov al, [es:0x219]
+    mov [bx+8], al
+    mov al, [es:0x21B]
+    mov [bx+9], al
+    mov word [bx+10], 0
+    mov eax, [es:0x228]
+    mov [bx+12], eax
+    add bx, 16
+    inc word [vbe_count]
+    jmp vbe_scan
+
+vbe_scanned:
+    mov dword [BOOTINFO+36], VBEMODES
+    mov ax, [vbe_count]
+    mov [BOOTINFO+40], ax
+
+    ; Same policy as gpu_pick_mode: highest (32 bpp, packed pitch, pixels)
+    ; under the cap
+    xor edx, edx
+    xor di, di
+    mov bx, VBEMODES
+    mov cx, [vbe_count]
+.pick:
+    jcxz .picked
+    movzx eax, word [bx+2]
+    movzx ebp, word [bx+4]
+    imul eax, ebp
+    cmp eax, VBE_MAX_PIXELS
+    ja .next
+    cmp byte [bx+8], 32
+    jne .pitch
+    or eax, 0x80000000
+.pitch:
+    mov bp, [bx+2]
+    shl bp, 2
+    cmp bp, [bx+6]
+    jne .scored
+    or eax, 0x40000000
+.scored:
+    cmp eax, edx
+    jbe .next
+    mov edx, eax
+    mov di, bx
+.next:
+    add bx, 16
+    dec cx
+    jmp .pick
+.picked:
+    test di, di
+    jz vbe_fallback
+
+    mov bx, [di]
+    or bx, 0x4000
+    mov ax, 0x4F02
+    int 0x10
+    cmp ax, 0x004F
+    jne vbe_fallback
+    mov ax, [di]
+    mov [BOOTINFO+42], ax
+    mov eax, [di+12]
+    mov [BOOTINFO+16], eax
+    mov ax, [di+6]
+    mov [BOOTINFO+20], ax
+    mov ax, [di+2]
+    mov [BOOTINFO+22], ax
+    mov ax, [di+4]
+    mov [BOOTINFO+24], ax
+    mov al, [di+8]
+    mov [BOOTINFO+26], al
+    mov byte [BOOTINFO+27], 1
+    jmp vbe_done
+
+vbe_fallback:
+    ; VBE get mode info
+    mov ax, VBEBUF
+    mov es, ax
+    xor di, di
+    mov ax, 0x4F01
+    mov cx, VBEMODE
+    int 0x10
+    cmp ax, 0x004F
+    jne er
+
+    ; VBE set mode
+    mov ax, 0x4F02
+    mov bx, VBEMODE | 0x4000
+    int 0x10
+    cmp ax, 0x004F
+    jne er
+
+    ; Copy VBE info
+    mov word [BOOTINFO+42], VBEMODE
+    mov eax, [es:0x28]
+    mov [BOOTINFO+16], eax
+    mov ax, [es:0x10]
+    mov [BOOTINFO+20], ax
+    mov ax, [es:0x12]
+    mov [BOOTINFO+22], ax
+    mov ax, [es:0x14]
+    mov [BOOTINFO+24], ax
+    mov al, [es:0x19]
+    mov [BOOTINFO+26], al
+    mov byte [BOOTINFO+27], 1
+vbe_done:
+
+    ; Load kernel: the first sector carries the image size
+    call disk_init
+    mov eax, KERNEL_LBA
+    mov cx, 1
+    mov bx, KERNEL_SEG
+    call read_sectors
+
+    mov ax, KERNEL_SEG
+    mov es, ax
+    cmp dword [es:8], KHDR_MAGIC
+    jne er
+    mov eax, [es:12]
+    add eax, 511
+    shr eax, 9
+    jz er
+    cmp eax, KERNEL_MAX
+    ja er
+    mov [BOOTINFO+12], eax
+
+    mov cx, ax
+    dec cx
+    mov eax, KERNEL_LBA + 1
+    mov bx, KERNEL_SEG + 512 / 16
+    call read_sectors
+
+    mov dword [BOOTINFO+8], 0x10000
+
+    ; Protected mode
+    cli
+    lgdt [gdt_desc]
+    mov eax, cr0
+    or al, 1
+    mov cr0, eax
+    jmp 0x08:pm
+
+er: mov al, 'E'
+    mov ah, 0x0E
+    int 0x10
+    hlt
+    jmp er
+
+; ---------------------------------------------------------------------------
+; disk_init: pick LBA reads if the BIOS has the extensions, otherwise get
+; the CHS geometry
+; ---------------------------------------------------------------------------
+disk_init:
+    mov ah, 0x41
+    mov bx, 0x55AA
+    mov dl, [drv]
+    int 0x13
+    jc .chs
+    cmp bx, 0xAA55
+    jne .chs
+    test cl, 1                  ; Packet (AH=42h) calls supported
+    jz .chs
+    mov byte [use_lba], 1
+    ret
+.chs:
+    push es
+    xor di, di
+    mov es, di
+    mov ah, 0x08
+    mov dl, [drv]
+    int 0x13
+    pop es
+    jc .floppy
+    and cl, 0x3F
+    jz .floppy
+    mov [spt], cl
+    movzx ax, dh
+    inc ax
+    mov [heads], ax
+    ret
+.floppy:
+    ; 1.44 MB geometry
+    mov byte [spt], 18
+    mov word [heads], 2
+    ret
+
+; ---------------------------------------------------------------------------
+; read_sectors: EAX = first LBA, CX = count, BX = destination segment
+; (offset 0). Halts with 'E' on a disk error.
+; ---------------------------------------------------------------------------
+read_sectors:
+.next:
+    test cx, cx
+    jz .done
+    mov di, cx
+    cmp di, READ_CHUNK
+    jbe .sized
+    mov di, READ_CHUNK
+.sized:
+    cmp byte [use_lba], 0
+    je .chs
+
+    mov [dap_count], di
+    mov [dap_seg], bx
+    mov [dap_lba], eax
+    pushad
+    mov si, dap
+    mov ah, 0x42
+    mov dl, [drv]
+    int 0x13
+    popad
+    jc er
+    jmp .advance
+
+.chs:
+    ; sector = LBA % spt + 1, head = track % heads, cylinder = track / heads
+    pushad
+    mov es, bx
+    xor edx, edx
+    movzx ecx, byte [spt]
+    div ecx                     ; EAX = track, DX = sector - 1
+    sub cx, dx                  ; Sectors left on this track
+    cmp di, cx
+    jbe .in_track
+    mov di, cx
+.in_track:
+    mov [chunk], di
+    mov cl, dl
+    inc cl
+    xor edx, edx
+    movzx ebx, word [heads]
+    div ebx                     ; EAX = cylinder, DL = head
+    mov dh, dl
+    mov ch, al
+    shl ah, 6
+    or cl, ah                   ; Cylinder bits 8-9 in sector bits 6-7
+    mov ax, di
+    mov ah, 0x02
+    mov dl, [drv]
+    xor bx, bx
+    int 0x13
+    popad
+    jc er
+    mov di, [chunk]
+
+.advance:
+    movzx edx, di
+    add eax, edx
+    sub cx, di
+    shl di, 5                   ; Sectors to paragraphs
+    add bx, di
+    jmp .next
+.done:
+    ret
+
+drv:     db 0
+use_lba: db 0
+spt:     db 0
+heads:   dw 0
+chunk:   dw 0
+vbe_count: dw 0
+
+; INT 13h AH=42h disk address packet
+align 4
+dap:       db 16, 0
+dap_count: dw 0
+dap_off:   dw 0
+dap_seg:   dw 0
+dap_lba:   dd 0, 0
+
+gdt: dq 0, 0x00CF9A000000FFFF, 0x00CF92000000FFFF
+gdt_desc: dw 23
+          dd gdt
+
+BITS 32
+pm: mov ax, 0x10
+    mov ds, ax
+    mov es, ax
+    mov ss, ax
+    mov fs, ax
+    mov gs, ax
+    mov esp, 0x90000
+    call 0x10000
+.h: hlt
+    jmp .h
+
+times STAGE2_SECTORS * 512 - ($-$$) db 0
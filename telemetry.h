@@ -0,0 +1,138 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include "cpu.h"
+#include "timer.h"
+#include "serial.h"
+
+// ============================================================================
+// TELEMETRY FOR MINI-OS
+// Fixed-size binary records queued by the render loop in a lock-free
+// single-producer/single-consumer ring and drained to COM1 while idle.
+// Capture headless with QEMU `-serial file:telemetry.bin`.
+//
+// Stream format: back-to-back 32-byte little-endian TelemetryRecords.
+// Resync on TELEMETRY_MAGIC if the capture starts mid-record.
+// Text output (serial_write) shares the port; don't mix the two.
+// ============================================================================
+
+#define TELEMETRY_MAGIC     0x4D54  // "TM"
+
+// Ring size in bytes (power of two, whole records)
+#define TELEMETRY_RING_SIZE 8192
+
+typedef enum {
+    TELEMETRY_FRAME = 1,    // id = frame number, values = see telemetry_frame
+    TELEMETRY_COUNTER = 2,  // id = counter id, values = caller defined
+} TelemetryType;
+
+typedef struct __attribute__((packed)) {
+    uint16_t magic;
+    uint8_t  type;          // TelemetryType
+    uint8_t  dropped;       // Records lost to a full ring before this one (saturates)
+    uint32_t timestamp_us;  // timer_us() when queued (low 32 bits)
+    uint32_t id;
+    uint32_t values[5];
+} TelemetryRecord;
+
+typedef struct {
+    volatile uint32_t head; // Bytes written (producer only)
+    volatile uint32_t tail; // Bytes sent (consumer only)
+    uint32_t dropped;       // Records lost since the last one queued
+    uint8_t  enabled;
+    uint8_t  data[TELEMETRY_RING_SIZE];
+} TelemetryRing;
+
+static TelemetryRing g_telemetry;
+
+// Keep the compiler from moving ring stores across the index update;
+// x86 does not reorder stores with other stores.
+#define TELEMETRY_BARRIER() __asm__ volatile ("" ::: "memory")
+
+// ---------- Producer ----------
+static inline int telemetry_push(uint8_t type, uint32_t id, const uint32_t values[5]) {
+    if (!g_telemetry.enabled) return 0;
+
+    uint32_t head = g_telemetry.head;
+    if (head - g_telemetry.tail > TELEMETRY_RING_SIZE - sizeof(TelemetryRecord)) {
+        g_telemetry.dropped++;
+        return 0;
+    }
+
+    // Records never straddle the wrap point: the size divides the ring
+    TelemetryRecord* rec = (TelemetryRecord*)&g_telemetry.data[head & (TELEMETRY_RING_SIZE - 1)];
+    rec->magic = TELEMETRY_MAGIC;
+    rec->type = type;
+    rec->dropped = g_telemetry.dropped > 255 ? 255 : (uint8_t)g_telemetry.dropped;
+    rec->timestamp_us = (uint32_t)timer_us();
+    rec->id = id;
+    for (int i = 0; i < 5; i++) rec->values[i] = values[i];
+    g_telemetry.dropped = 0;
+
+    TELEMETRY_BARRIER();
+    g_telemetry.head = head + sizeof(TelemetryRecord);
+    return 1;
+}
+
+// Per-frame stage timings in microseconds plus pixels recomposited
+static inline void telemetry_frame(uint32_t frame, uint32_t frame_us, uint32_t composite_us,
+                                   uint32_t vsync_us, uint32_t present_us, uint32_t damaged_pixels) {
+    uint32_t values[5] = { frame_us, composite_us, vsync_us, present_us, damaged_pixels };
+    telemetry_push(TELEMETRY_FRAME, frame, values);
+}
+
+static inline void telemetry_counter(uint32_t id, uint32_t v0, uint32_t v1, uint32_t v2) {
+    uint32_t values[5] = { v0, v1, v2, 0, 0 };
+    telemetry_push(TELEMETRY_COUNTER, id, values);
+}
+
+// ---------- Consumer ----------
+// Hand the UART whatever its FIFO takes right now; never waits
+static inline void telemetry_drain(void) {
+    uint32_t tail = g_telemetry.tail;
+    uint32_t pending = g_telemetry.head - tail;
+    TELEMETRY_BARRIER();
+
+    while (pending) {
+        uint32_t offset = tail & (TELEMETRY_RING_SIZE - 1);
+        uint32_t run = TELEMETRY_RING_SIZE - offset;
+        if (run > pending) run = pending;
+        uint32_t sent = serial_write_fifo(&g_telemetry.data[offset], run);
+        if (!sent) break;
+        tail += sent;
+        pending -= sent;
+    }
+
+    TELEMETRY_BARRIER();
+    g_telemetry.tail = tail;
+}
+
+// Send everything still queued (e.g. before shutdown)
+static inline void telemetry_flush(void) {
+    while (g_telemetry.enabled && g_telemetry.head != g_telemetry.tail) {
+        telemetry_drain();
+        __asm__ volatile ("pause");
+    }
+}
+
+// ---------- Setup ----------
+// Open COM1 and start draining from cpu_idle. Returns -1 with no UART.
+static inline int telemetry_init(void) {
+    g_telemetry.head = 0;
+    g_telemetry.tail = 0;
+    g_telemetry.dropped = 0;
+    g_telemetry.enabled = 0;
+
+    if (!serial_is_ready() && serial_init() != 0) return -1;
+
+    g_telemetry.enabled = 1;
+    cpu_set_idle_hook(telemetry_drain);
+    return 0;
+}
+
+static inline int telemetry_is_enabled(void) {
+    return g_telemetry.enabled;
+}
+
+#endif // TELEMETRY_H
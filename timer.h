@@ -0,0 +1,130 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+#include "cpu.h"
+#include "pci.h"
+
+// ============================================================================
+// HIGH-RESOLUTION TIMING FOR MINI-OS
+// TSC calibrated against PIT channel 2 at boot; monotonic ns/us/ms clocks
+// ============================================================================
+
+// PIT (8253/8254) ports
+#define PIT_CHANNEL2        0x42
+#define PIT_COMMAND         0x43
+#define PIT_GATE_PORT       0x61    // Bit 0 = channel 2 gate, bit 5 = OUT2
+#define PIT_FREQUENCY       1193182
+
+// Calibration window
+#define TIMER_CALIBRATE_MS  20
+
+// Cycles-to-ns multiplier is ns per cycle in Q24 fixed point
+#define TIMER_SHIFT         24
+
+typedef struct {
+    uint8_t  ready;         // TSC calibrated
+    uint32_t tsc_khz;       // TSC frequency in kHz
+    uint32_t mult_ns;       // ns per TSC cycle, Q24
+    uint64_t tsc_base;      // TSC at timer_init (time zero)
+} Timer;
+
+static Timer g_timer;
+
+// ---------- 64-bit helpers ----------
+// -nostdlib leaves no __udivdi3, so divide with two 32-bit divl steps
+static inline uint64_t udiv64_32(uint64_t n, uint32_t d) {
+    uint32_t hi = (uint32_t)(n >> 32);
+    uint32_t lo = (uint32_t)n;
+    uint32_t q_hi = hi / d;
+    uint32_t q_lo, r;
+    hi %= d;
+    __asm__ ("divl %4" : "=a"(q_lo), "=d"(r) : "a"(lo), "d"(hi), "rm"(d));
+    (void)r;
+    return ((uint64_t)q_hi << 32) | q_lo;
+}
+
+// ---------- Calibration ----------
+// Count TSC cycles across a PIT channel 2 one-shot of TIMER_CALIBRATE_MS
+static inline uint64_t timer_measure_tsc_window(void) {
+    uint16_t count = (uint16_t)(PIT_FREQUENCY * TIMER_CALIBRATE_MS / 1000);
+    
+    // Gate on, speaker off; channel 2, lobyte/hibyte, mode 0 (one-shot)
+    uint8_t gate = (inb(PIT_GATE_PORT) & ~0x02) | 0x01;
+    outb(PIT_GATE_PORT, gate);
+    outb(PIT_COMMAND, 0xB0);
+    outb(PIT_CHANNEL2, count & 0xFF);
+    outb(PIT_CHANNEL2, count >> 8);
+    
+    uint64_t start = rdtsc();
+    while (!(inb(PIT_GATE_PORT) & 0x20));
+    return rdtsc() - start;
+}
+
+static inline void timer_init(void) {
+    if (g_timer.ready) return;
+    cpu_init();
+    if (!g_cpu.has_tsc) return;
+    
+    // Take the shortest of a few windows to drop SMI/VM-exit outliers
+    uint64_t best = timer_measure_tsc_window();
+    for (int i = 0; i < 2; i++) {
+        uint64_t c = timer_measure_tsc_window();
+        if (c < best) best = c;
+    }
+    
+    g_timer.tsc_khz = (uint32_t)udiv64_32(best, TIMER_CALIBRATE_MS);
+    if (g_timer.tsc_khz == 0) return;
+    g_timer.mult_ns = (uint32_t)udiv64_32((uint64_t)1000000 << TIMER_SHIFT, g_timer.tsc_khz);
+    g_timer.tsc_base = rdtsc();
+    g_timer.ready = 1;
+}
+
+static inline int timer_is_ready(void) {
+    return g_timer.ready;
+}
+
+static inline uint32_t timer_get_tsc_khz(void) {
+    return g_timer.tsc_khz;
+}
+
+// ---------- Conversions ----------
+static inline uint64_t timer_cycles_to_ns(uint64_t cycles) {
+    uint32_t lo = (uint32_t)cycles;
+    uint32_t hi = (uint32_t)(cycles >> 32);
+    return (((uint64_t)lo * g_timer.mult_ns) >> TIMER_SHIFT) +
+           (((uint64_t)hi * g_timer.mult_ns) << (32 - TIMER_SHIFT));
+}
+
+// ---------- Monotonic clocks (0 until timer_init succeeds) ----------
+static inline uint64_t timer_ns(void) {
+    if (!g_timer.ready) return 0;
+    return timer_cycles_to_ns(rdtsc() - g_timer.tsc_base);
+}
+
+static inline uint64_t timer_us(void) {
+    return udiv64_32(timer_ns(), 1000);
+}
+
+static inline uint32_t timer_ms(void) {
+    return (uint32_t)udiv64_32(timer_ns(), 1000000);
+}
+
+// Microseconds between two timer_ns() readings, saturated to 32 bits
+static inline uint32_t timer_ns_to_us(uint64_t ns) {
+    uint64_t us = udiv64_32(ns, 1000);
+    return us > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)us;
+}
+
+// ---------- Delays ----------
+static inline void timer_delay_ns(uint64_t ns) {
+    if (!g_timer.ready) return;
+    uint64_t end = timer_ns() + ns;
+    while (timer_ns() < end) cpu_idle();
+}
+
+static inline void timer_delay_us(uint32_t us) {
+    timer_delay_ns((uint64_t)us * 1000);
+}
+
+#endif // TIMER_H
@@ -0,0 +1,248 @@
+#!/usr/bin/env python3
+"""png2sprite.py - convert PNG files to the kernel's native sprite format.
+
+Usage: png2sprite.py -o assets.bin [name=]image.png ...
+
+Each image becomes one asset (layout in asset.h): a 64-byte header, the
+premultiplied ARGB pixels (16-byte aligned, one row after another), the
+per-row run offsets and the opaque/blended runs used by gpu_blit_sprite_rle.
+Assets are concatenated; compile-and-run.sh wraps the result in an object
+whose data lands in .rodata.assets, between __assets_start and
+__assets_end (kernel.ld). The name defaults to the file name without
+extension.
+"""
+
+import argparse
+import os
+import struct
+import sys
+import zlib
+
+ASSET_MAGIC = 0x54525053        # 'SPRT'
+ASSET_NAME_MAX = 24             # Including the NUL
+HEADER_SIZE = 64
+RUN_COPY = 0
+RUN_BLEND = 1
+
+
+# ---------- PNG decoding ----------
+def paeth(a, b, c):
+    p = a + b - c
+    pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+    if pa <= pb and pa <= pc:
+        return a
+    return b if pb <= pc else c
+
+
+def unfilter(data, width, height, bpp, row_bytes):
+    rows = []
+    prev = bytearray(row_bytes)
+    pos = 0
+    for _ in range(height):
+        kind = data[pos]
+        row = bytearray(data[pos + 1:pos + 1 + row_bytes])
+        pos += 1 + row_bytes
+        for i in range(row_bytes):
+            left = row[i - bpp] if i >= bpp else 0
+            up = prev[i]
+            if kind == 1:
+                row[i] = (row[i] + left) & 0xFF
+            elif kind == 2:
+                row[i] = (row[i] + up) & 0xFF
+            elif kind == 3:
+                row[i] = (row[i] + ((left + up) >> 1)) & 0xFF
+            elif kind == 4:
+                upleft = prev[i - bpp] if i >= bpp else 0
+                row[i] = (row[i] + paeth(left, up, upleft)) & 0xFF
+            elif kind != 0:
+                raise ValueError("bad filter type %d" % kind)
+        rows.append(row)
+        prev = row
+    return rows
+
+
+def samples(row, width, depth, channels):
+    """Unpack one row into integer samples scaled to 8 bits (palette indices unscaled)."""
+    if depth == 8:
+        return list(row[:width * channels])
+    if depth == 16:
+        return [row[i] for i in range(0, width * channels * 2, 2)]
+    out = []
+    mask = (1 << depth) - 1
+    for byte in row:
+        for shift in range(8 - depth, -1, -depth):
+            out.append((byte >> shift) & mask)
+    return out[:width * channels]
+
+
+def decode_png(path):
+    """Returns (width, height, straight ARGB pixels as ints)."""
+    with open(path, "rb") as f:
+        blob = f.read()
+    if blob[:8] != b"\x89PNG\r\n\x1a\n":
+        raise ValueError("not a PNG file")
+
+    pos = 8
+    idat = bytearray()
+    palette = []
+    trns = None
+    width = height = depth = ctype = interlace = None
+    while pos < len(blob):
+        length, kind = struct.unpack(">I4s", blob[pos:pos + 8])
+        body = blob[pos + 8:pos + 8 + length]
+        pos += 12 + length
+        if kind == b"IHDR":
+            width, height, depth, ctype, _, _, interlace = struct.unpack(">IIBBBBB", body)
+        elif kind == b"PLTE":
+            palette = [tuple(body[i:i + 3]) for i in range(0, len(body), 3)]
+        elif kind == b"tRNS":
+            trns = body
+        elif kind == b"IDAT":
+            idat += body
+        elif kind == b"IEND":
+            break
+    if width is None:
+        raise ValueError("missing IHDR")
+    if interlace:
+        raise ValueError("interlaced PNGs are not supported")
+
+    channels = {0: 1, 2: 3, 3: 1, 4: 2, 6: 4}.get(ctype)
+    if channels is None:
+        raise ValueError("bad color type %d" % ctype)
+    bits = depth * channels
+    bpp = max(1, bits // 8)
+    row_bytes = (width * bits + 7) // 8
+    rows = unfilter(zlib.decompress(bytes(idat)), width, height, bpp, row_bytes)
+
+    # Low-depth gray scales up to 8 bits; palette indices stay as they are
+    gray_scale = 255 // ((1 << depth) - 1) if ctype == 0 and depth < 8 else 1
+    key = None
+    if trns is not None and ctype == 0:
+        key = (struct.unpack(">H", trns[:2])[0] >> (8 if depth == 16 else 0)) * gray_scale
+    elif trns is not None and ctype == 2:
+        key = tuple(v >> 8 if depth == 16 else v for v in struct.unpack(">HHH", trns[:6]))
+
+    pixels = []
+    for row in rows:
+        s = samples(row, width, depth, channels)
+        for x in range(width):
+            if ctype == 0:
+                r = g = b = s[x] * gray_scale
+                a = 0 if r == key else 255
+            elif ctype == 2:
+                r, g, b = s[3 * x:3 * x + 3]
+                a = 0 if (r, g, b) == key else 255
+            elif ctype == 3:
+                i = s[x]
+                r, g, b = palette[i]
+                a = trns[i] if trns is not None and i < len(trns) else 255
+            elif ctype == 4:
+                g, a = s[2 * x:2 * x + 2]
+                r, b = g, g
+            else:
+                r, g, b, a = s[4 * x:4 * x + 4]
+            pixels.append((a << 24) | (r << 16) | (g << 8) | b)
+    return width, height, pixels
+
+
+# ---------- Native sprite format ----------
+def div255(x):
+    # blend_div255 in blend.h
+    x += 128
+    return (x + (x >> 8)) >> 8
+
+
+def premultiply(c):
+    a = c >> 24
+    r = div255(((c >> 16) & 0xFF) * a)
+    g = div255(((c >> 8) & 0xFF) * a)
+    b = div255((c & 0xFF) * a)
+    return (a << 24) | (r << 16) | (g << 8) | b
+
+
+def run_type(pixel):
+    a = pixel >> 24
+    return None if a == 0 else RUN_COPY if a == 255 else RUN_BLEND
+
+
+def scan_runs(pixels, width, height):
+    """Same runs as gpu_sprite_scan_row: (x, len, type), transparent skipped."""
+    row_start, runs = [], []
+    for y in range(height):
+        row_start.append(len(runs))
+        row = pixels[y * width:(y + 1) * width]
+        x = 0
+        while x < width:
+            kind = run_type(row[x])
+            start = x
+            while x < width and run_type(row[x]) == kind:
+                x += 1
+            if kind is not None:
+                runs.append((start, x - start, kind))
+    row_start.append(len(runs))
+    return row_start, runs
+
+
+def align(n, a):
+    return (n + a - 1) & ~(a - 1)
+
+
+def encode_asset(name, width, height, straight):
+    if width > 0xFFFF or height > 0xFFFF:
+        raise ValueError("sprite too large")
+    pixels = [premultiply(c) for c in straight]
+    row_start, runs = scan_runs(pixels, width, height)
+    opaque = sum(n for _, n, t in runs if t == RUN_COPY)
+    blended = sum(n for _, n, t in runs if t == RUN_BLEND)
+
+    pixels_offset = HEADER_SIZE
+    row_start_offset = pixels_offset + 4 * width * height
+    runs_offset = row_start_offset + 4 * (height + 1)
+    size = align(runs_offset + 6 * len(runs), 16)
+
+    raw = name.encode("ascii")
+    if len(raw) >= ASSET_NAME_MAX:
+        raise ValueError("name longer than %d characters" % (ASSET_NAME_MAX - 1))
+
+    out = bytearray()
+    out += struct.pack("<II", ASSET_MAGIC, size)
+    out += raw.ljust(ASSET_NAME_MAX, b"\0")
+    out += struct.pack("<HHIIIIIII", width, height, len(runs), opaque, blended,
+                       pixels_offset, row_start_offset, runs_offset, 0)
+    assert len(out) == HEADER_SIZE
+    out += struct.pack("<%dI" % len(pixels), *pixels)
+    out += struct.pack("<%dI" % len(row_start), *row_start)
+    for x, n, t in runs:
+        out += struct.pack("<HHH", x, n, t)
+    out += bytes(size - len(out))
+    return bytes(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Convert PNGs to native sprite assets")
+    parser.add_argument("-o", "--output", required=True, help="asset blob to write")
+    parser.add_argument("images", nargs="*", help="[name=]file.png")
+    args = parser.parse_args()
+
+    blob = bytearray()
+    names = set()
+    for spec in args.images:
+        name, _, path = spec.rpartition("=")
+        if not name:
+            name = os.path.splitext(os.path.basename(path))[0]
+        if name in names:
+            sys.exit("png2sprite: duplicate asset name '%s'" % name)
+        names.add(name)
+        try:
+            width, height, pixels = decode_png(path)
+            blob += encode_asset(name, width, height, pixels)
+        except (OSError, ValueError, zlib.error) as e:
+            sys.exit("png2sprite: %s: %s" % (path, e))
+        print("  %-23s %4dx%-4d" % (name, width, height))
+
+    with open(args.output, "wb") as f:
+        f.write(blob)
+
+
+if __name__ == "__main__":
+    main()
@@ -13,18 +13,52 @@ struct BootInfo {
     uint8_t  boot_drive;
     uint8_t  _pad[3];
     uint32_t kernel_phys;
-    uint32_t kernel_sectors;
+    uint32_t kernel_sectors;    // Loaded by stage2.asm (size from the image header)
     uint32_t fb_addr;
     uint16_t fb_pitch;
     uint16_t fb_width;
     uint16_t fb_height;
     uint8_t  fb_bpp;
     uint8_t  fb_type;
+    uint32_t mmap_addr;     // E820 entries collected by boot.asm
+    uint32_t mmap_count;
+    uint32_t vbe_modes_addr;    // VBEModeEntry table collected by stage2.asm
+    uint16_t vbe_mode_count;
+    uint16_t vbe_mode;          // VBE mode number that was set
 };
 
 #define BOOTINFO_ADDR 0x00007E00
 #define BOOTINFO ((struct BootInfo*)BOOTINFO_ADDR)
 
+// ---------- BIOS E820 memory map ----------
+#define E820_USABLE       1
+#define E820_RESERVED     2
+#define E820_ACPI         3
+#define E820_NVS          4
+#define E820_BAD          5
+
+struct __attribute__((packed)) E820Entry {
+    uint64_t base;
+    uint64_t length;
+    uint32_t type;
+    uint32_t acpi;          // ACPI 3.0 extended attributes (bit 0 = valid)
+};
+
+// ---------- VBE mode list ----------
+// LFB modes the BIOS offered with 16/24/32 bpp packed or direct-color pixels
+#define VBE_MODES_MAX     64
+
+struct __attribute__((packed)) VBEModeEntry {
+    uint16_t mode;
+    uint16_t width;
+    uint16_t height;
+    uint16_t pitch;
+    uint8_t  bpp;
+    uint8_t  memory_model;  // 4 = packed pixel, 6 = direct color
+    uint16_t _pad;
+    uint32_t lfb;           // Physical framebuffer address
+};
+
 // ---------- Color type ----------
 typedef uint32_t Color;
 
@@ -0,0 +1,576 @@
+#ifndef VIRTIO_GPU_H
+#define VIRTIO_GPU_H
+
+#include "types.h"
+#include "cpu.h"
+#include "pci.h"
+#include "pmm.h"
+#include "paging.h"
+#include "memops.h"
+
+// ============================================================================
+// VIRTIO-GPU DRIVER FOR MINI-OS
+// Modern (virtio 1.0) PCI transport, 2D only. The back buffer in RAM is
+// attached to a host resource as its guest backing, so presenting a
+// rect is TRANSFER_TO_HOST_2D + RESOURCE_FLUSH of that rect: the host
+// copies, not the CPU. Commands are batched on the control queue and
+// polled to completion; there is no interrupt. The cursor has its own
+// 64x64 resource on the cursor queue.
+// ============================================================================
+
+// ---------- PCI transport ----------
+#define VIRTIO_GPU_DEVICE_ID    0x1050      // 0x1040 + device type 16
+
+// virtio_pci_cap.cfg_type
+#define VIRTIO_PCI_CAP_COMMON   1
+#define VIRTIO_PCI_CAP_NOTIFY   2
+#define VIRTIO_PCI_CAP_DEVICE   4
+
+// Device status bits
+#define VIRTIO_STATUS_ACKNOWLEDGE   0x01
+#define VIRTIO_STATUS_DRIVER        0x02
+#define VIRTIO_STATUS_DRIVER_OK     0x04
+#define VIRTIO_STATUS_FEATURES_OK   0x08
+#define VIRTIO_STATUS_FAILED        0x80
+
+#define VIRTIO_F_VERSION_1      (1u << 0)   // Feature bit 32: high word, bit 0
+
+// Common configuration structure (cfg_type 1)
+typedef struct __attribute__((packed)) {
+    uint32_t device_feature_select;
+    uint32_t device_feature;
+    uint32_t driver_feature_select;
+    uint32_t driver_feature;
+    uint16_t msix_config;
+    uint16_t num_queues;
+    uint8_t  device_status;
+    uint8_t  config_generation;
+    uint16_t queue_select;
+    uint16_t queue_size;
+    uint16_t queue_msix_vector;
+    uint16_t queue_enable;
+    uint16_t queue_notify_off;
+    uint64_t queue_desc;
+    uint64_t queue_driver;
+    uint64_t queue_device;
+} VirtioCommonCfg;
+
+// ---------- Split virtqueues ----------
+#define VIRTQ_SIZE              16          // Descriptors per queue (we need few)
+#define VIRTQ_DESC_F_NEXT       1
+#define VIRTQ_DESC_F_WRITE      2
+#define VIRTQ_TIMEOUT           10000000
+
+typedef struct __attribute__((packed)) {
+    uint64_t addr;
+    uint32_t len;
+    uint16_t flags;
+    uint16_t next;
+} VirtqDesc;
+
+typedef struct __attribute__((packed)) {
+    uint16_t flags;
+    uint16_t idx;
+    uint16_t ring[VIRTQ_SIZE];
+} VirtqAvail;
+
+typedef struct __attribute__((packed)) {
+    uint16_t flags;
+    uint16_t idx;
+    struct { uint32_t id, len; } ring[VIRTQ_SIZE];
+} VirtqUsed;
+
+typedef struct {
+    VirtqDesc* desc;
+    VirtqAvail* avail;
+    volatile VirtqUsed* used;
+    volatile uint16_t* notify;
+    uint16_t index;             // Queue number
+    uint16_t size;
+    uint16_t free;              // Next unused descriptor in the current batch
+    uint16_t avail_idx;         // Requests made available so far
+    uint16_t used_idx;          // Completions seen so far
+} Virtqueue;
+
+// ---------- GPU commands ----------
+#define VIRTIO_GPU_CMD_GET_DISPLAY_INFO         0x0100
+#define VIRTIO_GPU_CMD_RESOURCE_CREATE_2D       0x0101
+#define VIRTIO_GPU_CMD_RESOURCE_UNREF           0x0102
+#define VIRTIO_GPU_CMD_SET_SCANOUT              0x0103
+#define VIRTIO_GPU_CMD_RESOURCE_FLUSH           0x0104
+#define VIRTIO_GPU_CMD_TRANSFER_TO_HOST_2D      0x0105
+#define VIRTIO_GPU_CMD_RESOURCE_ATTACH_BACKING  0x0106
+#define VIRTIO_GPU_CMD_UPDATE_CURSOR            0x0300
+#define VIRTIO_GPU_CMD_MOVE_CURSOR              0x0301
+#define VIRTIO_GPU_RESP_OK_NODATA               0x1100
+#define VIRTIO_GPU_RESP_OK_DISPLAY_INFO         0x1101
+
+// Memory byte order B, G, R, X/A: our little-endian 0xAARRGGBB pixels
+#define VIRTIO_GPU_FORMAT_B8G8R8A8_UNORM        1
+#define VIRTIO_GPU_FORMAT_B8G8R8X8_UNORM        2
+
+#define VIRTIO_GPU_MAX_SCANOUTS 16
+#define VIRTIO_GPU_CURSOR_SIZE  64
+#define VIRTIO_GPU_BATCH        (VIRTQ_SIZE / 2)    // Request + response per command
+
+#define VIRTIO_GPU_QUEUE_CONTROL 0
+#define VIRTIO_GPU_QUEUE_CURSOR  1
+
+typedef struct __attribute__((packed)) {
+    uint32_t type;
+    uint32_t flags;
+    uint64_t fence_id;
+    uint32_t ctx_id;
+    uint32_t padding;
+} VirtioGPUHeader;
+
+typedef struct __attribute__((packed)) {
+    uint32_t x, y, width, height;
+} VirtioGPURect;
+
+typedef struct __attribute__((packed)) {
+    VirtioGPUHeader hdr;
+    struct __attribute__((packed)) {
+        VirtioGPURect r;
+        uint32_t enabled;
+        uint32_t flags;
+    } pmodes[VIRTIO_GPU_MAX_SCANOUTS];
+} VirtioGPUDisplayInfo;
+
+typedef struct __attribute__((packed)) {
+    VirtioGPUHeader hdr;
+    uint32_t resource_id;
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+} VirtioGPUResourceCreate2D;
+
+typedef struct __attribute__((packed)) {
+    VirtioGPUHeader hdr;
+    uint32_t resource_id;
+    uint32_t padding;
+} VirtioGPUResourceUnref;
+
+typedef struct __attribute__((packed)) {
+    VirtioGPUHeader hdr;
+    uint32_t resource_id;
+    uint32_t nr_entries;
+    uint64_t addr;              // One entry: the buffer is contiguous
+    uint32_t length;
+    uint32_t padding;
+} VirtioGPUAttachBacking;
+
+typedef struct __attribute__((packed)) {
+    VirtioGPUHeader hdr;
+    VirtioGPURect r;
+    uint32_t scanout_id;
+    uint32_t resource_id;
+} VirtioGPUSetScanout;
+
+typedef struct __attribute__((packed)) {
+    VirtioGPUHeader hdr;
+    VirtioGPURect r;
+    uint64_t offset;
+    uint32_t resource_id;
+    uint32_t padding;
+} VirtioGPUTransfer2D;
+
+typedef struct __attribute__((packed)) {
+    VirtioGPUHeader hdr;
+    VirtioGPURect r;
+    uint32_t resource_id;
+    uint32_t padding;
+} VirtioGPUResourceFlush;
+
+typedef struct __attribute__((packed)) {
+    VirtioGPUHeader hdr;
+    struct __attribute__((packed)) { uint32_t scanout_id, x, y, padding; } pos;
+    uint32_t resource_id;
+    uint32_t hot_x;
+    uint32_t hot_y;
+    uint32_t padding;
+} VirtioGPUUpdateCursor;
+
+// One slot per command in a batch: the request and its response header
+typedef union {
+    VirtioGPUHeader hdr;
+    VirtioGPUResourceCreate2D create;
+    VirtioGPUResourceUnref unref;
+    VirtioGPUAttachBacking attach;
+    VirtioGPUSetScanout scanout;
+    VirtioGPUTransfer2D transfer;
+    VirtioGPUResourceFlush flush;
+} VirtioGPURequest;
+
+typedef struct {
+    volatile VirtioCommonCfg* common;
+    uint8_t* notify_base;
+    uint32_t notify_multiplier;
+    Virtqueue control;
+    Virtqueue cursor;
+
+    // Command memory, reused by every batch
+    VirtioGPURequest* requests;     // VIRTIO_GPU_BATCH
+    VirtioGPUHeader* responses;     // VIRTIO_GPU_BATCH
+    VirtioGPUDisplayInfo* display;
+    VirtioGPUUpdateCursor* cursor_cmd;
+    uint32_t* cursor_pixels;        // 64x64 backing of the cursor resource
+
+    // Scanout 0
+    uint32_t resource_id;           // Back buffer resource (0 = none)
+    uint32_t next_resource_id;
+    uint32_t cursor_resource_id;
+    uint32_t pitch;
+    uint16_t width, height;
+    uint16_t pref_width, pref_height;   // Host's preferred size (0 = unknown)
+    uint32_t errors;
+    uint8_t  ready;
+} VirtioGPU;
+
+static VirtioGPU g_virtio_gpu;
+
+// ---------- Transport helpers ----------
+// Address of a virtio capability's window; 64-bit BARs must sit below 4 GB
+static inline uint8_t* virtio_cap_window(const PCIDevice* dev, uint8_t cap, PageCache cache) {
+    uint8_t bar = pci_read8(dev->bus, dev->slot, dev->func, cap + 4);
+    uint32_t offset = pci_read32(dev->bus, dev->slot, dev->func, cap + 8);
+    uint32_t length = pci_read32(dev->bus, dev->slot, dev->func, cap + 12);
+    if (bar > 5 || dev->bar_type[bar] < 2 || pci_bar_above_4g(dev, bar)) return 0;
+    if ((uint64_t)offset + length > dev->bar_size[bar]) return 0;
+
+    uint32_t base = pci_bar_get_addr(dev->bar[bar]) + offset;
+    return (uint8_t*)paging_map(base, length, cache);
+}
+
+static inline int virtio_find_caps(const PCIDevice* dev) {
+    VirtioGPU* g = &g_virtio_gpu;
+    g->common = 0;
+    g->notify_base = 0;
+
+    for (uint8_t cap = pci_find_capability(dev, PCI_CAP_ID_VENDOR, 0); cap;
+         cap = pci_find_capability(dev, PCI_CAP_ID_VENDOR, cap)) {
+        uint8_t type = pci_read8(dev->bus, dev->slot, dev->func, cap + 3);
+        if (type == VIRTIO_PCI_CAP_COMMON && !g->common) {
+            g->common = (volatile VirtioCommonCfg*)virtio_cap_window(dev, cap, PAGE_CACHE_UC);
+        } else if (type == VIRTIO_PCI_CAP_NOTIFY && !g->notify_base) {
+            g->notify_base = virtio_cap_window(dev, cap, PAGE_CACHE_UC);
+            g->notify_multiplier = pci_read32(dev->bus, dev->slot, dev->func, cap + 16);
+        }
+    }
+    return g->common && g->notify_base ? 0 : -1;
+}
+
+// Rings live in one page: descriptors, then the available ring, then the
+// used ring on its own 4-byte boundary
+static inline int virtq_setup(Virtqueue* q, uint16_t index) {
+    volatile VirtioCommonCfg* c = g_virtio_gpu.common;
+    c->queue_select = index;
+    uint16_t size = c->queue_size;
+    if (size == 0) return -1;
+    if (size > VIRTQ_SIZE) size = VIRTQ_SIZE;
+    c->queue_size = size;
+
+    if (!q->desc) {
+        uint8_t* page = (uint8_t*)pmm_alloc(PMM_PAGE_SIZE, PMM_PAGE_SIZE);
+        if (!page) return -1;
+        q->desc = (VirtqDesc*)page;
+        q->avail = (VirtqAvail*)(page + sizeof(VirtqDesc) * VIRTQ_SIZE);
+        q->used = (volatile VirtqUsed*)(page + 512);
+    }
+    mem_zero(q->desc, PMM_PAGE_SIZE);
+    q->index = index;
+    q->size = size;
+    q->free = 0;
+    q->avail_idx = 0;
+    q->used_idx = 0;
+
+    c->queue_desc = (uint32_t)(uintptr_t)q->desc;
+    c->queue_driver = (uint32_t)(uintptr_t)q->avail;
+    c->queue_device = (uint32_t)(uintptr_t)q->used;
+    q->notify = (volatile uint16_t*)(g_virtio_gpu.notify_base +
+                                     c->queue_notify_off * g_virtio_gpu.notify_multiplier);
+    c->queue_enable = 1;
+    return 0;
+}
+
+// Queue a request (and optional response buffer) as one descriptor chain.
+// Returns -1 when the batch is full: submit it first.
+static inline int virtq_add(Virtqueue* q, const void* req, uint32_t req_len, void* resp, uint32_t resp_len) {
+    uint16_t need = resp ? 2 : 1;
+    if (q->free + need > q->size) return -1;
+
+    uint16_t head = q->free;
+    VirtqDesc* d = &q->desc[head];
+    d->addr = (uint32_t)(uintptr_t)req;
+    d->len = req_len;
+    d->flags = resp ? VIRTQ_DESC_F_NEXT : 0;
+    d->next = head + 1;
+    if (resp) {
+        d = &q->desc[head + 1];
+        d->addr = (uint32_t)(uintptr_t)resp;
+        d->len = resp_len;
+        d->flags = VIRTQ_DESC_F_WRITE;
+        d->next = 0;
+    }
+    q->free += need;
+
+    q->avail->ring[q->avail_idx % q->size] = head;
+    q->avail_idx++;
+    return 0;
+}
+
+// Publish the batch, ring the doorbell and wait for every chain in it
+static inline int virtq_submit(Virtqueue* q) {
+    if (q->avail_idx == q->used_idx) return 0;
+    __asm__ volatile ("" ::: "memory");
+    q->avail->idx = q->avail_idx;
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    *q->notify = q->index;
+
+    int ok = 0;
+    for (uint32_t i = 0; i < VIRTQ_TIMEOUT; i++) {
+        if (q->used->idx == q->avail_idx) {
+            ok = 1;
+            break;
+        }
+        cpu_relax();
+    }
+    q->used_idx = q->avail_idx;
+    q->free = 0;
+    if (!ok) g_virtio_gpu.errors++;
+    return ok ? 0 : -1;
+}
+
+// ---------- Control commands ----------
+static inline VirtioGPURequest* virtio_gpu_request(uint32_t type, uint32_t size) {
+    VirtioGPU* g = &g_virtio_gpu;
+    uint32_t slot = g->control.free / 2;
+    if (slot >= VIRTIO_GPU_BATCH) {
+        virtq_submit(&g->control);
+        slot = 0;
+    }
+    VirtioGPURequest* req = &g->requests[slot];
+    mem_zero(req, size);
+    req->hdr.type = type;
+    return req;
+}
+
+static inline void virtio_gpu_queue(VirtioGPURequest* req, uint32_t size) {
+    VirtioGPU* g = &g_virtio_gpu;
+    uint32_t slot = (uint32_t)(req - g->requests);
+    g->responses[slot].type = 0;
+    virtq_add(&g->control, req, size, &g->responses[slot], sizeof(VirtioGPUHeader));
+}
+
+// Submit what is queued; -1 if the device timed out or refused a command
+static inline int virtio_gpu_sync(void) {
+    VirtioGPU* g = &g_virtio_gpu;
+    uint32_t count = g->control.free / 2;
+    if (virtq_submit(&g->control) != 0) return -1;
+    for (uint32_t i = 0; i < count; i++) {
+        if (g->responses[i].type != VIRTIO_GPU_RESP_OK_NODATA) {
+            g->errors++;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static inline int virtio_gpu_get_display_info(void) {
+    VirtioGPU* g = &g_virtio_gpu;
+    static VirtioGPUHeader req;
+    req.type = VIRTIO_GPU_CMD_GET_DISPLAY_INFO;
+    g->display->hdr.type = 0;
+    virtq_add(&g->control, &req, sizeof(req), g->display, sizeof(VirtioGPUDisplayInfo));
+    if (virtq_submit(&g->control) != 0 || g->display->hdr.type != VIRTIO_GPU_RESP_OK_DISPLAY_INFO) return -1;
+
+    if (g->display->pmodes[0].enabled) {
+        g->pref_width = (uint16_t)g->display->pmodes[0].r.width;
+        g->pref_height = (uint16_t)g->display->pmodes[0].r.height;
+    }
+    return 0;
+}
+
+static inline void virtio_gpu_create_2d(uint32_t id, uint32_t format, uint32_t w, uint32_t h) {
+    VirtioGPURequest* req = virtio_gpu_request(VIRTIO_GPU_CMD_RESOURCE_CREATE_2D, sizeof(VirtioGPUResourceCreate2D));
+    req->create.resource_id = id;
+    req->create.format = format;
+    req->create.width = w;
+    req->create.height = h;
+    virtio_gpu_queue(req, sizeof(VirtioGPUResourceCreate2D));
+}
+
+static inline void virtio_gpu_attach(uint32_t id, const void* memory, uint32_t bytes) {
+    VirtioGPURequest* req = virtio_gpu_request(VIRTIO_GPU_CMD_RESOURCE_ATTACH_BACKING, sizeof(VirtioGPUAttachBacking));
+    req->attach.resource_id = id;
+    req->attach.nr_entries = 1;
+    req->attach.addr = (uint32_t)(uintptr_t)memory;
+    req->attach.length = bytes;
+    virtio_gpu_queue(req, sizeof(VirtioGPUAttachBacking));
+}
+
+static inline void virtio_gpu_unref(uint32_t id) {
+    VirtioGPURequest* req = virtio_gpu_request(VIRTIO_GPU_CMD_RESOURCE_UNREF, sizeof(VirtioGPUResourceUnref));
+    req->unref.resource_id = id;
+    virtio_gpu_queue(req, sizeof(VirtioGPUResourceUnref));
+}
+
+static inline void virtio_gpu_set_scanout(uint32_t id, uint32_t w, uint32_t h) {
+    VirtioGPURequest* req = virtio_gpu_request(VIRTIO_GPU_CMD_SET_SCANOUT, sizeof(VirtioGPUSetScanout));
+    req->scanout.r.width = w;
+    req->scanout.r.height = h;
+    req->scanout.scanout_id = 0;
+    req->scanout.resource_id = id;
+    virtio_gpu_queue(req, sizeof(VirtioGPUSetScanout));
+}
+
+// Host copy of one rect out of the backing, then show it
+static inline void virtio_gpu_update(uint32_t id, uint32_t pitch, uint32_t x, uint32_t y, uint32_t w, uint32_t h) {
+    VirtioGPURequest* req = virtio_gpu_request(VIRTIO_GPU_CMD_TRANSFER_TO_HOST_2D, sizeof(VirtioGPUTransfer2D));
+    req->transfer.r = (VirtioGPURect){x, y, w, h};
+    req->transfer.offset = (uint64_t)y * pitch + x * 4;
+    req->transfer.resource_id = id;
+    virtio_gpu_queue(req, sizeof(VirtioGPUTransfer2D));
+
+    if (id == g_virtio_gpu.cursor_resource_id) return;
+    req = virtio_gpu_request(VIRTIO_GPU_CMD_RESOURCE_FLUSH, sizeof(VirtioGPUResourceFlush));
+    req->flush.r = (VirtioGPURect){x, y, w, h};
+    req->flush.resource_id = id;
+    virtio_gpu_queue(req, sizeof(VirtioGPUResourceFlush));
+}
+
+// ---------- Initialization ----------
+// Reset and bring the device up with VERSION_1 as the only feature. The
+// rings and command memory are allocated once; calling again is a no-op.
+static inline int virtio_gpu_init(const PCIDevice* dev) {
+    VirtioGPU* g = &g_virtio_gpu;
+    if (g->ready) return 0;
+    if (virtio_find_caps(dev) != 0) return -1;
+
+    volatile VirtioCommonCfg* c = g->common;
+    c->device_status = 0;
+    while (c->device_status != 0) cpu_relax();
+    c->device_status = VIRTIO_STATUS_ACKNOWLEDGE;
+    c->device_status |= VIRTIO_STATUS_DRIVER;
+
+    c->device_feature_select = 1;
+    if (!(c->device_feature & VIRTIO_F_VERSION_1)) {
+        c->device_status |= VIRTIO_STATUS_FAILED;
+        return -1;
+    }
+    c->driver_feature_select = 0;
+    c->driver_feature = 0;
+    c->driver_feature_select = 1;
+    c->driver_feature = VIRTIO_F_VERSION_1;
+    c->device_status |= VIRTIO_STATUS_FEATURES_OK;
+    if (!(c->device_status & VIRTIO_STATUS_FEATURES_OK)) {
+        c->device_status |= VIRTIO_STATUS_FAILED;
+        return -1;
+    }
+
+    if (!g->requests) {
+        uint8_t* page = (uint8_t*)pmm_alloc(PMM_PAGE_SIZE * 2, PMM_PAGE_SIZE);
+        g->cursor_pixels = (uint32_t*)pmm_alloc(VIRTIO_GPU_CURSOR_SIZE * VIRTIO_GPU_CURSOR_SIZE * 4, PMM_PAGE_SIZE);
+        if (!page || !g->cursor_pixels) return -1;
+        g->requests = (VirtioGPURequest*)page;
+        g->responses = (VirtioGPUHeader*)(page + sizeof(VirtioGPURequest) * VIRTIO_GPU_BATCH);
+        g->cursor_cmd = (VirtioGPUUpdateCursor*)(page + 1024);
+        g->display = (VirtioGPUDisplayInfo*)(page + PMM_PAGE_SIZE);
+    }
+    if (virtq_setup(&g->control, VIRTIO_GPU_QUEUE_CONTROL) != 0 ||
+        virtq_setup(&g->cursor, VIRTIO_GPU_QUEUE_CURSOR) != 0) {
+        c->device_status |= VIRTIO_STATUS_FAILED;
+        return -1;
+    }
+    c->device_status |= VIRTIO_STATUS_DRIVER_OK;
+
+    g->resource_id = 0;
+    g->cursor_resource_id = 0;
+    g->next_resource_id = 1;
+    g->pref_width = g->pref_height = 0;
+    virtio_gpu_get_display_info();
+    g->ready = 1;
+    return 0;
+}
+
+// Scan out a 32 bpp buffer in RAM (contiguous, `pitch` = w * 4). A buffer
+// already scanned out is replaced and its resource dropped.
+static inline int virtio_gpu_set_buffer(void* memory, uint16_t w, uint16_t h, uint32_t pitch) {
+    VirtioGPU* g = &g_virtio_gpu;
+    if (!g->ready || pitch != (uint32_t)w * 4) return -1;
+
+    uint32_t old = g->resource_id;
+    uint32_t id = g->next_resource_id++;
+    virtio_gpu_create_2d(id, VIRTIO_GPU_FORMAT_B8G8R8X8_UNORM, w, h);
+    virtio_gpu_attach(id, memory, pitch * h);
+    virtio_gpu_set_scanout(id, w, h);
+    if (old) virtio_gpu_unref(old);
+    if (virtio_gpu_sync() != 0) return -1;
+
+    g->resource_id = id;
+    g->width = w;
+    g->height = h;
+    g->pitch = pitch;
+    return 0;
+}
+
+// ---------- Present ----------
+// Rects are clipped to the scanout by the caller (gpu.h); batches of
+// VIRTIO_GPU_BATCH commands go out per doorbell
+static inline void virtio_gpu_present_rect(uint32_t x, uint32_t y, uint32_t w, uint32_t h) {
+    if (!g_virtio_gpu.resource_id || !w || !h) return;
+    virtio_gpu_update(g_virtio_gpu.resource_id, g_virtio_gpu.pitch, x, y, w, h);
+}
+
+static inline void virtio_gpu_present_done(void) {
+    virtio_gpu_sync();
+}
+
+// ---------- Cursor ----------
+static inline void virtio_gpu_cursor_command(uint32_t type, uint32_t id, int32_t x, int32_t y,
+                                             int16_t hot_x, int16_t hot_y) {
+    VirtioGPUUpdateCursor* cmd = g_virtio_gpu.cursor_cmd;
+    mem_zero(cmd, sizeof(*cmd));
+    cmd->hdr.type = type;
+    cmd->pos.x = (uint32_t)x;
+    cmd->pos.y = (uint32_t)y;
+    cmd->resource_id = id;
+    cmd->hot_x = (uint32_t)hot_x;
+    cmd->hot_y = (uint32_t)hot_y;
+    virtq_add(&g_virtio_gpu.cursor, cmd, sizeof(*cmd), 0, 0);
+    virtq_submit(&g_virtio_gpu.cursor);
+}
+
+// Premultiplied ARGB up to 64x64, copied into the cursor resource. The
+// new shape shows at the next virtio_gpu_show_cursor.
+static inline int virtio_gpu_define_cursor(const uint32_t* pixels, uint16_t w, uint16_t h) {
+    VirtioGPU* g = &g_virtio_gpu;
+    if (!g->ready || w > VIRTIO_GPU_CURSOR_SIZE || h > VIRTIO_GPU_CURSOR_SIZE) return -1;
+
+    if (!g->cursor_resource_id) {
+        g->cursor_resource_id = g->next_resource_id++;
+        virtio_gpu_create_2d(g->cursor_resource_id, VIRTIO_GPU_FORMAT_B8G8R8A8_UNORM,
+                             VIRTIO_GPU_CURSOR_SIZE, VIRTIO_GPU_CURSOR_SIZE);
+        virtio_gpu_attach(g->cursor_resource_id, g->cursor_pixels,
+                          VIRTIO_GPU_CURSOR_SIZE * VIRTIO_GPU_CURSOR_SIZE * 4);
+    }
+    mem_zero(g->cursor_pixels, VIRTIO_GPU_CURSOR_SIZE * VIRTIO_GPU_CURSOR_SIZE * 4);
+    for (uint32_t y = 0; y < h; y++) {
+        for (uint32_t x = 0; x < w; x++) g->cursor_pixels[y * VIRTIO_GPU_CURSOR_SIZE + x] = pixels[y * w + x];
+    }
+    virtio_gpu_update(g->cursor_resource_id, VIRTIO_GPU_CURSOR_SIZE * 4, 0, 0,
+                      VIRTIO_GPU_CURSOR_SIZE, VIRTIO_GPU_CURSOR_SIZE);
+    return virtio_gpu_sync();
+}
+
+// (Re)attach the shape at a hotspot position, or detach it to hide
+static inline void virtio_gpu_show_cursor(int32_t x, int32_t y, int16_t hot_x, int16_t hot_y, uint8_t visible) {
+    uint32_t id = visible ? g_virtio_gpu.cursor_resource_id : 0;
+    virtio_gpu_cursor_command(VIRTIO_GPU_CMD_UPDATE_CURSOR, id, x, y, hot_x, hot_y);
+}
+
+static inline void virtio_gpu_move_cursor(int32_t x, int32_t y) {
+    virtio_gpu_cursor_command(VIRTIO_GPU_CMD_MOVE_CURSOR, g_virtio_gpu.cursor_resource_id, x, y, 0, 0);
+}
+
+#endif // VIRTIO_GPU_H